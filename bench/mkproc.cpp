@@ -0,0 +1,173 @@
+// Writes a synthetic /proc tree for the scan benchmark: meminfo, stat, uptime and N PID
+// directories with stat, status, io, smaps_rollup, net/dev and a few fd entries each.
+// Usage: mkproc DIR NPIDS
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+
+namespace {
+
+bool makeDir(const std::string& path)
+{
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool writeFile(const std::string& path, const char* data, size_t len)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) { perror(path.c_str()); return false; }
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+bool writeFile(const std::string& path, const std::string& data)
+{
+    return writeFile(path, data.data(), data.size());
+}
+
+// A fleet-like mix: many workers sharing a handful of names, plus some unique ones.
+const char* const COMMS[] = {
+    "nginx", "postgres", "python3", "java", "bash", "sshd", "node", "redis-server",
+    "kworker/0:1", "systemd", "containerd-shim", "envoy", "gunicorn", "sidekiq", "ruby"
+};
+
+std::string pidStat(int pid, int ppid, const char* comm, int k)
+{
+    char buf[512];
+    unsigned long flags = (k % 10 == 0) ? 0x00208040ul : 0x00400100ul;    // every tenth is a kthread
+    snprintf(buf, sizeof(buf),
+             "%d (%s) %c %d %d %d 0 -1 %lu %d 0 %d 0 %lu %lu 0 0 20 0 %d 0 %lu %lu %ld "
+             "18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 %d 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+             pid, comm, k % 50 == 0 ? 'R' : 'S', ppid, pid, pid, flags, 100 + k % 900, k % 7,
+             (unsigned long)(1000 + k * 13 % 50000), (unsigned long)(200 + k * 7 % 9000),
+             1 + k % 16, (unsigned long)(500 + k), (unsigned long)(1 << 20) * (1 + k % 64),
+             (long)(100 + k * 31 % 100000), k % 4);
+    return buf;
+}
+
+std::string pidStatus(int pid, int ppid, const char* comm, int k)
+{
+    char buf[2048];
+    snprintf(buf, sizeof(buf),
+             "Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%d\nNgid:\t0\nPid:\t%d\nPPid:\t%d\n"
+             "TracerPid:\t0\nUid:\t0\t0\t0\t0\nGid:\t0\t0\t0\t0\nFDSize:\t64\nGroups:\t0 \n"
+             "NStgid:\t%d\nNSpid:\t%d\nNSpgid:\t%d\nNSsid:\t%d\nKthread:\t0\n"
+             "VmPeak:\t  %8d kB\nVmSize:\t  %8d kB\nVmLck:\t         0 kB\nVmPin:\t         0 kB\n"
+             "VmHWM:\t  %8d kB\nVmRSS:\t  %8d kB\nRssAnon:\t  %8d kB\nRssFile:\t  %8d kB\n"
+             "RssShmem:\t         0 kB\nVmData:\t  %8d kB\nVmStk:\t       132 kB\nVmExe:\t       912 kB\n"
+             "VmLib:\t      2304 kB\nVmPTE:\t        88 kB\nVmSwap:\t         0 kB\nHugetlbPages:\t         0 kB\n"
+             "CoreDumping:\t0\nTHP_enabled:\t1\nuntag_mask:\t0xffffffffffffffff\nThreads:\t%d\n"
+             "SigQ:\t0/23514\nSigPnd:\t0000000000000000\nShdPnd:\t0000000000000000\n"
+             "SigBlk:\t0000000000000000\nSigIgn:\t0000000000001000\nSigCgt:\t0000000180004a02\n"
+             "CapInh:\t0000000000000000\nCapPrm:\t000001ffffffffff\nCapEff:\t000001ffffffffff\n"
+             "CapBnd:\t000001ffffffffff\nCapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\n"
+             "Seccomp_filters:\t0\nSpeculation_Store_Bypass:\tthread vulnerable\n"
+             "SpeculationIndirectBranch:\tconditional enabled\nCpus_allowed:\tf\nCpus_allowed_list:\t0-3\n"
+             "Mems_allowed:\t00000000,00000001\nMems_allowed_list:\t0\n"
+             "voluntary_ctxt_switches:\t%d\nnonvoluntary_ctxt_switches:\t%d\n",
+             comm, pid, pid, ppid, pid, pid, pid, pid,
+             20000 + k % 80000, 18000 + k % 80000, 4000 + k % 9000, 3800 + k % 9000,
+             3000 + k % 8000, 800 + k % 1000, 6000 + k % 40000, 1 + k % 16,
+             100 + k * 17 % 100000, k % 300);
+    return buf;
+}
+
+std::string pidIo(int k)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "rchar: %d\nwchar: %d\nsyscr: %d\nsyscw: %d\nread_bytes: %d\nwrite_bytes: %d\ncancelled_write_bytes: 0\n",
+             100000 + k * 97, 20000 + k * 13, 300 + k, 120 + k, 4096 * (k % 100), 4096 * (k % 37));
+    return buf;
+}
+
+std::string smapsRollup(int k)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "55d4c1a00000-7ffd5a1ff000 ---p 00000000 00:00 0                          [rollup]\n"
+             "Rss:                %d kB\nPss:                %d kB\nPss_Dirty:          %d kB\n"
+             "Pss_Anon:           %d kB\nPss_File:            %d kB\nPss_Shmem:             0 kB\n"
+             "Shared_Clean:       %d kB\nShared_Dirty:          0 kB\nPrivate_Clean:       %d kB\n"
+             "Private_Dirty:      %d kB\nReferenced:         %d kB\nAnonymous:          %d kB\n"
+             "KSM:                   0 kB\nLazyFree:              0 kB\nAnonHugePages:         0 kB\n"
+             "ShmemPmdMapped:        0 kB\nFilePmdMapped:         0 kB\nShared_Hugetlb:        0 kB\n"
+             "Private_Hugetlb:       0 kB\nSwap:                  0 kB\nSwapPss:               0 kB\n"
+             "Locked:                0 kB\n",
+             4000 + k % 9000, 3000 + k % 8000, 2500 + k % 7000, 2400 + k % 7000, 600 + k % 900,
+             1200 + k % 2000, 300 + k % 700, 2500 + k % 7000, 3900 + k % 9000, 2400 + k % 7000);
+    return buf;
+}
+
+std::string netDev(int k)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "Inter-|   Receive                                                |  Transmit\n"
+             " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+             "    lo: %8d    %4d    0    0    0     0          0         0 %8d    %4d    0    0    0     0       0          0\n"
+             "  eth0: %8d    %4d    0    0    0     0          0         0 %8d    %4d    0    0    0     0       0          0\n",
+             10000 + k, 100 + k % 1000, 10000 + k, 100 + k % 1000, 500000 + k * 3, 900 + k % 5000, 90000 + k * 2, 400 + k % 3000);
+    return buf;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s DIR NPIDS\n", argv[0]);
+        return 1;
+    }
+    std::string root = argv[1];
+    int npids = atoi(argv[2]);
+    if (npids <= 0 || !makeDir(root)) return 1;
+
+    static const char meminfo[] =
+        "MemTotal:       65837228 kB\nMemFree:        21466224 kB\nMemAvailable:   48904444 kB\n"
+        "Buffers:          912344 kB\nCached:         24180764 kB\nSwapCached:            0 kB\n"
+        "Active:         20187248 kB\nInactive:       19913552 kB\nActive(anon):   15313360 kB\n"
+        "Inactive(anon):        0 kB\nActive(file):    4873888 kB\nInactive(file): 19913552 kB\n"
+        "Unevictable:       31256 kB\nMlocked:           27632 kB\nSwapTotal:             0 kB\n"
+        "SwapFree:              0 kB\nZswap:                 0 kB\nZswapped:              0 kB\n"
+        "Dirty:              1232 kB\nWriteback:             0 kB\nAnonPages:      15743116 kB\n"
+        "Mapped:          1626440 kB\nShmem:             46868 kB\nKReclaimable:    2493220 kB\n"
+        "Slab:            3384008 kB\nSReclaimable:    2493220 kB\nSUnreclaim:       890788 kB\n"
+        "KernelStack:       40848 kB\nPageTables:       98140 kB\nCommitLimit:    32918612 kB\n"
+        "Committed_AS:   38417508 kB\nVmallocTotal:   34359738367 kB\nVmallocUsed:      186196 kB\n";
+    static const char stat[] =
+        "cpu  4705521 12082 1418398 91617371 35734 0 67421 0 0 0\n"
+        "cpu0 1177932 3052 355612 22898163 8901 0 35880 0 0 0\n"
+        "cpu1 1176035 2980 354036 22906945 8843 0 10467 0 0 0\n"
+        "cpu2 1175522 3001 354389 22907155 9007 0 10572 0 0 0\n"
+        "cpu3 1176032 3049 354361 22905108 8983 0 10502 0 0 0\n"
+        "intr 530862019 0 9 0 0 0 0 0 0 0 0 0 0 0 0 0\n"
+        "ctxt 1214928433\nbtime 1712000000\nprocesses 2391553\nprocs_running 2\nprocs_blocked 0\n";
+    if (!writeFile(root + "/meminfo", meminfo, sizeof(meminfo) - 1) ||
+        !writeFile(root + "/stat", stat, sizeof(stat) - 1) ||
+        !writeFile(root + "/uptime", std::string("987654.32 3456789.01\n")))
+        return 1;
+
+    for (int k = 0; k < npids; k++) {
+        int pid = k + 1;
+        int ppid = pid == 1 ? 0 : (pid <= 8 ? 1 : pid / 8);
+        const char* comm = COMMS[k % (sizeof(COMMS) / sizeof(COMMS[0]))];
+        char unique[32];
+        if (k % 20 == 0) { snprintf(unique, sizeof(unique), "job-%d", pid); comm = unique; }
+
+        std::string dir = root + "/" + std::to_string(pid);
+        if (!makeDir(dir) || !makeDir(dir + "/net") || !makeDir(dir + "/fd")) return 1;
+        if (!writeFile(dir + "/stat", pidStat(pid, ppid, comm, k)) ||
+            !writeFile(dir + "/status", pidStatus(pid, ppid, comm, k)) ||
+            !writeFile(dir + "/io", pidIo(k)) ||
+            !writeFile(dir + "/smaps_rollup", smapsRollup(k)) ||
+            !writeFile(dir + "/net/dev", netDev(k)))
+            return 1;
+        for (int fd = 0; fd < 1 + k % 4; fd++)
+            if (!writeFile(dir + "/fd/" + std::to_string(fd), "", 0)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+// Compares the ProcParse scanners with the sscanf-per-line parsing they replaced, on /proc files
+// captured into bench/fixtures. Usage: parse_bench [fixture_dir] [iterations]
+#include "ProcParse.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string loadFixture(const std::string& dir, const char* name)
+{
+    std::string path = dir + "/" + name;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) { fprintf(stderr, "cannot open %s\n", path.c_str()); exit(1); }
+    std::string s;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) s.append(chunk, n);
+    fclose(f);
+    return s;
+}
+
+// The old parsers split the buffer in place, so each run works on a fresh copy; the new ones get
+// the same copy to keep the comparison fair.
+char* nextLine(char*& p)
+{
+    if (!p || !*p) return NULL;
+    char* line = p;
+    char* nl = strchr(p, '\n');
+    if (nl) { *nl = '\0'; p = nl + 1; }
+    else p = p + strlen(p);
+    return line;
+}
+
+uint64_t oldMeminfo(char* buf)
+{
+    unsigned long total = 0, free_ = 0, buffers = 0, cached = 0, srecl = 0;
+    char* p = buf;
+    while (char* ml = nextLine(p)) {
+        unsigned long val = 0;
+        if      (sscanf(ml, "MemTotal: %lu", &val) == 1) total = val;
+        else if (sscanf(ml, "MemFree: %lu",  &val) == 1) free_ = val;
+        else if (sscanf(ml, "Buffers: %lu",  &val) == 1) buffers = val;
+        else if (sscanf(ml, "Cached: %lu",   &val) == 1) cached = val;
+        else if (sscanf(ml, "SReclaimable: %lu", &val) == 1) srecl = val;
+    }
+    return total + free_ + buffers + cached + srecl;
+}
+
+uint64_t newMeminfo(char* buf, size_t len)
+{
+    ProcParse::MemInfo m;
+    ProcParse::parseMeminfo(buf, len, m);
+    return m.total + m.free + m.buffers + m.cached + m.s_reclaimable;
+}
+
+uint64_t oldStatus(char* buf)
+{
+    uint64_t v = 0;
+    char* p = buf;
+    while (char* sl = nextLine(p)) {
+        unsigned long val = 0;
+        if (sscanf(sl, "voluntary_ctxt_switches:\t%lu", &val) == 1) v = val;
+    }
+    return v;
+}
+
+uint64_t newStatus(char* buf, size_t len)
+{
+    uint64_t v = 0;
+    ProcParse::parseStatusCtxt(buf, len, v);
+    return v;
+}
+
+uint64_t oldIo(char* buf)
+{
+    unsigned long r = 0, w = 0, rb = 0, wb = 0;
+    char* p = buf;
+    while (char* il = nextLine(p)) {
+        unsigned long val = 0;
+        if      (sscanf(il, "rchar: %lu",       &val) == 1) r  = val;
+        else if (sscanf(il, "wchar: %lu",       &val) == 1) w  = val;
+        else if (sscanf(il, "read_bytes: %lu",  &val) == 1) rb = val;
+        else if (sscanf(il, "write_bytes: %lu", &val) == 1) wb = val;
+    }
+    return r + w + rb + wb;
+}
+
+uint64_t newIo(char* buf, size_t len)
+{
+    ProcParse::PidIo io;
+    ProcParse::parsePidIo(buf, len, io);
+    return io.rchar + io.wchar + io.read_bytes + io.write_bytes;
+}
+
+uint64_t oldSmaps(char* buf)
+{
+    unsigned long sc = 0, pd = 0;
+    char* p = buf;
+    while (char* rl = nextLine(p)) {
+        unsigned long val = 0;
+        if      (sscanf(rl, "Shared_Clean: %lu",  &val) == 1) sc = val;
+        else if (sscanf(rl, "Private_Dirty: %lu", &val) == 1) pd = val;
+    }
+    return sc + pd;
+}
+
+uint64_t newSmaps(char* buf, size_t len)
+{
+    ProcParse::SmapsRollup sr;
+    ProcParse::parseSmapsRollup(buf, len, sr);
+    return sr.shared_clean + sr.private_dirty;
+}
+
+uint64_t oldNetDev(char* buf)
+{
+    uint64_t rx_sum = 0, tx_sum = 0;
+    char* p = buf;
+    nextLine(p);
+    nextLine(p);
+    while (char* nl = nextLine(p)) {
+        char* colon = strchr(nl, ':');
+        if (!colon) continue;
+        unsigned long rx = 0, tx = 0, d = 0;
+        int nr = sscanf(colon + 1, " %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+                        &rx, &d, &d, &d, &d, &d, &d, &d, &tx);
+        if (nr >= 9) { rx_sum += rx; tx_sum += tx; }
+    }
+    return rx_sum + tx_sum;
+}
+
+uint64_t newNetDev(char* buf, size_t len)
+{
+    uint64_t rx = 0, tx = 0;
+    ProcParse::parseNetDev(buf, len, rx, tx);
+    return rx + tx;
+}
+
+uint64_t oldCpu(char* buf)
+{
+    unsigned long u = 0, n = 0, s = 0, i = 0, iw = 0, ir = 0, si = 0, st = 0, g = 0, gn = 0;
+    sscanf(buf, "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", &u, &n, &s, &i, &iw, &ir, &si, &st, &g, &gn);
+    return u + n + s + i + iw + ir + si + st + g + gn;
+}
+
+uint64_t newCpu(char* buf, size_t len)
+{
+    uint64_t v[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    ProcParse::parseCpuLine(buf, len, v, 10);
+    uint64_t sum = 0;
+    for (int k = 0; k < 10; k++) sum += v[k];
+    return sum;
+}
+
+// The previous stat parser: strtol over the fields after the last ')'.
+uint64_t oldPidStat(char* buf)
+{
+    char* lp = strrchr(buf, ')');
+    if (!lp) return 0;
+    char* p = lp + 1;
+    while (*p == ' ') p++;
+    p++;
+    auto skip = [](char* p) { while (*p && *p != ' ') p++; while (*p == ' ') p++; return p; };
+    long ppid = strtol(p, &p, 10); while (*p == ' ') p++;
+    for (int k = 0; k < 4; k++) p = skip(p);
+    unsigned long flags = strtoul(p, &p, 10); while (*p == ' ') p++;
+    for (int k = 0; k < 4; k++) p = skip(p);
+    unsigned long utime = strtoul(p, &p, 10); while (*p == ' ') p++;
+    unsigned long stime = strtoul(p, &p, 10); while (*p == ' ') p++;
+    for (int k = 0; k < 2; k++) p = skip(p);
+    long prio = strtol(p, &p, 10); while (*p == ' ') p++;
+    long nice = strtol(p, &p, 10); while (*p == ' ') p++;
+    long thr = strtol(p, &p, 10); while (*p == ' ') p++;
+    p = skip(p);
+    unsigned long start = strtoul(p, &p, 10); while (*p == ' ') p++;
+    p = skip(p);
+    long rss = strtol(p, &p, 10);
+    return ppid + flags + utime + stime + prio + nice + thr + start + rss;
+}
+
+uint64_t newPidStat(char* buf, size_t len)
+{
+    ProcParse::PidStat st = {};
+    ProcParse::parsePidStat(buf, len, st);
+    return st.ppid + st.flags + st.utime + st.stime + st.priority + st.nice + st.num_threads + st.starttime + st.rss;
+}
+
+struct Case
+{
+    const char* fixture;
+    uint64_t (*old_parse)(char*);
+    uint64_t (*new_parse)(char*, size_t);
+};
+
+double nsPerOp(const std::string& data, int iters, uint64_t& check, uint64_t (*old_parse)(char*),
+               uint64_t (*new_parse)(char*, size_t))
+{
+    std::vector<char> work(data.size() + 1);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k = 0; k < iters; k++) {
+        memcpy(&work[0], data.c_str(), data.size() + 1);
+        check += old_parse ? old_parse(&work[0]) : new_parse(&work[0], data.size());
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "bench/fixtures";
+    int iters = argc > 2 ? atoi(argv[2]) : 200000;
+    if (iters <= 0) iters = 1;
+
+    static const Case cases[] = {
+        { "pid_stat",     oldPidStat, newPidStat },
+        { "status",       oldStatus,  newStatus },
+        { "io",           oldIo,      newIo },
+        { "smaps_rollup", oldSmaps,   newSmaps },
+        { "net_dev",      oldNetDev,  newNetDev },
+        { "meminfo",      oldMeminfo, newMeminfo },
+        { "stat",         oldCpu,     newCpu },
+    };
+
+    printf("%-14s %10s %10s %8s\n", "file", "old ns", "new ns", "speedup");
+    int mismatches = 0;
+    for (const Case& c : cases) {
+        std::string data = loadFixture(dir, c.fixture);
+        uint64_t old_check = 0, new_check = 0;
+        double old_ns = nsPerOp(data, iters, old_check, c.old_parse, NULL);
+        double new_ns = nsPerOp(data, iters, new_check, NULL, c.new_parse);
+        bool same = old_check == new_check;
+        if (!same) mismatches++;
+        printf("%-14s %10.1f %10.1f %7.1fx%s\n", c.fixture, old_ns, new_ns, new_ns > 0 ? old_ns / new_ns : 0.0,
+               same ? "" : "  RESULT MISMATCH");
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+// Times one full refresh, phase by phase, against a real or synthetic proc tree: the scan phases
+// reported by SystemUtils::scanProcesses, then sort, filter, formatting a CSV log tick and
+// rendering a screenful of rows into an off-screen ncurses pad.
+// Usage: scan_bench [--proc-root DIR] [--iterations N] [--threads N]
+#include "SystemUtils.h"
+#include "ProcessSorter.h"
+#include "FilterEngine.h"
+#include "DisplayEngine.h"
+#include "ProcessLogger.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string proc_root = "/proc";
+    int iterations = 5, threads = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--proc-root") && i + 1 < argc) proc_root = argv[++i];
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--proc-root DIR] [--iterations N] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+
+    SystemUtils::ProcFdCache fd_cache;
+    fd_cache.proc_root = proc_root;
+    SystemUtils::PrevSampleStore prev_samples;
+    SystemUtils::CPULoadBreakdown cpu = {};
+    std::vector<SystemUtils::CPULoadBreakdown> cores;
+    SystemUtils::MemBreakdown mem = {};
+    SystemUtils::ScanDemand demand;
+    std::unique_ptr<ScanPool> pool;
+    if (threads > 1) pool.reset(new ScanPool(threads));
+    long clk_tck = sysconf(_SC_CLK_TCK);
+    int num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t mem_total = 0, mem_free = 0, prev_total = 0, prev_work = 0;
+    double mem_usage = 0, cpu_usage = 0;
+    std::string status;
+    ProcessTable table;
+
+    // Off-screen rendering target: a pad on a terminal that writes to /dev/null.
+    FILE* devnull = fopen("/dev/null", "w+");
+    SCREEN* screen = devnull ? newterm(getenv("TERM") ? NULL : "xterm", devnull, devnull) : NULL;
+    const int screen_rows = 50, screen_cols = 200;
+    WINDOW* pad = screen ? newpad(screen_rows + 6, screen_cols) : NULL;
+
+    SystemUtils::ScanTimings timings;
+    double total[SystemUtils::PHASE_COUNT] = {0};
+    double scan_ms = 0, sort_ms = 0, topk_ms = 0, filter_ms = 0, log_ms = 0, render_ms = 0;
+    std::string log_buf;
+    FilterEngine::Program filter;
+    FilterEngine::compile("cpu>1 mem<50 or cmd~^k", filter, status);
+    size_t processes = 0;
+
+    // One untimed pass so the descriptor cache and previous samples are warm, as in steady state.
+    for (int it = 0; it <= iterations; it++) {
+        double uptime = SystemUtils::getUptime(proc_root);
+        timings.reset();
+        Clock::time_point t0 = Clock::now();
+        SystemUtils::scanProcesses(table, mem_total, mem_free, mem_usage, cpu_usage, prev_total, prev_work,
+                                   prev_samples, num_cores, clk_tck, uptime, 1.0, status, cpu, cores, mem,
+                                   fd_cache, pool.get(), demand, NULL, &timings);
+        double scan = msSince(t0);
+        prev_samples.record(table);
+
+        std::vector<uint32_t> rows(table.size());
+        for (uint32_t r = 0; r < rows.size(); r++) rows[r] = r;
+        t0 = Clock::now();
+        ProcessSorter::sortProcesses(table, rows, "cpu");
+        ProcessSorter::sortProcesses(table, rows, "mem");
+        double sort = msSince(t0);
+
+        // What the UI does each tick: order only two screens' worth of rows.
+        t0 = Clock::now();
+        ProcessSorter::sortProcesses(table, rows, "cpu", false, 2 * screen_rows);
+        ProcessSorter::sortProcesses(table, rows, "mem", false, 2 * screen_rows);
+        double topk = msSince(t0);
+
+        std::vector<uint32_t> filtered = rows;
+        t0 = Clock::now();
+        FilterEngine::filterProcesses(table, filtered, filter);
+        double filter = msSince(t0);
+
+        t0 = Clock::now();
+        log_buf.clear();
+        ProcessLogger::formatRows(log_buf, table, rows, std::vector<int>(), FIELD_ALL, time(NULL));
+        double logged = msSince(t0);
+
+        t0 = Clock::now();
+        if (pad) {
+            // A fresh frame each pass, so every line is formatted and painted as on a full redraw.
+            std::vector<DisplayEngine::RowLine> lines;
+            for (int tree = 0; tree < 2; tree++) {
+                DisplayEngine::Frame frame;
+                frame.resize(screen_rows + 6, screen_cols);
+                if (tree) DisplayEngine::treeRows(table, table.tree.order, 0, screen_rows, screen_cols, std::vector<char>(), lines);
+                else DisplayEngine::listRows(table, rows, 0, screen_rows, screen_cols, lines);
+                for (size_t i = 0; i < lines.size(); i++) frame.paint(pad, 5 + (int)i, lines[i].text, lines[i].attr);
+            }
+        }
+        double render = msSince(t0);
+
+        if (it == 0) continue;
+        processes = table.size();
+        scan_ms += scan; sort_ms += sort; topk_ms += topk; filter_ms += filter; log_ms += logged; render_ms += render;
+        for (int p = 0; p < SystemUtils::PHASE_COUNT; p++) total[p] += timings.ns[p] / 1e6;
+    }
+
+    if (pad) delwin(pad);
+    if (screen) { endwin(); delscreen(screen); }
+    if (devnull) fclose(devnull);
+
+    printf("%s: %zu processes, %d thread(s), mean of %d iterations\n", proc_root.c_str(), processes, threads, iterations);
+    for (int p = 0; p < SystemUtils::PHASE_COUNT; p++)
+        printf("  %-8s %9.3f ms\n", SystemUtils::ScanTimings::name(p), total[p] / iterations);
+    printf("  %-8s %9.3f ms  (wall)\n", "scan", scan_ms / iterations);
+    printf("  %-8s %9.3f ms\n", "sort", sort_ms / iterations);
+    printf("  %-8s %9.3f ms  (top %d)\n", "topk", topk_ms / iterations, 2 * screen_rows);
+    printf("  %-8s %9.3f ms\n", "filter", filter_ms / iterations);
+    printf("  %-8s %9.3f ms  (%zu KB)\n", "log", log_ms / iterations, log_buf.size() / 1024);
+    printf("  %-8s %9.3f ms%s\n", "render", render_ms / iterations, pad ? "" : "  (no terminal)");
+    return processes ? 0 : 1;
+}
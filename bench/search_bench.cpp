@@ -0,0 +1,95 @@
+// Times case-insensitive command matching the way the F4 filter and / search use it: the old
+// lowercase-a-copy-then-std::string::find loop against StringPool::containing on each kernel.
+// Usage: search_bench [strings] [iterations]
+#include "ProcessTable.h"
+#include "TextSearch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double nsSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+// Command names as the pool holds them: the comm field of /proc/<pid>/stat, at most 15 bytes.
+// Per-CPU kernel threads and numbered workers keep the distinct names in the thousands.
+std::string makeCmd(unsigned i)
+{
+    static const char* heads[] = {
+        "kworker/%u:%u", "kworker/u%u:%u", "ksoftirqd/%u", "Python3-w%u", "java-%u", "nginx: wk%u",
+        "gunicorn-%u", "postgres: %u", "systemd-journal", "node-%u",
+    };
+    char buf[32];
+    snprintf(buf, sizeof(buf), heads[i % 10], i / 10, i % 7);
+    return std::string(buf, std::min<size_t>(strlen(buf), 15));
+}
+
+size_t oldMatch(const StringPool& pool, const std::string& needle, std::vector<uint8_t>& hit)
+{
+    std::string lower_needle = needle;
+    std::transform(lower_needle.begin(), lower_needle.end(), lower_needle.begin(), ::tolower);
+    hit.assign(pool.size(), 0);
+    size_t n = 0;
+    for (uint32_t id = 0; id < pool.size(); id++) {
+        std::string lower_cmd(pool.str(id), pool.length(id));
+        std::transform(lower_cmd.begin(), lower_cmd.end(), lower_cmd.begin(), ::tolower);
+        if (lower_cmd.find(lower_needle) != std::string::npos) { hit[id] = 1; n++; }
+    }
+    return n;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unsigned strings = argc > 1 ? atoi(argv[1]) : 20000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 50;
+    StringPool pool;
+    for (unsigned i = 0; i < strings; i++) {
+        std::string s = makeCmd(i);
+        pool.intern(s.data(), s.size());
+    }
+
+    // A rare needle, a common one, a single keystroke and one that never matches.
+    const char* needles[] = { "JAVA", "kworker/u12", "g", "zzzq" };
+    printf("%zu strings, kernels up to %s, mean of %d iterations\n", pool.size(), TextSearch::isaName(TextSearch::best()), iterations);
+    printf("  %-16s %10s %10s  %s\n", "needle", "old us", "new us", "speedup");
+
+    int status = 0;
+    for (const char* needle : needles) {
+        std::vector<uint8_t> expect, hit;
+        Clock::time_point t0 = Clock::now();
+        for (int it = 0; it < iterations; it++) oldMatch(pool, needle, expect);
+        double old_ns = nsSince(t0) / iterations;
+
+        t0 = Clock::now();
+        for (int it = 0; it < iterations; it++) pool.containing(needle, hit);
+        double new_ns = nsSince(t0) / iterations;
+        if (hit != expect) { fprintf(stderr, "mismatch for '%s'\n", needle); status = 1; }
+        printf("  %-16s %10.1f %10.1f  %5.1fx\n", needle, old_ns / 1e3, new_ns / 1e3, old_ns / new_ns);
+    }
+
+    // Raw kernels over the whole folded arena, which is what containing() walks, with a needle
+    // whose first byte is common so memchr cannot skip ahead.
+    std::string arena;
+    for (uint32_t id = 0; id < pool.size(); id++) { arena.append(pool.lower(id)); arena += '\0'; }
+    for (int isa = 0; isa <= TextSearch::best(); isa++) {
+        Clock::time_point t0 = Clock::now();
+        size_t found = 0;
+        for (int it = 0; it < iterations; it++)
+            found += TextSearch::find((TextSearch::Isa)isa, arena.data(), arena.size(), "-yq", 3) != NULL;
+        double ns = nsSince(t0) / iterations;
+        printf("  kernel %-7s %8.1f us  %6.2f GB/s\n", TextSearch::isaName((TextSearch::Isa)isa), ns / 1e3, arena.size() / ns);
+        if (found) status = 1;
+    }
+    return status;
+}
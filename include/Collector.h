@@ -0,0 +1,98 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include "Snapshot.h"
+#include "SystemUtils.h"
+#include "ScanPool.h"
+#include "ProcEvents.h"
+#include "Options.h"
+#include "SelfStats.h"
+#include "History.h"
+#include <memory>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Owns all scanner state and produces Snapshots, either on demand or from a background thread.
+// Readers only ever see complete snapshots through latest().
+class Collector
+{
+private:
+    SystemUtils::PrevSampleStore prev_samples;
+    SystemUtils::ThreadSampleStore thread_samples;
+    uint64_t prev_total_jiffies = 0, prev_work_jiffies = 0, sequence = 0;
+    SystemUtils::CPULoadBreakdown cpu_breakdown = {};
+    std::vector<SystemUtils::CPULoadBreakdown> core_breakdown;
+    std::vector<int> cpu_node;                       // read once; CPUs hotplugged later count as node 0
+    int numa_nodes = 0;
+    SystemUtils::ProcFdCache fd_cache;
+    std::unique_ptr<ScanPool> scan_pool;
+    int num_cores = 0;
+    long clk_tck = 0;
+    double poll_interval = 1.0;
+    SystemUtils::ScanDemand demand;
+
+    // Self-instrumentation, touched only by whichever thread runs collect().
+    SystemUtils::ScanTimings timings;
+    RollingStat scan_cost, record_cost, history_cost, phase_cost[SystemUtils::PHASE_COUNT];
+    uint64_t last_syscalls = 0, last_bytes_read = 0;
+
+    // Event-driven PID tracking. live_pids is authoritative between full /proc walks.
+    ProcEvents events;
+    std::string events_error;
+    std::vector<ProcEvent> event_buf;
+    std::unordered_set<pid_t> live_pids;
+    std::unordered_map<pid_t, std::string> exec_comm;
+    std::vector<ExitedProcess> exited;
+    std::unordered_map<pid_t, size_t> exited_index;
+    int ticks_since_walk = 0;
+    bool need_walk = true;
+
+    // Every published snapshot is also appended here, after publishing.
+    std::unique_ptr<History> history_ring;
+    std::string history_error;
+
+    std::shared_ptr<const Snapshot> current;
+    std::shared_ptr<Snapshot> spare;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable published_cv;
+    std::atomic<bool> stopping{false};
+    int wake_fd = -1;
+    int publish_fd = -1;
+
+    void loop();
+    void handleEvents();
+    ExitedProcess* exitRecord(pid_t pid);
+
+public:
+    explicit Collector(const Options& opts);
+    ~Collector();
+    Collector(const Collector&) = delete;
+    Collector& operator=(const Collector&) = delete;
+
+    std::shared_ptr<const Snapshot> collect();
+    std::shared_ptr<const Snapshot> latest() const;
+    // Waits up to timeout_ms for a snapshot newer than sequence `after`; returns the latest either way.
+    std::shared_ptr<const Snapshot> waitNewer(uint64_t after, int timeout_ms);
+    void setDemand(const SystemUtils::ScanDemand& d);
+    // Keeps n more descriptors out of the /proc fd cache, for callers that open their own.
+    void reserveFds(int n) { fd_cache.max_fds = std::max(0, fd_cache.max_fds - n); }
+    // An eventfd that becomes readable after each publish, for callers waiting in poll/epoll.
+    int publishFd() const { return publish_fd; }
+    const std::string& eventsError() const { return events_error; }
+    const std::string& historyError() const { return history_error; }
+    const History* history() const { return history_ring.get(); }
+    // Seconds between scans, used for rates; start() sets it too.
+    void setInterval(double interval) { poll_interval = interval; }
+    void start(double interval);
+    void stop();
+};
+
+#endif
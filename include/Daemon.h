@@ -0,0 +1,88 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "Collector.h"
+#include "FilterEngine.h"
+#include "Options.h"
+#include <csignal>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// `pa --daemon`: one collector feeds every client of a Unix stream socket. Clients send one
+// request per line and get NDJSON back (or binary records with format=binary):
+//
+//   get [fields=LIST] [sort=KEY] [reverse] [top=N] [format=json|binary] [filter=EXPR]
+//   subscribe [every=MS] <same options as get>
+//   unsubscribe
+//
+// filter= takes the rest of the line. A response is rendered once per tick and query and shared
+// by every client that asked for it; a subscriber still draining its last push skips a tick
+// rather than queueing without bound.
+class Daemon
+{
+private:
+    struct Query {
+        std::vector<int> fields;
+        std::string sort;
+        bool reverse = false;
+        size_t top = 0;                  // 0 = every process
+        bool binary = false;
+        std::string filter;
+        FilterEngine::Program prog;
+        std::string key;                 // canonical form, for the per-tick cache
+    };
+
+    struct Client {
+        int fd;
+        std::string in;
+        std::deque<std::shared_ptr<const std::string>> out;
+        size_t out_pos = 0;              // bytes of out.front() already sent
+        size_t queued = 0;               // bytes in out
+        uint32_t events = 0;             // what epoll watches for
+        std::vector<Query> pending;      // gets that arrived before the first usable tick
+        bool subscribed = false;
+        bool read_closed = false, closing = false;
+        uint64_t every = 1, pushed_seq = 0;
+        Query sub;
+    };
+
+    Collector& collector;
+    Options opts;
+    std::string path;
+    int listen_fd = -1, epoll_fd = -1;
+    bool bound = false, accepting = true;
+    std::unordered_map<int, std::unique_ptr<Client>> clients;
+    std::shared_ptr<const Snapshot> snap;        // latest snapshot with real rates, or null
+    uint64_t snap_ms = 0;
+    std::map<std::string, std::shared_ptr<const std::string>> cache;   // this tick's responses
+
+    bool parseQuery(const std::string& args, Query& q, int* every_ms, std::string& error) const;
+    std::shared_ptr<const std::string> render(const Query& q);
+    void acceptClients();
+    void readClient(Client& c);
+    void handleLine(Client& c, const std::string& line);
+    void enqueue(Client& c, std::shared_ptr<const std::string> msg);
+    void sendError(Client& c, const std::string& error);
+    bool flush(Client& c);
+    void drop(int fd);
+    void onSnapshot();
+
+public:
+    Daemon(Collector& collector, const Options& opts);
+    ~Daemon();
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    // Binds opts.socket_path, or $XDG_RUNTIME_DIR/pa.sock, or /tmp/pa-<uid>.sock. A stale socket
+    // is replaced; one another daemon still answers on is an error.
+    bool listen(std::string& error);
+    const std::string& socketPath() const { return path; }
+    // Serves until stop is set; the collector must already be running.
+    void run(const volatile sig_atomic_t& stop);
+};
+
+#endif
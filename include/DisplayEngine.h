@@ -3,8 +3,10 @@
 
 #include "ProcessInfo.h"
 #include "SystemUtils.h"
+#include "ProcessTable.h"
+#include "Snapshot.h"
+#include "GroupBy.h"
 #include <vector>
-#include <map>
 #include <string>
 #include <ncurses.h>
 
@@ -12,18 +14,78 @@ namespace DisplayEngine {
     void displayHeader(WINDOW* win, uint64_t mem_total, uint64_t mem_free, 
                         double system_cpu_usage, double system_mem_usage, 
                         double system_uptime, int num_cores, 
-                        const std::vector<Filter>& filters, bool logging_enabled, 
+                        bool logging_enabled, 
                         const std::string& sort_criterion, const std::string& status_msg,
                         const SystemUtils::CPULoadBreakdown& cpu_breakdown,
-                        const SystemUtils::MemBreakdown& mem_breakdown);
+                        const SystemUtils::MemBreakdown& mem_breakdown,
+                        bool events_active, size_t exited_count,
+                        const CollectorStats& self, const UiCosts* ui,
+                        const SystemUtils::Pressure* pressure = NULL);
     
-    void displayTree(WINDOW* win, pid_t pid, int depth, int &line, int max_lines, 
-                        int scroll_offset, int h_scroll_offset, int selected_row, 
-                        const std::map<pid_t, ProcessInfo>& process_map, 
-                        const std::map<pid_t, std::vector<pid_t>>& process_tree);
-    
-    void displayProcesses(WINDOW* win, int max_lines, int scroll_offset, int h_scroll_offset, 
-                            int selected_row, const std::vector<ProcessInfo>& processes);
+    // Per-core load under the header: a small bar per core while they fit in a few lines, else one
+    // heatmap cell per core ('.' under 10%, then the tens digit, '@' from 95%), a line or more per
+    // NUMA node led by the node's average. coreLines() is the height displayCores() will draw.
+    int coreLines(const std::vector<SystemUtils::CPULoadBreakdown>& cores, int numa_nodes, int width);
+    void displayCores(WINDOW* win, int y, int lines, const std::vector<SystemUtils::CPULoadBreakdown>& cores,
+                      int numa_nodes);
+
+    // One process line before horizontal scrolling, with the colour for the process's state.
+    struct RowLine {
+        std::string text;
+        int attr;
+        pid_t pid;
+    };
+
+    std::string columnHeader(int width);
+
+    // Formats lines [first, first + count) of the list or tree view.
+    void listRows(const ProcessTable& table, const std::vector<uint32_t>& rows, int first, int count, int width,
+                  std::vector<RowLine>& out);
+    // rows in tree order; a row flagged in collapsed is drawn with "[+]" and its subtree's totals.
+    void treeRows(const ProcessTable& table, const std::vector<uint32_t>& rows, int first, int count, int width,
+                  const std::vector<char>& collapsed, std::vector<RowLine>& out);
+
+    // The thread view: lines [first, first + count) of rows, which index th. RowLine::pid is the TID.
+    std::string threadHeader(int width);
+    void threadRows(const ThreadTable& th, const ProcessTable& table, const std::vector<uint32_t>& rows, int first,
+                    int count, int width, std::vector<RowLine>& out);
+
+    // The group-by view: rows index groups (cmd is the label). key names the label column.
+    std::string groupHeader(int width, const char* key);
+    void groupRows(const GroupBy::Groups& groups, const std::vector<uint32_t>& rows, int first, int count, int width,
+                   std::vector<RowLine>& out);
+
+    // The cgroup panel: one line per cgroup in rows, which index groups. CgCPU%, MemMB, CPSI and
+    // IO come from the cgroup's own files where readable; the rest are sums over its processes.
+    std::string cgroupHeader(int width);
+    void cgroupRows(const std::vector<SystemUtils::CgroupStats>& groups, const StringPool& strings,
+                    const std::vector<uint32_t>& rows, int first, int count, int width, std::vector<RowLine>& out);
+
+    // What each screen line currently shows. paint() skips lines whose visible text and attribute
+    // are unchanged, so a tick that moves one value or a keypress that moves the selection
+    // repaints only those lines, and ncurses sends nothing for the rest.
+    class Frame {
+    private:
+        struct Shown {
+            bool valid = false;
+            int attr = 0;
+            std::string text;
+        };
+        std::vector<Shown> shown;
+        int width = 0;
+
+    public:
+        size_t painted = 0;    // lines actually repainted, for the self-cost display
+
+        // Drops everything on a size change.
+        void resize(int rows, int cols);
+        // Forgets the screen contents, e.g. after the help screen or a terminal resize.
+        void invalidate();
+        // Records text/attr as line y's contents; true if that differs from what was there.
+        // Lines drawn by other code (header, function bar) use this with a signature string.
+        bool stale(int y, const std::string& text, int attr);
+        void paint(WINDOW* win, int y, const std::string& text, int attr, int h_scroll = 0);
+    };
 }
 
 #endif
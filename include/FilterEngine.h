@@ -1,14 +1,54 @@
 #ifndef FILTER_ENGINE_H
 #define FILTER_ENGINE_H
 
-#include "ProcessInfo.h"
+#include "ProcessTable.h"
+#include "GroupBy.h"
 #include <vector>
 #include <string>
+#include <regex>
+#include <memory>
 
+// Filter expressions such as `cpu>5 and (cmd~^py|cmd:java) and not state:Z or rss>=2G`.
+// An expression is compiled once into a postfix program of predicates and boolean operators,
+// then run over the process table one column at a time.
 namespace FilterEngine {
-    std::vector<Filter> parseFilters(const std::string& input, std::string& status_msg);
-    bool matchesFilter(const ProcessInfo& proc, const Filter& filter, std::string& status_msg);
-    std::vector<ProcessInfo> filterProcesses(const std::vector<ProcessInfo>& processes, const std::vector<Filter>& filters, std::string& status_msg);
+    struct Predicate {
+        int field;
+        int op;
+        double value;
+        std::string text;                   // lowered needle, glob pattern or state letters
+        std::shared_ptr<std::regex> regex;
+        bool literal = false;               // = and != compare text as written: quoted, no glob
+    };
+
+    struct Insn {
+        enum Code { PRED, AND, OR, NOT } code;
+        int pred;
+    };
+
+    struct Program {
+        std::vector<Predicate> preds;
+        std::vector<Insn> code;
+        bool empty() const { return code.empty(); }
+    };
+
+    // Compiles expr into prog. On a syntax error prog is left untouched and error says why.
+    // The member-count field "count" is accepted only when groups is set.
+    bool compile(const std::string& expr, Program& prog, std::string& error, bool groups = false);
+
+    // The program for cgroup="path", matching exactly that path whatever characters it holds.
+    Program cgroupIs(const std::string& path);
+
+    // Keeps only the rows that satisfy prog, preserving their order.
+    void filterProcesses(const ProcessTable& table, std::vector<uint32_t>& rows, const Program& prog);
+    // The same over the group list, where count tests each group's member count.
+    void filterGroups(const GroupBy::Groups& groups, std::vector<uint32_t>& rows, const Program& prog);
+
+    // Whether prog tests the cgroup column, which is only filled when the scan is asked for it.
+    bool usesCgroups(const Program& prog);
+
+    // Field names accepted in expressions, for help text.
+    const char* fieldList();
 }
 
 #endif
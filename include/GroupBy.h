@@ -0,0 +1,37 @@
+#ifndef GROUP_BY_H
+#define GROUP_BY_H
+
+#include "ProcessTable.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// The group-by view. Processes are folded into groups in one hash-aggregation pass per tick, and
+// the groups are laid out as a ProcessTable of their own so filter expressions and sort keys
+// apply to them unchanged: cmd holds the label, pid the lowest member PID, ppid the shared parent
+// when grouping by parent (0 otherwise), and the rates, sizes, descriptors and threads are sums
+// over the members. age is the oldest member's. The member count is a column of its own, the
+// "count" field and sort key that only the group list accepts.
+namespace GroupBy {
+    enum Key { NONE, COMMAND, USER, PARENT, CGROUP, KEY_COUNT };
+
+    struct Groups {
+        ProcessTable table;
+        std::vector<uint32_t> count;                      // members per group
+        std::vector<uint32_t> group_of;                   // by source row; UINT32_MAX when left out
+        std::unordered_map<int64_t, uint32_t> index;      // key value -> group, reused between ticks
+        std::unordered_map<int32_t, std::string> users;   // UID -> name, looked up once each
+    };
+
+    // Groups the listed rows of t by key; rows not listed belong to no group.
+    void aggregate(const ProcessTable& t, const std::vector<uint32_t>& rows, Key key, Groups& out);
+    // Rows of t in group g, in PID order.
+    void members(const Groups& groups, uint32_t g, std::vector<uint32_t>& out);
+    // The group labelled label, or -1.
+    int find(const Groups& groups, const std::string& label);
+    const char* name(Key key);
+    // The key after key in the g cycle, NONE after the last.
+    Key next(Key key);
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+// Per-tick process history kept in fixed-size segments used as a ring. A segment is
+// self-contained: it carries its own command dictionary, and each frame stores, per process,
+// only the columns that changed since the previous frame of the same segment, so an idle
+// process costs about two bytes a tick. Segments live in anonymous memory or, given a path, in a
+// shared file mapping that outlives the process and is picked up again on the next start.
+// append() and read() may be called from different threads.
+class History
+{
+public:
+    // Columns kept per process. The first seven change most often and share the low byte of
+    // the change mask.
+    enum Column {
+        H_CPU, H_MEM, H_RSS, H_IO_R, H_IO_W, H_NET_RX, H_NET_TX,
+        H_AGE, H_PPID, H_STATE, H_CMD, H_THREADS, H_FD, H_CTXSW, H_COUNT
+    };
+
+    struct Stats {
+        size_t frames, segments, bytes_used, capacity;
+        uint64_t appended;               // frames ever stored, counting recovered ones
+        uint64_t oldest_ms, newest_ms;
+    };
+
+    // segment_bytes * segments of storage; path may be empty. On failure error is set and
+    // append() does nothing.
+    History(size_t segment_bytes, size_t segments, const std::string& path, std::string& error);
+    ~History();
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    void append(const Snapshot& snap, uint64_t time_ms);
+
+    // Decodes frame number `frame` (counted like Stats::appended, so it stays put while new
+    // frames arrive) into out. Only the history columns, system totals and sequence are filled
+    // in. False once the frame has been overwritten.
+    bool read(uint64_t frame, Snapshot& out, uint64_t& time_ms) const;
+
+    Stats stats() const;
+
+private:
+    struct Row {
+        pid_t pid;
+        int64_t v[H_COUNT];
+    };
+
+    struct Segment {
+        char* base;
+        std::vector<uint32_t> frames;   // offsets of frame records
+    };
+
+    // Encoder state for the segment being written; reset whenever a new segment starts.
+    struct Encoder {
+        std::unordered_map<std::string, uint32_t> dict;
+        std::vector<Row> prev;
+    };
+
+    size_t segment_bytes = 0;
+    char* map = NULL;
+    size_t map_bytes = 0;
+    int fd = -1;
+    std::vector<Segment> segments;
+    int current = -1;                // segment being written, or the newest one after recover()
+    bool writing = false;            // whether enc matches segments[current]
+    uint64_t next_sequence = 1, appended = 0;
+    Encoder enc;
+    std::vector<char> scratch;
+    mutable std::mutex mtx;
+
+    void recover();
+    void startSegment();
+    void encode(const Snapshot& snap, uint64_t time_ms, std::vector<Row>& rows, std::vector<uint32_t>& fresh);
+    std::vector<int> newestFirst() const;
+};
+
+#endif
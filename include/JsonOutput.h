@@ -0,0 +1,33 @@
+#ifndef JSON_OUTPUT_H
+#define JSON_OUTPUT_H
+
+#include "ProcessTable.h"
+#include "ProcessInfo.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Serializes snapshots for --json and --ndjson into a caller-owned buffer.
+namespace JsonOutput {
+    enum Field {
+        J_PID, J_PPID, J_STATE, J_CMD, J_CPU, J_MEM, J_RSS, J_THREADS, J_IO_R, J_IO_W,
+        J_NET_RX, J_NET_TX, J_CTXSW, J_SHARED, J_PRIVATE, J_FD, J_AGE, J_PRIO, J_NICE,
+        J_UTIME, J_STIME, J_LAST_CPU, J_CPUS_ALLOWED, J_FIELD_COUNT
+    };
+
+    // Comma list of field names, or "all"; the default set is what --json has always printed.
+    bool parseFields(const std::string& list, std::vector<int>& fields);
+    const std::vector<int>& defaultFields();
+    const char* fieldList();
+    // FIELD_* bits the given fields read.
+    unsigned scanFieldsFor(const std::vector<int>& fields);
+
+    void appendSystem(std::string& out, const SystemStats& sys);
+    // One process as a JSON object. Fields backed by a FIELD_* bit outside `scanned` are left
+    // out. Returns a hash of everything but age, which changes every tick, for delta output.
+    uint64_t appendProcess(std::string& out, const ProcessTable& t, size_t row,
+                           const std::vector<int>& fields, unsigned scanned);
+    void appendExited(std::string& out, const ExitedProcess& x);
+}
+
+#endif
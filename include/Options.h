@@ -0,0 +1,33 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "ProcessInfo.h"
+#include <string>
+
+struct Options
+{
+    bool json = false;
+    bool ndjson = false, ndjson_per_process = false, changed_only = false;
+    int interval_ms = 1000;          // --json sample gap and --ndjson tick
+    std::string json_fields;         // empty = the default --json set
+    bool dump = false;               // --dump-binary
+    std::string dump_binary;         // its file; empty = stdout
+    std::string read_binary;
+    bool daemon = false;
+    std::string socket_path;         // empty = $XDG_RUNTIME_DIR/pa.sock or /tmp/pa-<uid>.sock
+    int scan_threads = 1;
+    unsigned fields = FIELD_ALL;
+    int refresh_ticks = 5;
+    bool proc_events = false;
+    std::string proc_root = "/proc";
+    std::string sort = "cpu";
+    int history_mb = 8;              // 0 disables the history ring
+    std::string history_file;        // empty keeps history in memory only
+    bool log = false;                // start with CSV logging on
+    std::string log_path = "process_log.csv";
+    std::string log_columns;         // empty = every column
+    int log_rotate_mb = 0, log_rotate_min = 0, log_keep = 5;
+    bool log_compress = false;
+};
+
+#endif
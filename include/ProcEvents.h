@@ -0,0 +1,51 @@
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <sys/types.h>
+
+struct ProcEvent
+{
+    enum Type { FORK, EXEC, EXIT, ACCOUNTING } type;
+    pid_t pid, ppid;
+    int exit_code;
+    // ACCOUNTING only: the taskstats record sent when the process exited.
+    char comm[32];
+    uint64_t cpu_us, lifetime_us, read_bytes, write_bytes, hiwater_rss;
+};
+
+// Kernel process events: fork/exec/exit from the proc connector (NETLINK_CONNECTOR) and, when
+// available, per-exit taskstats accounting. Both need CAP_NET_ADMIN; open() fails cleanly
+// otherwise and the caller keeps polling /proc.
+class ProcEvents
+{
+private:
+    int cn_fd = -1, ts_fd = -1;
+    uint16_t ts_family = 0;
+
+    bool openConnector(std::string& error);
+    bool openTaskstats();
+    bool drainConnector(std::vector<ProcEvent>& out);
+    bool drainTaskstats(std::vector<ProcEvent>& out);
+
+public:
+    ProcEvents() {}
+    ~ProcEvents();
+    ProcEvents(const ProcEvents&) = delete;
+    ProcEvents& operator=(const ProcEvents&) = delete;
+
+    bool open(std::string& error);
+    void close();
+    bool active() const { return cn_fd >= 0; }
+    bool hasAccounting() const { return ts_fd >= 0; }
+    int connectorFd() const { return cn_fd; }
+    int taskstatsFd() const { return ts_fd; }
+
+    // Reads everything pending without blocking. Returns false if the kernel dropped events
+    // (socket overrun), in which case the caller must resynchronise from /proc.
+    bool drain(std::vector<ProcEvent>& out);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef PROC_PARSE_H
+#define PROC_PARSE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Single-pass scanners for /proc text files. Every parser takes the whole file as read by one
+// read() and walks it with memchr; none of them allocate, copy or call into stdio.
+namespace ProcParse {
+    // A "Key:   value [kB]" line to pick out of a keyed file such as meminfo or status.
+    struct KeySpec
+    {
+        const char* key;
+        size_t len;
+    };
+
+    // Stores the value of keys[k] in out[k] and returns how many keys were seen. Stops reading
+    // as soon as every key has been found. Lines are matched on key length and first byte
+    // before any memcmp, so unrelated lines cost a couple of compares.
+    int scanKeyed(const char* buf, size_t len, const KeySpec* keys, int nkeys, uint64_t* out);
+
+    struct PidStat
+    {
+        const char* comm;
+        size_t comm_len;
+        char state;
+        long ppid, priority, nice, num_threads, rss;
+        unsigned long flags, utime, stime, starttime;
+        int processor;                     // only with with_processor
+    };
+
+    struct MemInfo { uint64_t total, free, buffers, cached, s_reclaimable; };
+    struct PidIo { uint64_t rchar, wchar, read_bytes, write_bytes; };
+    struct SmapsRollup { uint64_t shared_clean, private_dirty; };
+
+    // /proc/<pid>/stat. comm points into buf; false if the line is malformed. with_processor
+    // decodes field 39 too, at the cost of walking the fifteen fields before it.
+    bool parsePidStat(const char* buf, size_t len, PidStat& out, bool with_processor = false);
+    bool parseMeminfo(const char* buf, size_t len, MemInfo& out);
+    bool parseStatusCtxt(const char* buf, size_t len, uint64_t& voluntary_ctxt_switches);
+    // The same, plus the Cpus_allowed_list text (pointing into buf, empty if absent). The lines
+    // come in that order, so the key scan resumes where the list was found.
+    bool parseStatusAffinity(const char* buf, size_t len, uint64_t& voluntary_ctxt_switches,
+                             const char*& cpus, size_t& cpus_len);
+    // The effective UID from the "Uid:" line.
+    bool parseStatusUid(const char* buf, size_t len, uint32_t& euid);
+    bool parseStatusSwitches(const char* buf, size_t len, uint64_t& voluntary, uint64_t& nonvoluntary);
+    bool parsePidIo(const char* buf, size_t len, PidIo& out);
+    bool parseSmapsRollup(const char* buf, size_t len, SmapsRollup& out);
+    // Sums receive and transmit bytes over all interfaces in a net/dev table.
+    bool parseNetDev(const char* buf, size_t len, uint64_t& rx, uint64_t& tx);
+    // Reads up to max counters from the aggregate "cpu" line of /proc/stat; returns the count.
+    int parseCpuLine(const char* buf, size_t len, uint64_t* out, int max);
+
+    // One "cpuN" line of /proc/stat. Offline CPUs have no line, so cpu is not the array index.
+    struct CpuTimes
+    {
+        int cpu;
+        uint64_t v[10];
+    };
+    // Every cpu line of /proc/stat in one pass: the aggregate line's counters into all (as
+    // parseCpuLine), then up to max_cores "cpuN" lines into cores. A cpuN line cut off by the end
+    // of buf is dropped. Returns the number of cores stored.
+    int parseStatCpus(const char* buf, size_t len, uint64_t* all, CpuTimes* cores, int max_cores);
+    // A kernel CPU list such as "0-3,8,10-11": sets mask[cpu] for each listed cpu below max_cpus
+    // and returns how many were set.
+    int parseCpuList(const char* buf, size_t len, uint8_t* mask, int max_cpus);
+    // Adds each line's "N<node>=<pages>" counts of /proc/<pid>/numa_maps to node_kb[node], in kB
+    // of that line's kernelpagesize_kB. Nodes at or above max_nodes are skipped. Returns the
+    // highest node seen plus one.
+    int parseNumaMaps(const char* buf, size_t len, uint64_t* node_kb, int max_nodes);
+
+    // One line of a pressure file: percentages of wall time stalled, and the stall total in us.
+    struct PsiLine { double avg10, avg60, avg300; uint64_t total; };
+    // /proc/pressure/<resource> or a cgroup's <resource>.pressure. A missing "full" line (cpu on
+    // older kernels) is left zeroed; false if there is no "some" line.
+    bool parsePressure(const char* buf, size_t len, PsiLine& some, PsiLine& full);
+    // The v2 entry ("0::/path") of /proc/<pid>/cgroup; path points into buf. False on v1-only hosts.
+    bool parseCgroupV2(const char* buf, size_t len, const char*& path, size_t& path_len);
+    // usage_usec from a cgroup's cpu.stat.
+    bool parseCpuStatUsage(const char* buf, size_t len, uint64_t& usage_usec);
+    // rbytes and wbytes summed over the device lines of a cgroup's io.stat.
+    void parseIoStat(const char* buf, size_t len, uint64_t& rbytes, uint64_t& wbytes);
+}
+
+#endif
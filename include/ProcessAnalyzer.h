@@ -2,44 +2,118 @@
 #define PROCESS_ANALYZER_H
 
 #include "ProcessInfo.h"
-#include "SystemUtils.h"
+#include "Snapshot.h"
+#include "Collector.h"
+#include "Options.h"
+#include "SelfStats.h"
+#include "FilterEngine.h"
+#include "DisplayEngine.h"
+#include "ProcessLogger.h"
+#include "GroupBy.h"
 #include <vector>
 #include <map>
 #include <set>
 #include <string>
-#include <fstream>
+#include <memory>
 #include <ncurses.h>
 
 class ProcessAnalyzer
 {
 private:
-    std::vector<ProcessInfo> processes;
-    std::map<pid_t, ProcessInfo> prev_processes;
-    std::map<pid_t, std::vector<pid_t>> process_tree;
-    std::map<pid_t, ProcessInfo> process_map;
+    Options opts;
+    Collector collector;
+    std::shared_ptr<const Snapshot> snapshot;
+    std::vector<uint32_t> rows;    // the current view: snapshot->table row indices, filtered and sorted
+    size_t sorted_upto = 0;        // rows[0, sorted_upto) are in order; the tail is unsorted
+    uint64_t view_gen = 0;         // bumped whenever rows or their order change
+
+    // What the cached body lines were formatted from; any difference reformats them.
+    struct BodyKey {
+        uint64_t view_gen;
+        int scroll, width, lines;
+        bool tree, threads, cgroups, groups;
+        bool operator==(const BodyKey& o) const
+        {
+            return view_gen == o.view_gen && scroll == o.scroll && width == o.width && lines == o.lines &&
+                   tree == o.tree && threads == o.threads && cgroups == o.cgroups && groups == o.groups;
+        }
+    };
+    BodyKey body_key = {~0ull, -1, -1, -1, false, false, false, false};
+    std::vector<DisplayEngine::RowLine> body;
+    DisplayEngine::Frame frame;
     std::set<pid_t> tagged_pids;
-    uint64_t mem_total = 0, mem_free = 0, prev_total_jiffies = 0, prev_work_jiffies = 0;
-    SystemUtils::CPULoadBreakdown cpu_breakdown = {};
-    SystemUtils::MemBreakdown mem_breakdown = {};
-    double system_mem_usage = 0.0, system_cpu_usage = 0.0, poll_interval = 1.0, system_uptime = 0.0;
-    int num_cores = 0, selected_row = 0, scroll_offset = 0, h_scroll_offset = 0;
-    long clk_tck = 0;
-    std::ofstream log_file;
+    std::set<pid_t> collapsed;          // tree view: nodes whose subtree is folded
+    std::vector<char> collapsed_rows;   // the same, as flags by snapshot row
+    double poll_interval = 1.0;
+    int selected_row = 0, scroll_offset = 0, h_scroll_offset = 0;
+    ProcessLogger::Config log_cfg;
+    std::unique_ptr<ProcessLogger::Logger> logger;   // exists while logging is on
     bool logging_enabled = false, tree_view = false, needs_redraw = true, zombie_only = false;
     bool filter_mode = false, search_mode = false, sort_inverted = false;
-    std::string sort_criterion = "cpu", status_msg, filter_input, search_input;
-    std::vector<Filter> filters;
+    bool view_dirty = false, running = true, show_self = false;
+    // Per-core lines between the header and the column header. core_rows survives history frames,
+    // which carry no per-core data, so scrubbing does not move the list.
+    bool show_cores = true;
+    int core_rows = 0;
+    RollingStat ui_cost[UI_PHASE_COUNT];
+    std::string sort_criterion = "cpu", status_msg, filter_input, filter_error, search_input;
+    FilterEngine::Program filter_prog;
     WINDOW *win;
 
+    // Thread view: rows index snapshot->threads and process_rows keeps the filtered processes.
+    // Threads are scanned for thread_scope: what the filter leaves, or else the processes
+    // expanded with H (the selected and tagged ones).
+    bool thread_view = false;
+    std::set<pid_t> expanded;
+    std::vector<pid_t> thread_scope;
+    std::vector<uint32_t> process_rows;
+
+    // Cgroup panel: rows index snapshot->cgroups; process_rows again keeps the filtered processes.
+    bool cgroup_view = false;
+
+    // Group-by view: rows index groups.table, rebuilt from the process rows every update, and
+    // filters and sort keys apply to the groups. Drilling in lists the members of the group
+    // labelled drill_label instead, for as long as that group exists.
+    GroupBy::Key group_by = GroupBy::NONE;
+    GroupBy::Groups groups;
+    bool drilled = false;
+    std::string drill_label;
+
+    // While scrubbing, snapshot is a decoded history frame and live snapshots are ignored.
+    bool history_mode = false;
+    uint64_t history_frame = 0, history_ms = 0;
+
     void updateProcessList();
+    void compileFilter(bool regroup = false);
+    void leaveGroups();
+    void treeOrder();
+    void threadOrder();
+    void cgroupOrder();
+    void groupOrder();
+    bool groupList() const { return group_by != GroupBy::NONE && !drilled; }
+    // Whether rows index snapshot->table; the other views keep the process rows in process_rows.
+    bool processRows() const { return !thread_view && !cgroup_view && !groupList(); }
+    size_t sortWindow() const;
+    int listTop() const { return 4 + core_rows; }     // the column header's line
+    int listLines() const { return getmaxy(win) - listTop() - 2; }
+    void sortView(size_t top);
+    void stepHistory(long ticks);
+    std::string historyLabel() const;
     void handleInput(int ch);
     void render();
+    void publishDemand(const std::vector<pid_t>& visible);
+    void sampleOnce();
+    void writeJSON();
 
 public:
-    ProcessAnalyzer(bool ncurses_init = true);
+    ProcessAnalyzer(bool ncurses_init = true, const Options& opts = Options());
     ~ProcessAnalyzer();
 
     void printJSON();
+    void streamNDJSON();
+    bool dumpBinary();
+    bool readBinary(const std::string& path);
+    bool serveDaemon();
     void run();
 };
 
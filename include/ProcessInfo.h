@@ -6,15 +6,43 @@
 #include <cstdint>
 #include <sys/types.h>
 
+// Per-PID files beyond /proc/<pid>/stat, which is always read. Used to select what a scan
+// collects and to record which fields of a sample are fresh.
+enum ProcessField
+{
+    FIELD_STATUS = 1 << 0,
+    FIELD_IO     = 1 << 1,
+    FIELD_NET    = 1 << 2,
+    FIELD_SMAPS  = 1 << 3,
+    FIELD_FD     = 1 << 4,
+    FIELD_ALL    = FIELD_STATUS | FIELD_IO | FIELD_NET | FIELD_SMAPS | FIELD_FD
+};
+
 struct ProcessInfo
 {
     pid_t pid, ppid;
     char state;
-    std::string cmd, cpus_allowed_list;
+    std::string cmd, cpus_allowed_list, cgroup;
     long rss, num_threads, priority, nice;
     double mem_usage, cpu_usage, io_read_rate, io_write_rate, process_age, net_rx_rate, net_tx_rate;
-    unsigned long utime, stime;
+    unsigned long utime, stime, starttime;
     uint64_t read_bytes, write_bytes, rchar, wchar, voluntary_ctxt_switches, shared_clean, private_dirty, fd_count, net_rx_bytes, net_tx_bytes;
+    unsigned sampled_fields;
+    uint64_t io_tick, net_tick;
+    int processor, uid;
+    uint64_t numa_kb, numa_remote_kb;
+};
+
+// A process seen exiting between two snapshots, from kernel process events. The accounting
+// fields are only valid when taskstats delivered an exit record.
+struct ExitedProcess
+{
+    pid_t pid, ppid;
+    int exit_code;
+    std::string cmd;
+    double cpu_time, lifetime;
+    uint64_t read_bytes, write_bytes, hiwater_rss;
+    bool accounted;
 };
 
 struct SystemStats
@@ -24,11 +52,4 @@ struct SystemStats
     int num_cores;
 };
 
-struct Filter
-{
-    std::string key, op, value;
-    double numeric_val;
-    long long_val;
-};
-
 #endif
@@ -1,13 +1,82 @@
 #ifndef PROCESS_LOGGER_H
 #define PROCESS_LOGGER_H
 
-#include "ProcessInfo.h"
+#include "ProcessTable.h"
 #include <vector>
-#include <fstream>
+#include <deque>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <sys/types.h>
 
 namespace ProcessLogger {
-    void logProcesses(std::ofstream& log_file, const std::vector<ProcessInfo>& processes, std::string& status_msg);
+    enum Column {
+        L_TIME, L_PID, L_PPID, L_STATE, L_CMD, L_MEM, L_CPU, L_IO_R, L_IO_W, L_RCHAR, L_WCHAR,
+        L_SHARED, L_PRIVATE, L_FD, L_THREADS, L_CTXSW, L_AGE, L_PRIO, L_NICE, L_CPUS, L_NET_RX, L_NET_TX, L_LASTCPU,
+        L_COLUMN_COUNT
+    };
+
+    struct Config {
+        std::string path = "process_log.csv";
+        std::vector<int> columns;        // empty = every column
+        size_t rotate_bytes = 0;         // 0 = no size limit
+        int rotate_secs = 0;             // 0 = no time limit
+        int keep = 5;                    // rotated files kept: path.1 (newest) .. path.<keep>
+        bool compress = false;           // gzip rotated files
+    };
+
+    // Comma list of column names, or "all".
+    bool parseColumns(const std::string& list, std::vector<int>& columns);
+    const char* columnList();
+    // FIELD_* bits the given columns read.
+    unsigned fieldsFor(const std::vector<int>& columns);
+
+    void formatHeader(std::string& out, const std::vector<int>& columns);
+    // Appends one CSV line per row. Columns backed by a field outside `fields` are left empty.
+    void formatRows(std::string& out, const ProcessTable& table, const std::vector<uint32_t>& rows,
+                    const std::vector<int>& columns, unsigned fields, time_t now);
+
+    // Formats on the caller's thread into recycled buffers and leaves the file I/O, rotation and
+    // compression to a writer thread. A tick is dropped rather than queued without bound when the
+    // writer falls behind.
+    class Logger
+    {
+    private:
+        Config cfg;
+        std::thread writer;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<std::string> queue, spare;
+        std::string error;
+        size_t dropped = 0;
+        bool stopping = false;
+
+        // Writer thread only.
+        int fd = -1;
+        size_t file_bytes = 0;
+        bool has_rows = false;           // a file holding just the header is never rotated
+        time_t opened = 0;
+        pid_t gzip_pid = -1;             // compressing path.1, reaped on later wakeups
+        time_t rotated = 0;
+
+        void writerLoop();
+        bool openFile(std::string& err);
+        void rotate(std::string& err);
+        void reapGzip(bool block, std::string& err);
+        void keepUncompressed(std::string& err);
+
+    public:
+        explicit Logger(const Config& config);
+        ~Logger();
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        void log(const ProcessTable& table, const std::vector<uint32_t>& rows, unsigned fields);
+        // The last I/O error, if any, plus how many ticks were dropped.
+        std::string status();
+    };
 }
 
 #endif
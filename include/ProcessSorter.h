@@ -1,12 +1,37 @@
 #ifndef PROCESS_SORTER_H
 #define PROCESS_SORTER_H
 
-#include "ProcessInfo.h"
+#include "ProcessTable.h"
+#include "SystemUtils.h"
+#include "GroupBy.h"
 #include <vector>
 #include <string>
 
 namespace ProcessSorter {
-    void sortProcesses(std::vector<ProcessInfo>& processes, const std::string& criterion);
+    // Orders rows by criterion, ties broken by ascending PID; an empty criterion means "pid".
+    // Rates and sizes sort largest first, pid/ppid/cmd/prio/nice smallest first, and inverted
+    // flips only the key. With top > 0 only the first top rows are guaranteed in order; the
+    // rest follow in unspecified order.
+    void sortProcesses(const ProcessTable& table, std::vector<uint32_t>& rows, const std::string& criterion,
+                       bool inverted = false, size_t top = 0);
+
+    // The group list: the same keys over the group table, plus "count" for the member count.
+    void sortGroups(const GroupBy::Groups& groups, std::vector<uint32_t>& rows, const std::string& criterion,
+                    bool inverted = false);
+    // The same keys over thread rows, for the thread view.
+    void sortThreads(const ThreadTable& table, std::vector<uint32_t>& rows, const std::string& criterion,
+                     bool inverted = false);
+    // The cgroup panel: rows index groups, whose paths are in strings.
+    void sortCgroups(const std::vector<SystemUtils::CgroupStats>& groups, const StringPool& strings,
+                     std::vector<uint32_t>& rows, const std::string& criterion, bool inverted = false);
+    // Whether criterion names a process sort key; "count" belongs to the group list only.
+    bool isKey(const std::string& criterion);
+    // The key after criterion in the F6 cycle, which passes through "count" only for groups.
+    const char* nextKey(const std::string& criterion, bool groups = false);
+    // Space-separated process key names, for help and usage text.
+    const char* keyList();
+    // FIELD_* bits that must be sampled for every process to sort by criterion.
+    unsigned fieldsFor(const std::string& criterion);
 }
 
 #endif
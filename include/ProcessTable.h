@@ -0,0 +1,141 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include "ProcessInfo.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Interned strings stored back to back in one arena. Identical commands (hundreds of workers)
+// share a single entry. A lowercase copy of the arena, at the same offsets, backs
+// case-insensitive matching. clear() keeps all capacity for the next scan.
+class StringPool
+{
+private:
+    std::vector<char> arena, folded;
+    std::vector<uint32_t> offsets, lengths;
+    std::vector<uint32_t> slots;
+
+    void grow();
+
+public:
+    StringPool() { clear(); }
+    uint32_t intern(const char* s, size_t len);
+    const char* str(uint32_t id) const { return &arena[offsets[id]]; }
+    const char* lower(uint32_t id) const { return &folded[offsets[id]]; }
+    size_t length(uint32_t id) const { return lengths[id]; }
+    size_t size() const { return offsets.size(); }
+    // The raw arena, NUL-terminated strings back to back; offset(id) locates one in it.
+    const char* data() const { return arena.data(); }
+    size_t dataBytes() const { return arena.size(); }
+    uint32_t offset(uint32_t id) const { return offsets[id]; }
+    size_t bytes() const { return arena.capacity() + folded.capacity() + (offsets.capacity() + lengths.capacity() + slots.capacity()) * sizeof(uint32_t); }
+    void clear();
+
+    // hit[id] = 1 for every string containing needle, ignoring ASCII case. One pass over the
+    // folded arena: after a match the search resumes at the next string.
+    void containing(const std::string& needle, std::vector<uint8_t>& hit) const;
+};
+
+// Resource totals over a process and all of its descendants.
+struct Rollup
+{
+    double cpu, mem, io_r, io_w, net_rx, net_tx;
+};
+
+// The process tree flattened in pre-order, rebuilt once per scan. order[k] is line k of the fully
+// expanded tree; a row's descendants are the subtree_size[row] - 1 lines after it, so a
+// collapsed subtree is skipped in one step. The per-row vectors are indexed by table row.
+struct TreeIndex
+{
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> position;      // row -> k
+    std::vector<uint32_t> subtree_size;  // including the row itself
+    std::vector<uint16_t> depth;
+    std::vector<uint32_t> prefix;        // id in glyphs of the indent drawn before the command
+    std::vector<Rollup> rollup;
+    StringPool glyphs;
+};
+
+// One scan as a column store: row i of every column describes the same process, rows are in
+// PID order, and the process tree is threaded through parent/first_child/next_sibling row
+// indices (-1 = none). Consumers work on row indices instead of copying processes around.
+struct ProcessTable
+{
+    std::vector<pid_t> pid, ppid;
+    std::vector<char> state;
+    std::vector<uint32_t> cmd, cpus_allowed_list;
+    std::vector<uint32_t> cgroup;                      // v2 path; "" unless the scan demanded cgroups
+    std::vector<long> rss, num_threads, priority, nice;
+    std::vector<double> mem_usage, cpu_usage, io_read_rate, io_write_rate, process_age, net_rx_rate, net_tx_rate;
+    std::vector<unsigned long> utime, stime, starttime;
+    std::vector<uint64_t> read_bytes, write_bytes, rchar, wchar, voluntary_ctxt_switches, shared_clean, private_dirty;
+    std::vector<uint64_t> fd_count, net_rx_bytes, net_tx_bytes, io_tick, net_tick;
+    std::vector<int> processor;                        // CPU the main thread last ran on
+    std::vector<int32_t> uid;                          // effective; -1 until status has been read
+    std::vector<uint64_t> numa_kb, numa_remote_kb;     // 0 unless numa_maps was read this scan
+    std::vector<unsigned> sampled_fields;
+    std::vector<int32_t> parent, first_child, next_sibling;
+    std::vector<int32_t> roots;
+    StringPool strings;
+    TreeIndex tree;
+
+    template <class F> void forEachColumn(F& f)
+    {
+        f(pid); f(ppid); f(state); f(cmd); f(cpus_allowed_list); f(cgroup);
+        f(rss); f(num_threads); f(priority); f(nice);
+        f(mem_usage); f(cpu_usage); f(io_read_rate); f(io_write_rate); f(process_age); f(net_rx_rate); f(net_tx_rate);
+        f(utime); f(stime); f(starttime);
+        f(read_bytes); f(write_bytes); f(rchar); f(wchar); f(voluntary_ctxt_switches); f(shared_clean); f(private_dirty);
+        f(fd_count); f(net_rx_bytes); f(net_tx_bytes); f(io_tick); f(net_tick);
+        f(processor); f(numa_kb); f(numa_remote_kb); f(uid);
+        f(sampled_fields);
+        f(parent); f(first_child); f(next_sibling);
+    }
+
+    size_t size() const { return pid.size(); }
+    const char* cmdStr(size_t row) const { return strings.str(cmd[row]); }
+
+    void clear();
+    void resize(size_t n);
+    void resetRow(size_t row);
+    void compact(const std::vector<char>& keep);
+    void linkTree();
+    // Fills tree from parent/first_child/next_sibling and the current rates; run after both.
+    void indexTree();
+    int find(pid_t p) const;
+    ProcessInfo row(size_t i) const;
+    size_t bytes() const;
+};
+
+// Threads of the processes a scan was asked to expand (ScanDemand::thread_pids), grouped by
+// process in PID order and by TID within each. owner is the process's row in the ProcessTable of
+// the same snapshot.
+struct ThreadTable
+{
+    std::vector<pid_t> tid, tgid;
+    std::vector<uint32_t> owner, name;
+    std::vector<char> state;
+    std::vector<int> processor;                  // CPU the thread last ran on
+    std::vector<long> priority, nice;
+    std::vector<unsigned long> utime, stime, starttime;
+    std::vector<uint64_t> voluntary_ctxt_switches, nonvoluntary_ctxt_switches;
+    std::vector<double> cpu_usage, ctxsw_rate;   // percent of one core; switches per second
+    StringPool names;
+
+    template <class F> void forEachColumn(F& f)
+    {
+        f(tid); f(tgid); f(owner); f(name); f(state); f(processor); f(priority); f(nice);
+        f(utime); f(stime); f(starttime); f(voluntary_ctxt_switches); f(nonvoluntary_ctxt_switches);
+        f(cpu_usage); f(ctxsw_rate);
+    }
+
+    size_t size() const { return tid.size(); }
+    const char* nameStr(size_t row) const { return names.str(name[row]); }
+    void clear();
+    void resize(size_t n);
+    void compact(const std::vector<char>& keep);
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SCAN_POOL_H
+#define SCAN_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Persistent worker pool for per-PID scanning. Items are split into one contiguous range per
+// worker; a worker that drains its own range steals from the others, so a few slow PIDs
+// (large smaps_rollup) do not leave the rest of the pool idle.
+class ScanPool
+{
+private:
+    struct Range {
+        std::atomic<size_t> next;
+        size_t end;
+        char pad[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Range[]> ranges;
+    std::mutex mtx;
+    std::condition_variable cv_start, cv_done;
+    const std::function<void(size_t)>* job = nullptr;
+    uint64_t epoch = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void workerLoop(int id);
+    void drain(int id);
+
+public:
+    explicit ScanPool(int threads);
+    ~ScanPool();
+    ScanPool(const ScanPool&) = delete;
+    ScanPool& operator=(const ScanPool&) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SELF_STATS_H
+#define SELF_STATS_H
+
+#include <vector>
+#include <cstddef>
+
+// Median and tail cost of one phase over the recent window, in milliseconds.
+struct PhaseCost
+{
+    double p50_ms, p99_ms;
+    size_t samples;
+};
+
+// The last `window` durations of one phase. Owned by a single thread; percentiles are computed
+// on demand from a copy, so add() stays O(1).
+class RollingStat
+{
+private:
+    std::vector<double> ring;
+    size_t next = 0, count = 0;
+
+public:
+    explicit RollingStat(size_t window = 128) : ring(window) {}
+    void add(double ms);
+    PhaseCost cost() const;
+};
+
+// Phases of the UI thread's refresh, measured in ProcessAnalyzer.
+enum UiPhase { UI_ZOMBIE, UI_FILTER, UI_SORT, UI_GROUP, UI_LOG, UI_RENDER, UI_PHASE_COUNT };
+
+struct UiCosts
+{
+    PhaseCost phases[UI_PHASE_COUNT];
+    static const char* name(int phase);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "ProcessInfo.h"
+#include "ProcessTable.h"
+#include "SystemUtils.h"
+#include "SelfStats.h"
+#include <vector>
+#include <cstdint>
+
+// The collector's own bookkeeping and cost, shown in the header's self-stats lines.
+struct CollectorStats
+{
+    size_t prev_samples, prev_bytes, cached_pids;
+    int open_fds;
+    PhaseCost scan, record, history;                   // whole scan, previous-sample update, history append
+    PhaseCost phases[SystemUtils::PHASE_COUNT];        // per-phase, summed over scan threads
+    uint64_t syscalls, bytes_read;                     // on the tick that produced this snapshot
+};
+
+// One complete sample of the system. Published by the Collector and never modified afterwards.
+struct Snapshot
+{
+    ProcessTable table;
+    ThreadTable threads;                               // empty unless the demand named processes
+    std::vector<ExitedProcess> exited;
+    SystemUtils::CPULoadBreakdown cpu_breakdown = {};
+    std::vector<SystemUtils::CPULoadBreakdown> cores;  // online CPUs in /proc/stat order; not in history
+    int numa_nodes = 0;
+    SystemUtils::Pressure pressure[SystemUtils::PSI_COUNT] = {};   // not in history
+    std::vector<SystemUtils::CgroupStats> cgroups;     // empty unless the demand asked; paths in table.strings
+    SystemUtils::MemBreakdown mem_breakdown = {};
+    SystemStats system = {};
+    CollectorStats self = {};
+    uint64_t sequence = 0;
+    bool event_driven = false;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef SNAPSHOT_FORMAT_H
+#define SNAPSHOT_FORMAT_H
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct Snapshot;
+
+// Binary snapshot written by `pa --dump-binary`: a fixed header with the system totals, a
+// directory of named fixed-width columns and a table of NUL-terminated strings. Every section
+// starts on an 8-byte boundary in host byte order, so a mapped file is used in place.
+//
+// The reader below is header-only and needs nothing else from pa; a consumer can copy this file.
+// Records can be concatenated: the next one starts total_bytes after the current one.
+namespace SnapshotFormat {
+    const char MAGIC[8] = {'P', 'A', 'S', 'N', 'A', 'P', '\0', '\n'};
+    const uint32_t VERSION = 1;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    enum ColumnType { COL_I32 = 1, COL_U32, COL_I64, COL_U64, COL_F64, COL_U8, COL_STR };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;          // BYTE_ORDER_MARK as stored by the writer
+        uint64_t total_bytes;         // the whole record, header included
+        uint64_t sequence;            // collector tick
+        uint64_t time_ms;             // Unix time of the scan
+        uint32_t rows;                // processes, in PID order
+        uint32_t column_count;
+        uint64_t columns_offset;      // Column[column_count], from the start of the record
+        uint64_t strings_offset, strings_bytes;
+
+        // SystemStats
+        double cpu_usage, mem_usage, uptime;
+        uint64_t mem_total, mem_free;  // KB
+        int32_t num_cores;
+        int32_t event_driven;
+
+        // CPULoadBreakdown, percent
+        double cpu_user, cpu_nice, cpu_sys, cpu_idle, cpu_iowait, cpu_irq, cpu_softirq, cpu_steal, cpu_total;
+
+        // MemBreakdown, KB
+        uint64_t mem_bd_total, mem_bd_free, mem_buffers, mem_cached, mem_s_reclaimable, mem_used;
+    };
+
+    // COL_STR cells are byte offsets into the string table.
+    struct Column {
+        char name[24];                // NUL-padded
+        uint32_t type;
+        uint32_t width;               // bytes per cell
+        uint64_t offset;              // from the start of the record
+    };
+
+    static_assert(sizeof(Header) == 240, "snapshot header layout changed");
+    static_assert(sizeof(Column) == 40, "snapshot column layout changed");
+
+    // Appends one record for snap to out.
+    void write(const Snapshot& snap, uint64_t time_ms, std::string& out);
+
+    class Reader;
+    // Rebuilds a Snapshot (table, tree index, totals) from a record.
+    bool read(const Reader& in, Snapshot& snap, std::string& error);
+
+    // Validates a record in memory, or maps a file, and hands out typed column pointers.
+    class Reader
+    {
+    private:
+        const char* base = NULL;
+        size_t length = 0;
+        void* map = NULL;
+        size_t map_length = 0;
+        std::vector<uint64_t> owned;     // 8-byte aligned copy when the input cannot be mapped
+
+        bool fail(std::string& error, const char* why) { error = why; base = NULL; return false; }
+        // Whether size bytes at offset fit in total bytes.
+        static bool within(uint64_t offset, uint64_t size, uint64_t total) { return offset <= total && size <= total - offset; }
+
+    public:
+        Reader() {}
+        ~Reader() { if (map) munmap(map, map_length); }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Maps a regular file; anything else (a pipe, /dev/stdin) is read into memory.
+        bool open(const char* path, std::string& error)
+        {
+            int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) < 0) {
+                if (fd >= 0) close(fd);
+                error = std::string("cannot open ") + path;
+                return false;
+            }
+            if (S_ISREG(st.st_mode) && st.st_size > 0) {
+                map_length = (size_t)st.st_size;
+                map = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) map = NULL;
+            }
+            if (map) {
+                close(fd);
+                return attach(map, map_length, error);
+            }
+            size_t used = 0;
+            for (;;) {
+                if (used + 65536 > owned.size() * 8) owned.resize(owned.size() + 65536 / 8 + owned.size() / 2);
+                ssize_t n = ::read(fd, (char*)owned.data() + used, owned.size() * 8 - used);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                used += (size_t)n;
+            }
+            close(fd);
+            return attach(owned.data(), used, error);
+        }
+
+        // data must stay valid, and 8-byte aligned, for the reader's lifetime.
+        bool attach(const void* data, size_t len, std::string& error)
+        {
+            base = (const char*)data;
+            length = len;
+            if (len < sizeof(Header) || ((uintptr_t)data & 7)) return fail(error, "not a snapshot record");
+            const Header& h = header();
+            if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0) return fail(error, "not a snapshot record");
+            if (h.byte_order != BYTE_ORDER_MARK) return fail(error, "snapshot has the wrong byte order");
+            if (h.version != VERSION) return fail(error, "unsupported snapshot version");
+            // Every size is a product of two 32-bit fields, so it fits in 64 bits; offsets are
+            // untrusted and compared before subtracting so that none of the checks can wrap.
+            if (h.total_bytes > len || (h.columns_offset & 7) ||
+                !within(h.columns_offset, (uint64_t)h.column_count * sizeof(Column), h.total_bytes) ||
+                !within(h.strings_offset, h.strings_bytes, h.total_bytes) ||
+                (h.strings_bytes && base[h.strings_offset + h.strings_bytes - 1]))
+                return fail(error, "truncated snapshot");
+            for (uint32_t i = 0; i < h.column_count; i++) {
+                const Column& c = columns()[i];
+                if ((c.offset & 7) || !within(c.offset, (uint64_t)c.width * h.rows, h.total_bytes))
+                    return fail(error, "corrupt snapshot column");
+            }
+            length = h.total_bytes;
+            return true;
+        }
+
+        bool valid() const { return base != NULL; }
+        const Header& header() const { return *(const Header*)base; }
+        size_t bytes() const { return length; }
+        uint32_t rows() const { return header().rows; }
+        const Column* columns() const { return (const Column*)(base + header().columns_offset); }
+
+        const Column* find(const char* name) const
+        {
+            for (uint32_t i = 0; i < header().column_count; i++)
+                if (strncmp(columns()[i].name, name, sizeof(columns()[i].name)) == 0) return &columns()[i];
+            return NULL;
+        }
+
+        // NULL when the column is missing or has another type, e.g. from a newer writer.
+        template<typename T>
+        const T* column(const char* name, ColumnType type) const
+        {
+            const Column* c = find(name);
+            if (!c || c->type != (uint32_t)type || c->width != sizeof(T)) return NULL;
+            return (const T*)(base + c->offset);
+        }
+
+        const char* string(uint32_t offset) const
+        {
+            const Header& h = header();
+            return offset < h.strings_bytes ? base + h.strings_offset + offset : "";
+        }
+    };
+}
+
+#endif
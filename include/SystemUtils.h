@@ -2,9 +2,15 @@
 #define SYSTEM_UTILS_H
 
 #include "ProcessInfo.h"
+#include "ProcessTable.h"
+#include "ScanPool.h"
+#include "ProcParse.h"
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <atomic>
 
 namespace SystemUtils {
     struct CPULoadBreakdown {
@@ -16,9 +22,10 @@ namespace SystemUtils {
         double irq;
         double softirq;
         double steal;
-        double total;
+        double total;                  // busy: everything but idle and iowait
         
-        uint64_t prev_u, prev_n, prev_s, prev_i, prev_iw, prev_ir, prev_si, prev_st;
+        uint64_t prev_u, prev_n, prev_s, prev_i, prev_iw, prev_ir, prev_si, prev_st, prev_total;
+        int cpu, node;                 // per-core entries only; node is 0 without NUMA
     };
 
     struct MemBreakdown {
@@ -30,19 +37,191 @@ namespace SystemUtils {
         uint64_t shorthand_used;
     };
 
-    void scanProcesses(std::vector<ProcessInfo>& processes, 
-                        std::map<pid_t, std::vector<pid_t>>& process_tree, 
-                        std::map<pid_t, ProcessInfo>& process_map,
+    // Open descriptors for one /proc/<pid> directory, re-read with pread() each tick.
+    struct PidHandles {
+        int dir_fd, stat_fd, status_fd, io_fd, net_fd, smaps_fd, fd_dir_fd, task_fd;
+        unsigned long long starttime;
+        uint64_t generation;
+        std::string cgroup;                           // from /proc/<pid>/cgroup, re-read now and then
+        uint64_t cgroup_tick;                         // generation it was read at, 0 = never
+    };
+
+    // The same for one /proc/<pid>/task/<tid>, opened through the owner's task_fd.
+    struct TaskHandles {
+        int stat_fd, status_fd;
+        unsigned long long starttime;
+        uint64_t generation;
+    };
+
+    // One cgroup v2 directory, plus the counters last read from it for rates.
+    struct CgroupHandles {
+        int dir_fd, cpu_fd, mem_fd, io_fd, psi_fd;
+        uint64_t usage_usec, rbytes, wbytes;
+        uint64_t cpu_tick, io_tick;                   // generation of the counters above, 0 = none
+        uint64_t generation;
+    };
+
+    enum PsiResource { PSI_CPU, PSI_MEMORY, PSI_IO, PSI_COUNT };
+
+    struct ProcFdCache {
+        std::unordered_map<pid_t, PidHandles> entries;
+        std::unordered_map<pid_t, TaskHandles> tasks;    // by TID, for the threads last scanned
+        std::unordered_map<std::string, CgroupHandles> cgroups;   // by path, for the cgroups last scanned
+        std::string proc_root = "/proc", cgroup_root = "/sys/fs/cgroup";
+        int proc_fd = -1, meminfo_fd = -1, stat_fd = -1, cgroup_fd = -1;
+        int psi_fds[PSI_COUNT] = {-1, -1, -1};
+        std::vector<char> stat_buf;                       // /proc/stat, sized for every cpu line
+        std::vector<ProcParse::CpuTimes> stat_cpus;       // one per configured cpu, grown on demand
+        std::atomic<int> open_fds{0};
+        std::atomic<uint64_t> syscalls{0}, bytes_read{0};    // running totals for the self stats
+        int max_fds = 0;
+        uint64_t generation = 0;
+
+        ProcFdCache();
+        ~ProcFdCache();
+        ProcFdCache(const ProcFdCache&) = delete;
+        ProcFdCache& operator=(const ProcFdCache&) = delete;
+        void evict(pid_t pid);
+        void closeAll();
+    };
+
+    // The parts of a sample later ticks need for rates and carried-forward fields: scalars only,
+    // no command strings.
+    struct PrevSample {
+        unsigned long starttime, utime, stime;
+        uint64_t read_bytes, write_bytes, rchar, wchar, voluntary_ctxt_switches;
+        uint64_t shared_clean, private_dirty, fd_count, net_rx_bytes, net_tx_bytes, io_tick, net_tick;
+        double io_read_rate, io_write_rate, net_rx_rate, net_tx_rate;
+        uint32_t cpus_allowed;                        // PrevSampleStore::affinity() id, 0 = unknown
+        int32_t uid;
+        uint64_t generation;
+    };
+
+    // Previous samples keyed by PID. Every record() stamps the PIDs of that scan with a new
+    // generation and drops the rest, so the store never outgrows the live process count.
+    class PrevSampleStore {
+    private:
+        std::unordered_map<pid_t, PrevSample> samples;
+        uint64_t generation = 0;
+        // Distinct Cpus_allowed_list strings, so ticks that skip status keep each process's list.
+        // There are only ever a handful; pool_ids maps a table's string ids to them per record().
+        std::vector<std::string> affinities = std::vector<std::string>(1);
+        std::unordered_map<std::string, uint32_t> affinity_ids;
+        std::vector<uint32_t> pool_ids;
+
+    public:
+        const PrevSample* find(pid_t pid, unsigned long starttime) const;
+        const std::string& affinity(uint32_t id) const { return affinities[id]; }
+        void record(const ProcessTable& table);
+        void erase(pid_t pid) { samples.erase(pid); }
+        size_t size() const { return samples.size(); }
+        size_t bytes() const;
+    };
+
+    // Thread counterpart of PrevSample, keyed by TID.
+    struct ThreadSample {
+        unsigned long starttime, utime, stime;
+        uint64_t voluntary_ctxt_switches, nonvoluntary_ctxt_switches;
+        uint64_t generation;
+    };
+
+    class ThreadSampleStore {
+    private:
+        std::unordered_map<pid_t, ThreadSample> samples;
+        uint64_t generation = 0;
+
+    public:
+        const ThreadSample* find(pid_t tid, unsigned long starttime) const;
+        void record(const ThreadTable& threads);
+        size_t size() const { return samples.size(); }
+    };
+
+    // Which expensive files to read on a tick. Hot PIDs (visible, tagged or filtered rows) and
+    // PIDs due for their periodic refresh get every field; the rest only get all_fields and carry
+    // the other values over from their previous sample.
+    struct ScanDemand {
+        unsigned all_fields = FIELD_ALL;
+        std::unordered_set<pid_t> hot_pids;
+        int refresh_ticks = 1;
+        std::unordered_set<pid_t> thread_pids;        // processes whose threads are scanned too
+        std::unordered_set<pid_t> numa_pids;          // processes whose numa_maps are read
+        bool cgroups = false;                         // map processes to cgroups, for scanCgroups
+    };
+
+    enum ScanPhase {
+        PHASE_WALK, PHASE_STAT, PHASE_STATUS, PHASE_IO, PHASE_NET, PHASE_SMAPS, PHASE_FD,
+        PHASE_TABLE, PHASE_RATES, PHASE_THREADS, PHASE_NUMA, PHASE_CGROUP, PHASE_COUNT
+    };
+
+    // Nanoseconds spent in each phase of one scan. Per-PID phases are summed over all scan
+    // threads, so with a pool they can add up to more than the scan's wall time.
+    struct ScanTimings {
+        std::atomic<uint64_t> ns[PHASE_COUNT];
+
+        ScanTimings() { reset(); }
+        void reset() { for (int p = 0; p < PHASE_COUNT; p++) ns[p] = 0; }
+        static const char* name(int phase);
+    };
+
+    void scanProcesses(ProcessTable& table,
                         uint64_t& mem_total, uint64_t& mem_free,
                         double& system_mem_usage, double& system_cpu_usage,
                         uint64_t& prev_total_jiffies, uint64_t& prev_work_jiffies,
-                        std::map<pid_t, ProcessInfo>& prev_processes,
+                        const PrevSampleStore& prev_samples,
                         int num_cores, long clk_tck, double system_uptime,
                         double poll_interval, std::string& status_msg,
                         CPULoadBreakdown& cpu_breakdown,
-                        MemBreakdown& mem_breakdown);
+                        std::vector<CPULoadBreakdown>& core_breakdown,
+                        MemBreakdown& mem_breakdown,
+                        ProcFdCache& fd_cache, ScanPool* pool,
+                        const ScanDemand& demand, const std::vector<pid_t>* pid_list,
+                        ScanTimings* timings = NULL);
     
-    double getUptime();
+    // Fills threads for the rows of table whose PID is in demand.thread_pids. cpu_scale turns a
+    // thread's jiffies this tick into the percent units of ProcessTable::cpu_usage; interval is
+    // the tick length in seconds, for the context-switch rates.
+    void scanThreads(const ProcessTable& table, ThreadTable& threads, const ThreadSampleStore& prev_samples,
+                     double cpu_scale, double interval, ProcFdCache& fd_cache, ScanPool* pool,
+                     const ScanDemand& demand, ScanTimings* timings = NULL);
+
+    // Per-node memory from /proc/<pid>/numa_maps for the processes in demand.numa_pids: sets
+    // numa_kb and numa_remote_kb, the part on nodes other than the one of the process's last CPU
+    // (cpu_node maps cpu to node). numa_maps walks the page tables, so it is read on demand only.
+    void scanNumaMaps(ProcessTable& table, const std::vector<int>& cpu_node, ProcFdCache& fd_cache,
+                      const ScanDemand& demand, ScanTimings* timings = NULL);
+
+    // System-wide stall averages from /proc/pressure; valid is false where the kernel has no PSI.
+    struct Pressure {
+        ProcParse::PsiLine some, full;
+        bool valid;
+    };
+    void readPressure(ProcFdCache& fd_cache, Pressure* out);    // out[PSI_COUNT]
+
+    // One cgroup with processes in the table: sums over its member rows, then what its own
+    // controller files report. Controller values missing from the have bits print as "-".
+    enum { CG_CPU = 1, CG_MEM = 2, CG_IO = 4, CG_PSI = 8 };
+    struct CgroupStats {
+        uint32_t path;                                // string id in the table's pool
+        uint32_t procs;
+        long threads, rss;
+        double cpu, io_r, io_w, net_rx, net_tx;       // same units as the process columns
+        double cg_cpu;                                // cpu.stat usage, % of one core
+        uint64_t mem_current;                         // memory.current, bytes
+        double cg_io_r, cg_io_w;                      // io.stat, KB/s
+        double psi_cpu;                               // cpu.pressure "some" avg10
+        unsigned have;
+    };
+
+    // Aggregates the table by its cgroup column in one pass, then reads cpu.stat, memory.current,
+    // io.stat and cpu.pressure of each cgroup found. Nothing is walked under cgroup_root; a
+    // cgroup without processes is not listed. Does nothing unless demand.cgroups is set.
+    void scanCgroups(const ProcessTable& table, std::vector<CgroupStats>& out, ProcFdCache& fd_cache,
+                     double interval, const ScanDemand& demand, ScanTimings* timings = NULL);
+
+    double getUptime(const std::string& proc_root = "/proc");
+    // NUMA node of each cpu from sys_root/devices/system/node/node*/cpulist, indexed by cpu
+    // number; returns the node count, 0 (and no entries) where the kernel has no NUMA support.
+    int readCpuNodes(std::vector<int>& node_of_cpu, const std::string& sys_root = "/sys");
 }
 
 #endif
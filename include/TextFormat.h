@@ -0,0 +1,23 @@
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Appends numbers and quoted text to a reusable buffer without going through printf or
+// iostreams. Shared by the CSV log and the JSON output.
+namespace TextFormat {
+    void appendUint(std::string& out, uint64_t v);
+    void appendInt(std::string& out, int64_t v);
+    // Rounded to `decimals` places (0..6); NaN and infinities are written as 0.
+    void appendFixed(std::string& out, double v, int decimals = 2);
+
+    // RFC 4180 field: quoted only when it holds a separator, quote or line break.
+    void appendCsv(std::string& out, const char* s, size_t len);
+    // Quoted JSON string. Control characters are escaped and bytes that are not valid UTF-8
+    // become U+FFFD, since command lines can hold anything.
+    void appendJson(std::string& out, const char* s, size_t len);
+}
+
+#endif
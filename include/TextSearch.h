@@ -0,0 +1,25 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+
+// Substring search over ASCII-lowered text. The widest kernel the CPU supports is picked once at
+// startup; callers lower the needle with lower() and search pre-lowered haystacks.
+namespace TextSearch {
+    enum Isa { ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_COUNT };
+
+    // Writes the ASCII-lowercase form of src[0..n) to dst (may alias src).
+    void lower(const char* src, size_t n, char* dst);
+
+    // First occurrence of needle[0..m) in hay[0..n), or NULL.
+    const char* find(const char* hay, size_t n, const char* needle, size_t m);
+
+    // The same search forced onto one kernel, for benchmarking; falls back to scalar when the
+    // CPU lacks it.
+    const char* find(Isa isa, const char* hay, size_t n, const char* needle, size_t m);
+
+    Isa best();
+    const char* isaName(Isa isa);
+}
+
+#endif
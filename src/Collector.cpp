@@ -0,0 +1,299 @@
+#include "Collector.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Full /proc walks still happen this often in event mode, to catch anything the events missed.
+static const int EVENT_RESYNC_TICKS = 60;
+static const size_t MAX_EXITED_PER_TICK = 4096;
+static const size_t MAX_EXEC_COMMS = 65536;
+// A segment must hold a full frame of every process, about 25 bytes each, so the ring is split
+// into 2 MB segments: wrapping discards the oldest quarter of the default 8 MB.
+static const size_t HISTORY_SEGMENT_MB = 2;
+
+Collector::Collector(const Options& opts)
+{
+    if (opts.scan_threads > 1) scan_pool.reset(new ScanPool(opts.scan_threads));
+    clk_tck = sysconf(_SC_CLK_TCK);
+    num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    numa_nodes = SystemUtils::readCpuNodes(cpu_node);
+    demand.all_fields = opts.fields;
+    demand.refresh_ticks = 0;
+    fd_cache.proc_root = opts.proc_root;
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    publish_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (opts.proc_events && !events.open(events_error))
+        events_error = "Process events unavailable (" + events_error + "), polling /proc";
+    if (opts.history_mb > 0) {
+        size_t segments = std::max<size_t>(2, opts.history_mb / HISTORY_SEGMENT_MB);
+        size_t segment = (size_t)opts.history_mb * 1024 * 1024 / segments;
+        history_ring.reset(new History(segment, segments, opts.history_file, history_error));
+        if (!history_error.empty()) history_ring.reset();
+    }
+}
+
+Collector::~Collector()
+{
+    stop();
+    if (wake_fd >= 0) close(wake_fd);
+    if (publish_fd >= 0) close(publish_fd);
+}
+
+std::shared_ptr<const Snapshot> Collector::latest() const
+{
+    return std::atomic_load(&current);
+}
+
+static std::string readComm(int proc_fd, pid_t pid)
+{
+    char path[32], buf[64];
+    snprintf(path, sizeof(path), "%d/comm", pid);
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return std::string();
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return std::string();
+    if (buf[n - 1] == '\n') n--;
+    return std::string(buf, n);
+}
+
+ExitedProcess* Collector::exitRecord(pid_t pid)
+{
+    auto it = exited_index.find(pid);
+    if (it != exited_index.end()) return &exited[it->second];
+    if (exited.size() >= MAX_EXITED_PER_TICK) return NULL;
+    ExitedProcess x = ExitedProcess();
+    x.pid = pid;
+    exited_index[pid] = exited.size();
+    exited.push_back(x);
+    return &exited.back();
+}
+
+// Applies pending fork/exec/exit events: new processes join the live set right away and exited
+// ones are dropped from the fd cache and previous samples without waiting for a /proc walk.
+void Collector::handleEvents()
+{
+    if (!events.active()) return;
+    event_buf.clear();
+    if (!events.drain(event_buf)) need_walk = true;
+
+    for (const auto &e : event_buf) {
+        switch (e.type) {
+        case ProcEvent::FORK:
+            live_pids.insert(e.pid);
+            break;
+        case ProcEvent::EXEC:
+            live_pids.insert(e.pid);
+            if (exec_comm.size() < MAX_EXEC_COMMS) exec_comm[e.pid] = readComm(fd_cache.proc_fd, e.pid);
+            break;
+        case ProcEvent::EXIT: {
+            live_pids.erase(e.pid);
+            fd_cache.evict(e.pid);
+            prev_samples.erase(e.pid);
+            ExitedProcess* x = exitRecord(e.pid);
+            if (x) {
+                x->ppid = e.ppid;
+                x->exit_code = e.exit_code;
+                std::shared_ptr<const Snapshot> last = latest();
+                int seen = last ? last->table.find(e.pid) : -1;
+                if (seen >= 0) x->cmd = last->table.cmdStr(seen);
+                else if (x->cmd.empty() && exec_comm.count(e.pid)) x->cmd = exec_comm[e.pid];
+            }
+            exec_comm.erase(e.pid);
+            break;
+        }
+        case ProcEvent::ACCOUNTING: {
+            ExitedProcess* x = exitRecord(e.pid);
+            if (!x) break;
+            x->accounted   = true;
+            x->cpu_time    = (double)e.cpu_us / 1e6;
+            x->lifetime    = (double)e.lifetime_us / 1e6;
+            x->read_bytes  = e.read_bytes;
+            x->write_bytes = e.write_bytes;
+            x->hiwater_rss = e.hiwater_rss;
+            if (!x->ppid) x->ppid = e.ppid;
+            if (x->cmd.empty()) x->cmd = e.comm;
+            break;
+        }
+        }
+    }
+}
+
+// Scans into the spare buffer (an old snapshot nobody holds any more, so its vectors keep their
+// capacity) and publishes it with a single pointer swap.
+std::shared_ptr<const Snapshot> Collector::collect()
+{
+    std::shared_ptr<Snapshot> snap;
+    if (spare && spare.use_count() == 1) snap.swap(spare);
+    else snap = std::make_shared<Snapshot>();
+    spare.reset();
+
+    SystemUtils::ScanDemand tick_demand;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tick_demand = demand;
+    }
+
+    handleEvents();
+    std::vector<pid_t> event_pids;
+    bool walk = !events.active() || need_walk || ++ticks_since_walk >= EVENT_RESYNC_TICKS;
+    if (!walk) {
+        event_pids.assign(live_pids.begin(), live_pids.end());
+        std::sort(event_pids.begin(), event_pids.end());
+    }
+
+    std::string status;
+    SystemStats& sys = snap->system;
+    sys.uptime = SystemUtils::getUptime(fd_cache.proc_root);
+    sys.num_cores = num_cores;
+    timings.reset();
+    uint64_t jiffies_before = prev_total_jiffies;
+    auto t0 = std::chrono::steady_clock::now();
+    SystemUtils::scanProcesses(snap->table, sys.mem_total, sys.mem_free, sys.mem_usage, sys.cpu_usage,
+                               prev_total_jiffies, prev_work_jiffies, prev_samples,
+                               num_cores, clk_tck, sys.uptime, poll_interval, status,
+                               cpu_breakdown, core_breakdown, snap->mem_breakdown, fd_cache, scan_pool.get(),
+                               tick_demand, walk ? NULL : &event_pids, &timings);
+    // Thread CPU uses the same jiffy interval as process CPU, so one thread of a single-threaded
+    // process reads the same as the process.
+    double cpu_scale = jiffies_before && prev_total_jiffies > jiffies_before
+                       ? 100.0 * num_cores / (double)(prev_total_jiffies - jiffies_before) : 0;
+    SystemUtils::scanThreads(snap->table, snap->threads, thread_samples, cpu_scale, poll_interval,
+                             fd_cache, scan_pool.get(), tick_demand, &timings);
+    SystemUtils::scanNumaMaps(snap->table, cpu_node, fd_cache, tick_demand, &timings);
+    SystemUtils::scanCgroups(snap->table, snap->cgroups, fd_cache, poll_interval, tick_demand, &timings);
+    SystemUtils::readPressure(fd_cache, snap->pressure);
+    auto t1 = std::chrono::steady_clock::now();
+    prev_samples.record(snap->table);
+    thread_samples.record(snap->threads);
+    auto t2 = std::chrono::steady_clock::now();
+
+    scan_cost.add(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    record_cost.add(std::chrono::duration<double, std::milli>(t2 - t1).count());
+    for (int p = 0; p < SystemUtils::PHASE_COUNT; p++) {
+        phase_cost[p].add(timings.ns[p] / 1e6);
+        snap->self.phases[p] = phase_cost[p].cost();
+    }
+    snap->self.scan = scan_cost.cost();
+    snap->self.record = record_cost.cost();
+    snap->self.history = history_cost.cost();
+    uint64_t syscalls = fd_cache.syscalls, bytes_read = fd_cache.bytes_read;
+    snap->self.syscalls = syscalls - last_syscalls;
+    snap->self.bytes_read = bytes_read - last_bytes_read;
+    last_syscalls = syscalls;
+    last_bytes_read = bytes_read;
+    if (events.active() && walk) {
+        live_pids.clear();
+        live_pids.insert(snap->table.pid.begin(), snap->table.pid.end());
+        for (auto it = exec_comm.begin(); it != exec_comm.end(); ) {
+            if (live_pids.count(it->first)) ++it;
+            else it = exec_comm.erase(it);
+        }
+        ticks_since_walk = 0;
+        need_walk = false;
+    }
+
+    snap->exited.swap(exited);
+    exited.clear();
+    exited_index.clear();
+    snap->event_driven = events.active();
+    snap->self.prev_samples = prev_samples.size();
+    snap->self.prev_bytes = prev_samples.bytes();
+    snap->self.cached_pids = fd_cache.entries.size();
+    snap->self.open_fds = fd_cache.open_fds;
+    snap->cpu_breakdown = cpu_breakdown;
+    for (SystemUtils::CPULoadBreakdown& c : core_breakdown)
+        c.node = c.cpu < (int)cpu_node.size() ? cpu_node[c.cpu] : 0;
+    snap->cores = core_breakdown;
+    snap->numa_nodes = numa_nodes;
+    snap->sequence = ++sequence;
+
+    std::shared_ptr<const Snapshot> published = snap;
+    std::shared_ptr<const Snapshot> old = std::atomic_exchange(&current, published);
+    if (old) spare = std::const_pointer_cast<Snapshot>(old);
+    // Taking the lock orders the publish against a waiter's predicate check, so no wakeup is lost.
+    { std::lock_guard<std::mutex> lock(mtx); }
+    published_cv.notify_all();
+    uint64_t one = 1;
+    if (publish_fd >= 0 && write(publish_fd, &one, sizeof(one)) < 0) {}
+
+    // Its cost shows up in the next snapshot's self-stats.
+    if (history_ring) {
+        auto t3 = std::chrono::steady_clock::now();
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        history_ring->append(*published, now_ms);
+        history_cost.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t3).count());
+    }
+    return published;
+}
+
+std::shared_ptr<const Snapshot> Collector::waitNewer(uint64_t after, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    published_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, after] {
+        std::shared_ptr<const Snapshot> s = latest();
+        return s && s->sequence > after;
+    });
+    return latest();
+}
+
+void Collector::setDemand(const SystemUtils::ScanDemand& d)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    demand = d;
+}
+
+// Ticks on a fixed schedule so the scan time does not stretch the sampling period. Between
+// ticks it sleeps in poll() on the event sockets so process events are applied as they arrive.
+void Collector::loop()
+{
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(poll_interval));
+    auto next = std::chrono::steady_clock::now() + period;
+    while (!stopping) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next) {
+            collect();
+            next += period;
+            now = std::chrono::steady_clock::now();
+            if (next < now) next = now + period;
+            continue;
+        }
+
+        pollfd fds[3];
+        int nfds = 0;
+        fds[nfds++] = {wake_fd, POLLIN, 0};
+        if (events.connectorFd() >= 0) fds[nfds++] = {events.connectorFd(), POLLIN, 0};
+        if (events.taskstatsFd() >= 0) fds[nfds++] = {events.taskstatsFd(), POLLIN, 0};
+        int wait_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+        if (poll(fds, nfds, wait_ms) <= 0) continue;
+        if (fds[0].revents) {
+            uint64_t v;
+            if (read(wake_fd, &v, sizeof(v)) < 0) {}
+        }
+        handleEvents();
+    }
+}
+
+void Collector::start(double interval)
+{
+    if (worker.joinable()) return;
+    poll_interval = interval;
+    stopping = false;
+    worker = std::thread(&Collector::loop, this);
+}
+
+void Collector::stop()
+{
+    if (!worker.joinable()) return;
+    stopping = true;
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {}
+    worker.join();
+}
@@ -0,0 +1,377 @@
+#include "Daemon.h"
+#include "JsonOutput.h"
+#include "ProcessSorter.h"
+#include "SnapshotFormat.h"
+#include "TextFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A request line longer than this is an error, and a client that lets this much output pile up
+// without reading it is dropped.
+static const size_t MAX_LINE = 64 * 1024;
+static const size_t MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+// Connections past this are turned away. The collector's fd cache leaves room for all of them.
+static const size_t MAX_CLIENTS = 1000;
+
+Daemon::Daemon(Collector& c, const Options& options) : collector(c), opts(options)
+{
+}
+
+Daemon::~Daemon()
+{
+    std::vector<int> fds;
+    for (const auto& c : clients) fds.push_back(c.first);
+    for (int fd : fds) drop(fd);
+    if (listen_fd >= 0) ::close(listen_fd);
+    if (bound) unlink(path.c_str());
+    if (epoll_fd >= 0) ::close(epoll_fd);
+}
+
+bool Daemon::listen(std::string& error)
+{
+    path = opts.socket_path;
+    if (path.empty()) {
+        const char* runtime = getenv("XDG_RUNTIME_DIR");
+        if (runtime && *runtime) path = std::string(runtime) + "/pa.sock";
+        else path = "/tmp/pa-" + std::to_string(getuid()) + ".sock";
+    }
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) { error = "socket path too long: " + path; return false; }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) { error = std::string("socket: ") + strerror(errno); return false; }
+    int rc = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc < 0 && errno == EADDRINUSE) {
+        // Left behind by a daemon that did not exit cleanly, unless something still answers.
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) ::close(probe);
+        struct stat st;
+        if (live || lstat(path.c_str(), &st) < 0 || !S_ISSOCK(st.st_mode)) {
+            error = live ? "another daemon is serving " + path : path + " exists and is not a socket";
+            return false;
+        }
+        unlink(path.c_str());
+        rc = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    bound = rc == 0;
+    if (rc < 0 || ::listen(listen_fd, 128) < 0) {
+        error = "cannot listen on " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    collector.reserveFds((int)MAX_CLIENTS + 8);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) { error = std::string("epoll: ") + strerror(errno); return false; }
+    struct epoll_event e = {};
+    e.events = EPOLLIN;
+    e.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &e);
+    e.data.fd = collector.publishFd();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, collector.publishFd(), &e);
+    return true;
+}
+
+void Daemon::run(const volatile sig_atomic_t& stop)
+{
+    struct epoll_event events[64];
+    onSnapshot();
+    while (!stop) {
+        int n = epoll_wait(epoll_fd, events, 64, 200);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) { acceptClients(); continue; }
+            if (fd == collector.publishFd()) {
+                uint64_t v;
+                if (read(fd, &v, sizeof(v)) < 0) {}
+                onSnapshot();
+                continue;
+            }
+            auto it = clients.find(fd);
+            if (it == clients.end()) continue;
+            Client& c = *it->second;
+            uint32_t ev = events[i].events;
+            if (ev & EPOLLERR) { drop(fd); continue; }
+            if ((ev & (EPOLLIN | EPOLLHUP)) && !c.read_closed) readClient(c);
+            // Both directions are gone, so nothing queued can be delivered.
+            if ((ev & EPOLLHUP) || !flush(c)) drop(fd);
+        }
+    }
+}
+
+void Daemon::acceptClients()
+{
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            // Out of descriptors: stop watching the listener until a client goes away, or the
+            // pending connection would wake every epoll_wait.
+            if (errno == EMFILE || errno == ENFILE) {
+                struct epoll_event e = {};
+                e.data.fd = listen_fd;
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &e);
+                accepting = false;
+            }
+            return;
+        }
+        if (clients.size() >= MAX_CLIENTS) {
+            static const char busy[] = "{\"error\":\"too many clients\"}\n";
+            if (::send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {}
+            ::close(fd);
+            continue;
+        }
+        std::unique_ptr<Client> c(new Client());
+        c->fd = fd;
+        c->events = EPOLLIN;
+        struct epoll_event e = {};
+        e.events = EPOLLIN;
+        e.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &e) < 0) { ::close(fd); continue; }
+        clients[fd] = std::move(c);
+    }
+}
+
+void Daemon::drop(int fd)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    ::close(fd);
+    clients.erase(fd);
+    if (!accepting) {
+        struct epoll_event e = {};
+        e.events = EPOLLIN;
+        e.data.fd = listen_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &e);
+        accepting = true;
+    }
+}
+
+void Daemon::readClient(Client& c)
+{
+    char buf[16384];
+    for (;;) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) { c.read_closed = true; break; }
+        c.in.append(buf, n);
+    }
+    size_t start = 0, nl;
+    while (!c.closing && (nl = c.in.find('\n', start)) != std::string::npos) {
+        handleLine(c, c.in.substr(start, nl - start));
+        start = nl + 1;
+    }
+    c.in.erase(0, start);
+    if (c.in.size() > MAX_LINE) {
+        sendError(c, "request too long");
+        c.closing = true;
+    }
+    // A last request without a newline still counts once the client stops sending.
+    if (c.read_closed && !c.closing && !c.in.empty()) {
+        handleLine(c, c.in);
+        c.in.clear();
+    }
+}
+
+bool Daemon::parseQuery(const std::string& args, Query& q, int* every_ms, std::string& error) const
+{
+    if (opts.json_fields.empty() || !JsonOutput::parseFields(opts.json_fields, q.fields)) q.fields = JsonOutput::defaultFields();
+    q.sort = opts.sort;
+    size_t pos = 0;
+    while (pos < args.size()) {
+        if (args[pos] == ' ' || args[pos] == '\t') { pos++; continue; }
+        size_t end = args.find_first_of(" \t", pos);
+        if (end == std::string::npos) end = args.size();
+        std::string opt = args.substr(pos, end - pos);
+        size_t eq = opt.find('=');
+        std::string name = opt.substr(0, eq), value = eq == std::string::npos ? "" : opt.substr(eq + 1);
+        if (name == "filter" && eq != std::string::npos) {
+            q.filter = args.substr(pos + 7);
+            if (!q.filter.empty() && !FilterEngine::compile(q.filter, q.prog, error)) return false;
+            break;
+        }
+        pos = end;
+        if (name == "fields") {
+            if (!JsonOutput::parseFields(value, q.fields)) { error = "unknown field in " + value; return false; }
+        } else if (name == "sort") {
+            if (!ProcessSorter::isKey(value)) { error = "unknown sort key " + value; return false; }
+            q.sort = value;
+        } else if (name == "reverse" && eq == std::string::npos) {
+            q.reverse = true;
+        } else if (name == "top") {
+            char* stop = NULL;
+            long top = strtol(value.c_str(), &stop, 10);
+            if (value.empty() || *stop || top < 0) { error = "bad top " + value; return false; }
+            q.top = (size_t)top;
+        } else if (name == "format" && (value == "json" || value == "binary")) {
+            q.binary = value == "binary";
+        } else if (name == "every" && every_ms) {
+            *every_ms = atoi(value.c_str());
+        } else {
+            error = "unknown option " + opt;
+            return false;
+        }
+    }
+
+    // Binary records always carry the whole table, so every binary query shares one.
+    if (q.binary) { q.key = "binary"; return true; }
+    for (int f : q.fields) { q.key += std::to_string(f); q.key += ','; }
+    q.key += '|' + q.sort + (q.reverse ? "|r|" : "||") + std::to_string(q.top) + '|' + q.filter;
+    return true;
+}
+
+// One line of JSON, or one binary record, for the current snapshot. Rendered once per tick.
+std::shared_ptr<const std::string> Daemon::render(const Query& q)
+{
+    std::shared_ptr<const std::string>& cached = cache[q.key];
+    if (cached) return cached;
+    std::shared_ptr<std::string> msg = std::make_shared<std::string>();
+    std::string& out = *msg;
+    if (q.binary) {
+        SnapshotFormat::write(*snap, snap_ms, out);
+        cached = msg;
+        return cached;
+    }
+
+    const ProcessTable& t = snap->table;
+    std::vector<uint32_t> rows(t.size());
+    for (uint32_t r = 0; r < t.size(); r++) rows[r] = r;
+    if (!q.prog.empty()) FilterEngine::filterProcesses(t, rows, q.prog);
+    size_t total = rows.size();
+    size_t top = q.top && q.top < rows.size() ? q.top : 0;
+    ProcessSorter::sortProcesses(t, rows, q.sort, q.reverse, top);
+    if (top) rows.resize(top);
+
+    out.reserve(rows.size() * 192 + 256);
+    out += "{\"ts\":";
+    TextFormat::appendUint(out, snap_ms);
+    out += ",\"seq\":";
+    TextFormat::appendUint(out, snap->sequence);
+    out += ",\"system\":";
+    JsonOutput::appendSystem(out, snap->system);
+    out += ",\"total\":";
+    TextFormat::appendUint(out, total);
+    out += ",\"processes\":[";
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i) out += ',';
+        JsonOutput::appendProcess(out, t, rows[i], q.fields, opts.fields);
+    }
+    out += "]}\n";
+    cached = msg;
+    return cached;
+}
+
+void Daemon::handleLine(Client& c, const std::string& raw)
+{
+    std::string line = raw;
+    if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos) return;
+    size_t end = line.find_first_of(" \t", start);
+    std::string cmd = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    std::string args = end == std::string::npos ? "" : line.substr(end);
+
+    std::string error;
+    Query q;
+    if (cmd == "get") {
+        if (!parseQuery(args, q, NULL, error)) { sendError(c, error); return; }
+        if (snap) enqueue(c, render(q));
+        else c.pending.push_back(q);
+    } else if (cmd == "subscribe") {
+        int every_ms = 0;
+        if (!parseQuery(args, q, &every_ms, error)) { sendError(c, error); return; }
+        c.sub = q;
+        c.subscribed = true;
+        c.every = std::max<uint64_t>(1, (uint64_t)std::max(0, every_ms + opts.interval_ms / 2) / opts.interval_ms);
+        c.pushed_seq = 0;
+        if (snap) {
+            enqueue(c, render(q));
+            c.pushed_seq = snap->sequence;
+        }
+    } else if (cmd == "unsubscribe") {
+        c.subscribed = false;
+    } else {
+        sendError(c, "unknown request " + cmd);
+    }
+}
+
+void Daemon::enqueue(Client& c, std::shared_ptr<const std::string> msg)
+{
+    if (c.closing) return;
+    if (c.queued > MAX_QUEUED_BYTES) { c.closing = true; return; }   // not reading its replies
+    c.queued += msg->size();
+    c.out.push_back(msg);
+}
+
+void Daemon::sendError(Client& c, const std::string& error)
+{
+    std::shared_ptr<std::string> msg = std::make_shared<std::string>("{\"error\":");
+    TextFormat::appendJson(*msg, error.data(), error.size());
+    *msg += "}\n";
+    enqueue(c, msg);
+}
+
+// Sends what the socket takes now and watches for EPOLLOUT only while something is left over.
+// False once the client is finished or broken and should be dropped.
+bool Daemon::flush(Client& c)
+{
+    while (!c.out.empty()) {
+        const std::string& m = *c.out.front();
+        ssize_t n = ::send(c.fd, m.data() + c.out_pos, m.size() - c.out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) return false;
+        c.out_pos += n;
+        if (c.out_pos == m.size()) {
+            c.queued -= m.size();
+            c.out.pop_front();
+            c.out_pos = 0;
+        }
+    }
+    if (c.out.empty() && (c.closing || (c.read_closed && c.pending.empty() && !c.subscribed))) return false;
+    uint32_t want = (c.read_closed || c.closing ? 0u : (uint32_t)EPOLLIN) | (c.out.empty() ? 0u : (uint32_t)EPOLLOUT);
+    if (want != c.events) {
+        struct epoll_event e = {};
+        e.events = want;
+        e.data.fd = c.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &e);
+        c.events = want;
+    }
+    return true;
+}
+
+// The first scan has no previous sample and all-zero rates, so clients only ever see later ones.
+void Daemon::onSnapshot()
+{
+    std::shared_ptr<const Snapshot> latest = collector.latest();
+    if (!latest || latest->sequence < 2 || (snap && snap->sequence == latest->sequence)) return;
+    snap = latest;
+    snap_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    cache.clear();
+
+    std::vector<int> dead;
+    for (auto& it : clients) {
+        Client& c = *it.second;
+        for (const Query& q : c.pending) enqueue(c, render(q));
+        c.pending.clear();
+        // A subscriber still draining its last push skips this tick and gets the next one.
+        if (c.subscribed && snap->sequence - c.pushed_seq >= c.every && c.out.empty()) {
+            enqueue(c, render(c.sub));
+            c.pushed_seq = snap->sequence;
+        }
+        if (!flush(c)) dead.push_back(it.first);
+    }
+    for (int fd : dead) drop(fd);
+}
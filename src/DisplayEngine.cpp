@@ -2,7 +2,9 @@
 #include <cmath>
 #include <algorithm>
 #include <cstring>
+#include <cctype>
 #include <cstdio>
+#include <unistd.h>
 
 namespace DisplayEngine {
 
@@ -16,15 +18,42 @@ static std::string fitstr(const std::string& s, int w) {
     return s + std::string(w - s.size(), ' ');
 }
 
+static int appendCost(int n, const char* name, const PhaseCost& c)
+{
+    if (n < 0 || n >= (int)sizeof(buf) || !c.samples) return n;
+    return n + std::snprintf(buf + n, sizeof(buf) - n, " %s %.2f/%.2f", name, c.p50_ms, c.p99_ms);
+}
+
+// One line of the monitor's own cost: collector phases, then UI phases, then I/O per tick.
+static void formatSelfCosts(const CollectorStats& self, const UiCosts& ui)
+{
+    int n = std::snprintf(buf, sizeof(buf), " Self ms p50/p99:");
+    n = appendCost(n, "scan", self.scan);
+    for (int p = 0; p < SystemUtils::PHASE_COUNT; p++)
+        n = appendCost(n, SystemUtils::ScanTimings::name(p), self.phases[p]);
+    n = appendCost(n, "record", self.record);
+    n = appendCost(n, "history", self.history);
+    if (n > 0 && n < (int)sizeof(buf)) n += std::snprintf(buf + n, sizeof(buf) - n, " |");
+    for (int p = 0; p < UI_PHASE_COUNT; p++)
+        n = appendCost(n, UiCosts::name(p), ui.phases[p]);
+    if (n > 0 && n < (int)sizeof(buf))
+        std::snprintf(buf + n, sizeof(buf) - n, " | %llu syscalls %lluK read/tick",
+                      (unsigned long long)self.syscalls, (unsigned long long)(self.bytes_read / 1024));
+}
+
 void displayHeader(WINDOW* win, uint64_t, uint64_t,
                     double system_cpu_usage, double,
                     double system_uptime, int num_cores,
-                    const std::vector<Filter>& /*filters*/, bool logging_enabled,
+                    bool logging_enabled,
                     const std::string& sort_criterion, const std::string& status_msg,
                     const SystemUtils::CPULoadBreakdown& b,
-                    const SystemUtils::MemBreakdown& m)
+                    const SystemUtils::MemBreakdown& m,
+                    bool events_active, size_t exited_count,
+                    const CollectorStats& self, const UiCosts* ui,
+                    const SystemUtils::Pressure* pressure)
 {
     int width = getmaxx(win);
+    for (int y = 0; y < 4; y++) { wmove(win, y, 0); wclrtoeol(win); }
     double load[3] = {0,0,0};
     getloadavg(load, 3);
 
@@ -48,7 +77,13 @@ void displayHeader(WINDOW* win, uint64_t, uint64_t,
     while(x_fill < bar_w) { waddch(win, ' '); x_fill++; }
     wprintw(win, "%5.1f%%]", system_cpu_usage);
     
-    if (width > 65)
+    // Stall time says more than the load average on a shared or containerised host, so PSI takes
+    // this spot when the kernel has it and the load average moves to the status line.
+    bool psi = pressure && pressure[SystemUtils::PSI_CPU].valid;
+    if (width > 65 && psi)
+        mvwprintw(win, 0, width - 28, "PSI c%.1f m%.1f i%.1f", pressure[SystemUtils::PSI_CPU].some.avg10,
+                  pressure[SystemUtils::PSI_MEMORY].some.avg10, pressure[SystemUtils::PSI_IO].some.avg10);
+    else if (width > 65)
         mvwprintw(win, 0, width - 28, "Load: %.2f %.2f %.2f", load[0], load[1], load[2]);
 
     mvwaddstr(win, 1, 0, "Mem[");
@@ -74,101 +109,332 @@ void displayHeader(WINDOW* win, uint64_t, uint64_t,
     }
 
     wattrset(win, COLOR_PAIR(6));
-    std::snprintf(buf, sizeof(buf), " Sort: %s | Log: %s",
-                  sort_criterion.empty() ? "PID" : sort_criterion.c_str(),
-                  logging_enabled ? "ON" : "OFF");
+    int n = std::snprintf(buf, sizeof(buf), " Sort: %s | Log: %s",
+                          sort_criterion.empty() ? "PID" : sort_criterion.c_str(),
+                          logging_enabled ? "ON" : "OFF");
+    if (events_active && n > 0 && n < (int)sizeof(buf))
+        n += std::snprintf(buf + n, sizeof(buf) - n, " | Events: ON, %zu exited", exited_count);
+    if (psi && n > 0 && n < (int)sizeof(buf))
+        std::snprintf(buf + n, sizeof(buf) - n, " | Load: %.2f %.2f %.2f", load[0], load[1], load[2]);
     mvwaddnstr(win, 2, 0, buf, width);
+    if (width > 65) {
+        std::snprintf(buf, sizeof(buf), "Self: %zup %zuK %dfd", self.prev_samples,
+                      self.prev_bytes / 1024, self.open_fds);
+        mvwaddnstr(win, 2, width - 28, buf, 27);
+    }
     if (!status_msg.empty()) {
         wattrset(win, COLOR_PAIR(3) | A_BOLD);
         mvwaddnstr(win, 3, 0, status_msg.c_str(), width);
+    } else if (ui) {
+        wattrset(win, COLOR_PAIR(4));
+        formatSelfCosts(self, *ui);
+        mvwaddnstr(win, 3, 0, buf, width);
+    }
+    wattrset(win, A_NORMAL);
+}
+
+static const int CORE_BAR_CELL = 16;      // "%3d[" + bar + "%3.0f]" + gap
+static const int CORE_BAR_LINES = 4;      // more bars than this many lines switch to the heatmap
+static const int CORE_MAP_LINES = 8;
+static const int CORE_MAP_LABEL = 9;      // "N0  45% "
+static const int CORE_MAP_GROUP = 8;      // cells between spaces
+
+static int loadAttr(double pct)
+{
+    if (pct >= 80) return COLOR_PAIR(2) | A_BOLD;
+    return pct >= 50 ? COLOR_PAIR(3) : COLOR_PAIR(1);
+}
+
+// Lays out the per-core lines and draws them when win is set; returns the line count.
+static int coreLayout(WINDOW* win, int y, int max_lines, const std::vector<SystemUtils::CPULoadBreakdown>& cores,
+                      int numa_nodes, int width)
+{
+    int n = (int)cores.size();
+    if (!n || width < CORE_BAR_CELL) return 0;
+    int per_line = width / CORE_BAR_CELL;
+    if ((n + per_line - 1) / per_line <= CORE_BAR_LINES) {
+        int lines = std::min(max_lines, (n + per_line - 1) / per_line);
+        if (!win) return lines;
+        const int bar_w = CORE_BAR_CELL - 9;
+        for (int k = 0; k < n && k / per_line < lines; k++) {
+            const SystemUtils::CPULoadBreakdown& c = cores[k];
+            wmove(win, y + k / per_line, (k % per_line) * CORE_BAR_CELL);
+            wattrset(win, COLOR_PAIR(6));
+            wprintw(win, "%3d[", c.cpu);
+            int fill = 0;
+            auto draw = [&](double pct, int pair) {
+                wattrset(win, COLOR_PAIR(pair) | A_BOLD);
+                for (int i = (int)(sane(pct) * bar_w / 100.0); i > 0 && fill < bar_w; i--, fill++) waddch(win, '|');
+            };
+            draw(c.user, 1);
+            draw(c.nice, 7);
+            draw(c.sys, 2);
+            draw(c.irq + c.softirq, 3);
+            wattrset(win, COLOR_PAIR(6));
+            for (; fill < bar_w; fill++) waddch(win, ' ');
+            wprintw(win, "%3.0f]", sane(c.total));
+        }
+        return lines;
     }
+
+    // Heatmap: cores grouped by node, in /proc/stat order within a node.
+    int nodes = std::max(1, numa_nodes);
+    int cells = std::max(1, (width - CORE_MAP_LABEL + 1) * CORE_MAP_GROUP / (CORE_MAP_GROUP + 1));
+    std::vector<std::vector<int>> members(nodes);
+    for (int k = 0; k < n; k++) members[std::min(std::max(cores[k].node, 0), nodes - 1)].push_back(k);
+    int line = 0;
+    for (int node = 0; node < nodes && line < std::min(max_lines, CORE_MAP_LINES); node++) {
+        const std::vector<int>& m = members[node];
+        if (m.empty()) continue;
+        double sum = 0;
+        for (int k : m) sum += sane(cores[k].total);
+        for (size_t first = 0; first < m.size() && line < std::min(max_lines, CORE_MAP_LINES); first += cells, line++) {
+            if (!win) continue;
+            wmove(win, y + line, 0);
+            wattrset(win, COLOR_PAIR(6));
+            if (first == 0) wprintw(win, "N%-2d %3.0f%% ", node, sum / m.size());
+            else wprintw(win, "%*s", CORE_MAP_LABEL, "");
+            for (size_t i = first; i < m.size() && i < first + cells; i++) {
+                double pct = sane(cores[m[i]].total);
+                if (i > first && (i - first) % CORE_MAP_GROUP == 0) waddch(win, ' ');
+                wattrset(win, loadAttr(pct));
+                waddch(win, pct >= 95 ? '@' : pct < 10 ? '.' : (char)('0' + (int)(pct / 10)));
+            }
+        }
+    }
+    return line;
+}
+
+int coreLines(const std::vector<SystemUtils::CPULoadBreakdown>& cores, int numa_nodes, int width)
+{
+    return coreLayout(NULL, 0, CORE_MAP_LINES, cores, numa_nodes, width);
+}
+
+void displayCores(WINDOW* win, int y, int lines, const std::vector<SystemUtils::CPULoadBreakdown>& cores,
+                  int numa_nodes)
+{
+    for (int i = 0; i < lines; i++) { wmove(win, y + i, 0); wclrtoeol(win); }
+    coreLayout(win, y, lines, cores, numa_nodes, getmaxx(win));
     wattrset(win, A_NORMAL);
 }
 
-static void formatProcessLine(const ProcessInfo& p, const std::string& display_cmd, int cmd_w)
+// sum, when given, replaces the process's own rates with its subtree's.
+static void formatProcessLine(const ProcessTable& t, size_t r, const std::string& display_cmd, int cmd_w,
+                              const Rollup* sum = NULL)
 {
     std::string cmd_fixed = fitstr(display_cmd, cmd_w);
+    Rollup own = {t.cpu_usage[r], t.mem_usage[r], t.io_read_rate[r], t.io_write_rate[r], t.net_rx_rate[r], t.net_tx_rate[r]};
+    const Rollup& v = sum ? *sum : own;
+    // Cross-node memory is known only for the processes whose numa_maps were read this tick.
+    char xnode[16] = "    -";
+    if (t.numa_kb[r]) std::snprintf(xnode, sizeof(xnode), "%5.1f", 100.0 * t.numa_remote_kb[r] / t.numa_kb[r]);
+    std::string cpus = fitstr(t.strings.str(t.cpus_allowed_list[r]), 12);
     std::snprintf(buf, sizeof(buf),
-        "%5d %5d %c %5.1f %5.1f %s %6.1f %6.1f %6d %6d %6llu %6llu %5llu %4ld %6llu %5.1f %3ld %3ld %6.1f %6.1f",
-        (int)p.pid, (int)p.ppid, p.state,
-        sane(p.cpu_usage), sane(p.mem_usage),
+        "%5d %5d %c %5.1f %5.1f %s %6.1f %6.1f %6d %6d %6llu %6llu %5llu %4ld %6llu %5.1f %3ld %3ld %6.1f %6.1f %3d %s %s",
+        (int)t.pid[r], (int)t.ppid[r], t.state[r],
+        sane(v.cpu), sane(v.mem),
         cmd_fixed.c_str(),
-        sane(p.io_read_rate), sane(p.io_write_rate),
-        (int)(p.rchar/1024), (int)(p.wchar/1024),
-        (unsigned long long)p.shared_clean, (unsigned long long)p.private_dirty,
-        (unsigned long long)p.fd_count, p.num_threads,
-        (unsigned long long)p.voluntary_ctxt_switches,
-        sane(p.process_age), p.priority, p.nice,
-        sane(p.net_rx_rate), sane(p.net_tx_rate));
-}
-
-static int getAttrForState(const ProcessInfo& p, int selected_row, int line) {
-    if (line == selected_row) return A_REVERSE;
-    char st = p.state;
+        sane(v.io_r), sane(v.io_w),
+        (int)(t.rchar[r]/1024), (int)(t.wchar[r]/1024),
+        (unsigned long long)t.shared_clean[r], (unsigned long long)t.private_dirty[r],
+        (unsigned long long)t.fd_count[r], t.num_threads[r],
+        (unsigned long long)t.voluntary_ctxt_switches[r],
+        sane(t.process_age[r]), t.priority[r], t.nice[r],
+        sane(v.net_rx), sane(v.net_tx), t.processor[r], xnode, cpus.c_str());
+}
+
+static int getAttrForState(const ProcessTable& t, size_t r) {
+    char st = t.state[r];
     if (st == 'R') return COLOR_PAIR(1) | A_BOLD;
     if (st == 'Z') return COLOR_PAIR(2) | A_BOLD;
     if (st == 'D') return COLOR_PAIR(2);
     if (st == 'T') return COLOR_PAIR(5);
     if (st == 'I') return COLOR_PAIR(6) | A_DIM;
-    if (p.cpu_usage > 50.0) return COLOR_PAIR(3);
-    if (p.ppid == 1 && p.pid != 1) return COLOR_PAIR(4);
+    if (t.cpu_usage[r] > 50.0) return COLOR_PAIR(3);
+    if (t.ppid[r] == 1 && t.pid[r] != 1) return COLOR_PAIR(4);
     return COLOR_PAIR(6);
 }
 
-static void renderLine(WINDOW* win, int screen_y, int h_scroll_offset, int width, int attr) {
-    wattrset(win, attr);
-    int len = (int)std::strlen(buf);
-    if (h_scroll_offset < len)
-        mvwaddnstr(win, screen_y, 0, buf + h_scroll_offset, width);
-    else
-        mvwhline(win, screen_y, 0, ' ', width);
-    wattrset(win, A_NORMAL);
+static int commandWidth(int width)
+{
+    return std::min(40, std::max(15, width - 35));
+}
+
+static void pushRow(const ProcessTable& t, int r, const std::string& display_cmd, int cmd_w, std::vector<RowLine>& out,
+                    const Rollup* sum = NULL)
+{
+    formatProcessLine(t, r, display_cmd, cmd_w, sum);
+    RowLine line;
+    line.text = buf;
+    line.attr = getAttrForState(t, r);
+    line.pid = t.pid[r];
+    out.push_back(line);
 }
 
-void displayTree(WINDOW* win, pid_t pid, int depth, int &line, int max_lines,
-                    int scroll_offset, int h_scroll_offset, int selected_row,
-                    const std::map<pid_t, ProcessInfo>& process_map,
-                    const std::map<pid_t, std::vector<pid_t>>& process_tree)
+std::string columnHeader(int width)
 {
-    auto it = process_map.find(pid);
-    if (it == process_map.end()) return;
+    std::string cmd_hdr = fitstr("Command", commandWidth(width));
+    std::snprintf(buf, sizeof(buf), "%5s %5s %1s %5s %5s %s %6s %6s %6s %6s %6s %6s %5s %4s %6s %5s %3s %3s %6s %6s %3s %5s %-12s",
+              "PID", "PPID", "S", "CPU%", "MEM%", cmd_hdr.c_str(),
+              "IO_R", "IO_W", "RChr", "WChr", "ShrCl", "PrvDr", "FD", "Thr", "CtxSw", "Age", "Pri", "Ni", "NetR", "NetW",
+              "CPU", "XNd%", "Affinity");
+    return buf;
+}
 
-    if (line >= scroll_offset && line < max_lines + scroll_offset) {
-        int width = getmaxx(win);
-        int cmd_w = std::min(40, std::max(15, width - 35));
+void treeRows(const ProcessTable& table, const std::vector<uint32_t>& rows, int first, int count, int width,
+              const std::vector<char>& collapsed, std::vector<RowLine>& out)
+{
+    out.clear();
+    int cmd_w = commandWidth(width);
+    const TreeIndex& tree = table.tree;
+    std::string cmd;
+    for (int line = first; line < (int)rows.size() && line < first + count; line++) {
+        uint32_t r = rows[line];
+        bool folded = r < collapsed.size() && collapsed[r] && tree.subtree_size[r] > 1;
+        cmd.assign(tree.glyphs.str(tree.prefix[r]));
+        if (folded) cmd += "[+] ";
+        cmd += table.cmdStr(r);
+        pushRow(table, r, cmd, cmd_w, out, folded ? &tree.rollup[r] : NULL);
+    }
+}
 
-        std::string indent;
-        for (int d = 0; d < depth; d++)
-            indent += (d == depth - 1) ? " |- " : "    ";
-        std::string display_cmd = indent + it->second.cmd;
+void listRows(const ProcessTable& table, const std::vector<uint32_t>& rows, int first, int count, int width,
+              std::vector<RowLine>& out)
+{
+    out.clear();
+    int cmd_w = commandWidth(width);
+    for (int line = first; line < (int)rows.size() && line < first + count; line++)
+        pushRow(table, rows[line], table.cmdStr(rows[line]), cmd_w, out);
+}
+
+std::string threadHeader(int)
+{
+    std::snprintf(buf, sizeof(buf), "%5s %5s %1s %5s %3s %8s %3s %3s %8s %8s %s",
+                  "TID", "PID", "S", "CPU%", "CPU", "CtxSw/s", "Pri", "Ni", "UTime", "STime", "Thread");
+    return buf;
+}
 
-        formatProcessLine(it->second, display_cmd, cmd_w);
-        int attr = getAttrForState(it->second, selected_row, line);
-        renderLine(win, line - scroll_offset + 5, h_scroll_offset, width, attr);
+void threadRows(const ThreadTable& th, const ProcessTable& table, const std::vector<uint32_t>& rows, int first,
+                int count, int, std::vector<RowLine>& out)
+{
+    static const double clk_tck = (double)std::max(1L, sysconf(_SC_CLK_TCK));
+    out.clear();
+    std::string name;
+    for (int line = first; line < (int)rows.size() && line < first + count; line++) {
+        uint32_t r = rows[line];
+        // The process's command, unless the thread carries the same name (usually the main one).
+        name.assign(th.nameStr(r));
+        const char* cmd = table.cmdStr(th.owner[r]);
+        if (name != cmd) { name += " ["; name += cmd; name += ']'; }
+        std::snprintf(buf, sizeof(buf), "%5d %5d %c %5.1f %3d %8.1f %3ld %3ld %8.2f %8.2f %s",
+                      (int)th.tid[r], (int)th.tgid[r], th.state[r], sane(th.cpu_usage[r]), th.processor[r],
+                      sane(th.ctxsw_rate[r]), th.priority[r], th.nice[r],
+                      th.utime[r] / clk_tck, th.stime[r] / clk_tck, name.c_str());
+        RowLine row;
+        row.text = buf;
+        char st = th.state[r];
+        if (st == 'R') row.attr = COLOR_PAIR(1) | A_BOLD;
+        else if (st == 'D') row.attr = COLOR_PAIR(2);
+        else if (st == 'T' || st == 't') row.attr = COLOR_PAIR(5);
+        else if (th.cpu_usage[r] > 50.0) row.attr = COLOR_PAIR(3);
+        else row.attr = COLOR_PAIR(6);
+        row.pid = th.tid[r];
+        out.push_back(row);
     }
-    line++;
-    auto children = process_tree.find(pid);
-    if (children != process_tree.end())
-        for (const auto &child : children->second)
-            displayTree(win, child, depth + 1, line, max_lines, scroll_offset, h_scroll_offset, selected_row, process_map, process_tree);
 }
 
-void displayProcesses(WINDOW* win, int max_lines, int scroll_offset, int h_scroll_offset,
-                        int selected_row, const std::vector<ProcessInfo>& processes)
+std::string groupHeader(int, const char* key)
 {
-    int width = getmaxx(win);
-    int cmd_w = std::min(40, std::max(15, width - 35));
-    int line = 0;
+    std::string label(key);
+    if (!label.empty()) label[0] = (char)toupper((unsigned char)label[0]);
+    std::snprintf(buf, sizeof(buf), "%5s %6s %5s %8s %7s %7s %6s %6s %6s %5s %s",
+                  "Count", "CPU%", "MEM%", "RssMB", "IO_R", "IO_W", "NetR", "NetW", "FD", "Thr", label.c_str());
+    return buf;
+}
+
+void groupRows(const GroupBy::Groups& all, const std::vector<uint32_t>& rows, int first, int count, int,
+               std::vector<RowLine>& out)
+{
+    const ProcessTable& groups = all.table;
+    out.clear();
+    for (int line = first; line < (int)rows.size() && line < first + count; line++) {
+        uint32_t g = rows[line];
+        std::snprintf(buf, sizeof(buf), "%5d %6.1f %5.1f %8.1f %7.1f %7.1f %6.1f %6.1f %6llu %5ld %s",
+                      (int)all.count[g], sane(groups.cpu_usage[g]), sane(groups.mem_usage[g]), groups.rss[g] / 1024.0,
+                      sane(groups.io_read_rate[g]), sane(groups.io_write_rate[g]),
+                      sane(groups.net_rx_rate[g]), sane(groups.net_tx_rate[g]),
+                      (unsigned long long)groups.fd_count[g], groups.num_threads[g], groups.cmdStr(g));
+        RowLine row;
+        row.text = buf;
+        row.attr = groups.cpu_usage[g] > 50.0 ? COLOR_PAIR(3) : groups.state[g] == 'R' ? COLOR_PAIR(1) | A_BOLD : COLOR_PAIR(6);
+        row.pid = groups.pid[g];
+        out.push_back(row);
+    }
+}
 
-    for (const auto &proc : processes) {
-        if (line >= max_lines + scroll_offset) break;
-        if (line < scroll_offset) { line++; continue; }
+std::string cgroupHeader(int)
+{
+    std::snprintf(buf, sizeof(buf), "%5s %5s %6s %6s %8s %8s %7s %7s %6s %6s %5s %s",
+                  "Procs", "Thr", "CPU%", "CgCPU%", "MemMB", "RssMB", "IO_R", "IO_W", "NetR", "NetW", "CPSI", "Cgroup");
+    return buf;
+}
 
-        formatProcessLine(proc, proc.cmd, cmd_w);
-        int attr = getAttrForState(proc, selected_row, line);
-        renderLine(win, line - scroll_offset + 5, h_scroll_offset, width, attr);
-        line++;
+void cgroupRows(const std::vector<SystemUtils::CgroupStats>& groups, const StringPool& strings,
+                const std::vector<uint32_t>& rows, int first, int count, int, std::vector<RowLine>& out)
+{
+    out.clear();
+    for (int line = first; line < (int)rows.size() && line < first + count; line++) {
+        const SystemUtils::CgroupStats& g = groups[rows[line]];
+        char cg_cpu[16] = "     -", mem[16] = "       -", psi[16] = "    -";
+        if (g.have & SystemUtils::CG_CPU) std::snprintf(cg_cpu, sizeof(cg_cpu), "%6.1f", sane(g.cg_cpu));
+        if (g.have & SystemUtils::CG_MEM) std::snprintf(mem, sizeof(mem), "%8.1f", g.mem_current / 1048576.0);
+        if (g.have & SystemUtils::CG_PSI) std::snprintf(psi, sizeof(psi), "%5.1f", sane(g.psi_cpu));
+        bool own_io = g.have & SystemUtils::CG_IO;
+        std::snprintf(buf, sizeof(buf), "%5u %5ld %6.1f %s %s %8.1f %7.1f %7.1f %6.1f %6.1f %s %s",
+                      g.procs, g.threads, sane(g.cpu), cg_cpu, mem, g.rss / 1024.0,
+                      sane(own_io ? g.cg_io_r : g.io_r), sane(own_io ? g.cg_io_w : g.io_w),
+                      sane(g.net_rx), sane(g.net_tx), psi, strings.str(g.path));
+        RowLine row;
+        row.text = buf;
+        row.attr = g.have & SystemUtils::CG_PSI && g.psi_cpu >= 10 ? COLOR_PAIR(2) | A_BOLD
+                 : g.cpu > 50.0 ? COLOR_PAIR(3) : COLOR_PAIR(6);
+        row.pid = -1;
+        out.push_back(row);
     }
 }
 
+void Frame::resize(int rows, int cols)
+{
+    if (rows == (int)shown.size() && cols == width) return;
+    width = cols;
+    shown.assign(rows, Shown());
+}
+
+void Frame::invalidate()
+{
+    shown.assign(shown.size(), Shown());
+}
+
+bool Frame::stale(int y, const std::string& text, int attr)
+{
+    if (y < 0 || y >= (int)shown.size()) return false;
+    Shown& s = shown[y];
+    if (s.valid && s.attr == attr && s.text == text) return false;
+    s.valid = true;
+    s.attr = attr;
+    s.text = text;
+    return true;
+}
+
+void Frame::paint(WINDOW* win, int y, const std::string& text, int attr, int h_scroll)
+{
+    std::string visible = h_scroll < (int)text.size() ? text.substr(h_scroll, width) : std::string();
+    if (!stale(y, visible, attr)) return;
+    painted++;
+    wattrset(win, attr);
+    mvwaddstr(win, y, 0, visible.c_str());
+    wattrset(win, A_NORMAL);
+    if ((int)visible.size() < width) wclrtoeol(win);
+}
+
 }
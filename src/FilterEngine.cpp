@@ -1,118 +1,462 @@
 #include "FilterEngine.h"
-#include <sstream>
-#include <regex>
 #include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <fnmatch.h>
 
 namespace FilterEngine {
 
-std::vector<Filter> parseFilters(const std::string& input, std::string& status_msg)
+enum FieldId {
+    F_CMD, F_STATE, F_PID, F_PPID, F_CPU, F_MEM, F_RSS, F_THREADS, F_PRIO, F_NICE, F_AGE,
+    F_IO_R, F_IO_W, F_NET_RX, F_NET_TX, F_RCHAR, F_WCHAR, F_READ_BYTES, F_WRITE_BYTES,
+    F_CTXSW, F_SHARED, F_PRIVATE, F_FD, F_UTIME, F_STIME, F_LASTCPU, F_CGROUP, F_UID,
+    F_COUNT
+};
+
+// How a value written in an expression maps onto the column: size suffixes (K/M/G/T) are
+// accepted for byte, KB and KB/s columns, time suffixes (s/m/h/d) for the age in hours.
+enum Unit { U_NONE, U_PERCENT, U_BYTES, U_KB, U_HOURS };
+
+enum Op { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_MATCH, OP_REGEX, OP_NREGEX };
+
+struct FieldDef {
+    const char* name;
+    FieldId id;
+    Unit unit;
+};
+
+static const FieldDef FIELDS[] = {
+    {"cmd", F_CMD, U_NONE},          {"state", F_STATE, U_NONE},      {"pid", F_PID, U_NONE},
+    {"ppid", F_PPID, U_NONE},        {"cpu", F_CPU, U_PERCENT},       {"mem", F_MEM, U_PERCENT},
+    {"rss", F_RSS, U_KB},            {"threads", F_THREADS, U_NONE},  {"thr", F_THREADS, U_NONE},
+    {"prio", F_PRIO, U_NONE},        {"priority", F_PRIO, U_NONE},    {"nice", F_NICE, U_NONE},
+    {"ni", F_NICE, U_NONE},          {"age", F_AGE, U_HOURS},         {"io_r", F_IO_R, U_KB},
+    {"io_w", F_IO_W, U_KB},          {"net_rx", F_NET_RX, U_KB},      {"net_tx", F_NET_TX, U_KB},
+    {"rchar", F_RCHAR, U_BYTES},     {"wchar", F_WCHAR, U_BYTES},     {"read_bytes", F_READ_BYTES, U_BYTES},
+    {"write_bytes", F_WRITE_BYTES, U_BYTES}, {"ctxsw", F_CTXSW, U_NONE}, {"shared", F_SHARED, U_KB},
+    {"private", F_PRIVATE, U_KB},    {"fd", F_FD, U_NONE},            {"utime", F_UTIME, U_NONE},
+    {"stime", F_STIME, U_NONE},      {"lastcpu", F_LASTCPU, U_NONE},  {"cgroup", F_CGROUP, U_NONE},
+    {"uid", F_UID, U_NONE},          {"count", F_COUNT, U_NONE},
+};
+
+const char* fieldList()
 {
-    std::vector<Filter> filters_list;
-    if (input.empty())
-    {
-        return filters_list;
+    return "cmd state pid ppid cpu mem rss threads prio nice age io_r io_w net_rx net_tx "
+           "rchar wchar read_bytes write_bytes ctxsw shared private fd utime stime lastcpu cgroup uid";
+}
+
+static const FieldDef* findField(const std::string& name)
+{
+    for (const FieldDef& f : FIELDS)
+        if (name == f.name) return &f;
+    return NULL;
+}
+
+static std::string lower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+// Parses "2G", "512k", "1.5h", "90%" into column units.
+static bool parseNumber(const std::string& text, Unit unit, double& out)
+{
+    const char* s = text.c_str();
+    char* end;
+    double v = strtod(s, &end);
+    if (end == s) return false;
+    std::string suffix = lower(end);
+    if (suffix.size() > 2 && suffix.compare(suffix.size() - 2, 2, "/s") == 0) suffix.resize(suffix.size() - 2);
+    if (suffix.empty()) { out = v; return true; }
+
+    if (unit == U_PERCENT && suffix == "%") { out = v; return true; }
+    if (unit == U_BYTES || unit == U_KB) {
+        if (suffix == "ib" || suffix == "b") suffix.clear();
+        else if (suffix.size() > 1 && (suffix.substr(1) == "b" || suffix.substr(1) == "ib")) suffix.resize(1);
+        double scale = suffix.empty() ? 1 : suffix == "k" ? 1024.0 : suffix == "m" ? 1048576.0
+                     : suffix == "g" ? 1073741824.0 : suffix == "t" ? 1099511627776.0 : -1;
+        if (scale < 0) return false;
+        if (suffix.empty()) { out = v; return true; }
+        out = v * scale / (unit == U_KB ? 1024.0 : 1.0);
+        return true;
     }
-    
-    std::regex regex("\\s*(\\w+)\\s*([:<>])\\s*(\\S+)\\s*");
-    
-    auto words_begin = std::sregex_iterator(input.begin(), input.end(), regex);
-    auto words_end = std::sregex_iterator();
-
-    if (words_begin == words_end) {
-        status_msg = "Invalid filter format. Use key:val, key>val, etc.";
-        return {};
+    if (unit == U_HOURS) {
+        double scale = suffix == "s" ? 1.0 / 3600 : suffix == "m" ? 1.0 / 60 : suffix == "h" ? 1.0
+                     : suffix == "d" ? 24.0 : -1;
+        if (scale < 0) return false;
+        out = v * scale;
+        return true;
     }
+    return false;
+}
+
+namespace {
+
+enum TokType { T_END, T_LPAREN, T_RPAREN, T_AND, T_OR, T_NOT, T_PRED };
+
+struct Token {
+    TokType type;
+    std::string text;
+    bool quoted;
+};
+
+class Parser {
+public:
+    Parser(const std::string& s, Program& p, bool g) : src(s), prog(p), groups(g) {}
 
-    for (std::sregex_iterator i = words_begin; i != words_end; ++i)
+    bool run(std::string& error)
     {
-        std::smatch match = *i;
-        std::string key = match[1].str();
-        std::string op = match[2].str();
-        std::string value = match[3].str();
-        
-        if (key == "pid" || key == "ppid" || key == "state" || key == "cmd" || key == "cpu" || key == "mem" || key == "age")
-        {
-            Filter f = {key, op, value, 0.0, 0};
-            try {
-                if (key != "state" && key != "cmd") {
-                    f.numeric_val = std::stod(value);
-                    f.long_val = std::stol(value);
-                }
-            } catch (...) {}
-            filters_list.push_back(f);
+        next();
+        if (tok.type == T_END) return true;
+        if (!parseOr()) { error = err; return false; }
+        if (tok.type != T_END) { error = "Unexpected '" + tok.text + "'"; return false; }
+        return true;
+    }
+
+private:
+    const std::string& src;
+    Program& prog;
+    bool groups;
+    size_t pos = 0;
+    Token tok;
+    std::string err;
+
+    void next()
+    {
+        while (pos < src.size() && isspace((unsigned char)src[pos])) pos++;
+        tok.text.clear();
+        tok.quoted = false;
+        if (pos >= src.size()) { tok.type = T_END; return; }
+        char c = src[pos];
+        if (c == '(') { pos++; tok.type = T_LPAREN; tok.text = "("; return; }
+        if (c == ')') { pos++; tok.type = T_RPAREN; tok.text = ")"; return; }
+        if (c == '&') { pos += (pos + 1 < src.size() && src[pos + 1] == '&') ? 2 : 1; tok.type = T_AND; tok.text = "&"; return; }
+        if (c == '|') { pos += (pos + 1 < src.size() && src[pos + 1] == '|') ? 2 : 1; tok.type = T_OR; tok.text = "|"; return; }
+        if (c == '!' && (pos + 1 >= src.size() || (src[pos + 1] != '=' && src[pos + 1] != '~'))) {
+            pos++; tok.type = T_NOT; tok.text = "!"; return;
         }
-        else
-        {
-            status_msg = "Invalid filter key: " + key;
-            return {};
+        // A word runs to the next blank, parenthesis, & or |; quotes protect them all.
+        while (pos < src.size()) {
+            c = src[pos];
+            if (isspace((unsigned char)c) || c == '(' || c == ')' || c == '&' || c == '|') break;
+            if (c == '"') {
+                size_t close = src.find('"', pos + 1);
+                if (close == std::string::npos) close = src.size();
+                tok.text.append(src, pos + 1, close - pos - 1);
+                tok.quoted = true;
+                pos = close < src.size() ? close + 1 : close;
+                continue;
+            }
+            tok.text += c;
+            pos++;
         }
+        std::string kw = lower(tok.text);
+        tok.type = kw == "and" ? T_AND : kw == "or" ? T_OR : kw == "not" ? T_NOT : T_PRED;
     }
-    return filters_list;
-}
 
-bool matchesFilter(const ProcessInfo& proc, const Filter& filter, std::string&)
-{
-    if (filter.key == "pid")
+    void emit(Insn::Code code, int pred = -1)
     {
-        if (filter.op == ":" && proc.pid == (pid_t)filter.long_val) return true;
+        Insn i = {code, pred};
+        prog.code.push_back(i);
     }
-    else if (filter.key == "ppid")
+
+    bool parseOr()
     {
-        if (filter.op == ":" && proc.ppid == (pid_t)filter.long_val) return true;
+        if (!parseAnd()) return false;
+        while (tok.type == T_OR) {
+            next();
+            if (!parseAnd()) return false;
+            emit(Insn::OR);
+        }
+        return true;
     }
-    else if (filter.key == "state")
+
+    // Adjacent terms are and-ed, so "cpu>1 mem<50" keeps working.
+    bool parseAnd()
     {
-        if (filter.op == ":" && !filter.value.empty() && proc.state == filter.value[0]) return true;
+        if (!parseUnary()) return false;
+        while (tok.type == T_AND || tok.type == T_NOT || tok.type == T_LPAREN || tok.type == T_PRED) {
+            if (tok.type == T_AND) next();
+            if (!parseUnary()) return false;
+            emit(Insn::AND);
+        }
+        return true;
     }
-    else if (filter.key == "cmd")
+
+    bool parseUnary()
     {
-        std::string cmd = proc.cmd;
-        std::string val = filter.value;
-        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-        std::transform(val.begin(), val.end(), val.begin(), ::tolower);
-        if (filter.op == ":" && cmd.find(val) != std::string::npos) return true;
+        if (tok.type == T_NOT) {
+            next();
+            if (!parseUnary()) return false;
+            emit(Insn::NOT);
+            return true;
+        }
+        if (tok.type == T_LPAREN) {
+            next();
+            if (!parseOr()) return false;
+            if (tok.type != T_RPAREN) { err = "Missing ')'"; return false; }
+            next();
+            return true;
+        }
+        if (tok.type == T_PRED) {
+            if (!compilePredicate(tok.text, tok.quoted)) return false;
+            next();
+            return true;
+        }
+        err = tok.type == T_END ? "Incomplete expression" : "Unexpected '" + tok.text + "'";
+        return false;
     }
-    else if (filter.key == "cpu")
+
+    bool compilePredicate(const std::string& word, bool quoted)
     {
-        if (filter.op == ">" && proc.cpu_usage > filter.numeric_val) return true;
-        if (filter.op == "<" && proc.cpu_usage < filter.numeric_val) return true;
-        if (filter.op == ":" && std::abs(proc.cpu_usage - filter.numeric_val) < 0.1) return true;
+        Predicate p;
+        p.value = 0;
+        size_t k = 0;
+        while (k < word.size() && (isalnum((unsigned char)word[k]) || word[k] == '_')) k++;
+        size_t op_len = 0;
+        if (k > 0 && k < word.size()) {
+            std::string two = word.substr(k, 2);
+            if      (two == "<=") { p.op = OP_LE; op_len = 2; }
+            else if (two == ">=") { p.op = OP_GE; op_len = 2; }
+            else if (two == "!=") { p.op = OP_NE; op_len = 2; }
+            else if (two == "==") { p.op = OP_EQ; op_len = 2; }
+            else if (two == "!~") { p.op = OP_NREGEX; op_len = 2; }
+            else if (word[k] == '<') { p.op = OP_LT; op_len = 1; }
+            else if (word[k] == '>') { p.op = OP_GT; op_len = 1; }
+            else if (word[k] == '=') { p.op = OP_EQ; op_len = 1; }
+            else if (word[k] == ':') { p.op = OP_MATCH; op_len = 1; }
+            else if (word[k] == '~') { p.op = OP_REGEX; op_len = 1; }
+        }
+
+        std::string value;
+        const FieldDef* field;
+        if (op_len == 0) {
+            // A bare word is a command-name substring, as in the old F4 filter.
+            field = findField("cmd");
+            p.op = OP_MATCH;
+            value = word;
+        } else {
+            std::string name = lower(word.substr(0, k));
+            field = findField(name);
+            if (!field) { err = "Unknown field: " + name; return false; }
+            if (field->id == F_COUNT && !groups) { err = "count only applies to groups (g)"; return false; }
+            value = word.substr(k + op_len);
+        }
+        if (value.empty()) { err = "Missing value after " + word; return false; }
+        p.field = field->id;
+
+        if (field->id == F_CMD || field->id == F_CGROUP) {
+            if (p.op == OP_LT || p.op == OP_LE || p.op == OP_GT || p.op == OP_GE) {
+                err = std::string(field->name) + " only supports : = != ~ !~"; return false;
+            }
+            if (p.op == OP_REGEX || p.op == OP_NREGEX) {
+                try {
+                    p.regex = std::make_shared<std::regex>(value, std::regex::extended | std::regex::icase | std::regex::nosubs);
+                } catch (const std::regex_error&) {
+                    err = "Bad regex: " + value; return false;
+                }
+            }
+            // A quoted value of = or != is taken literally, so paths need no glob escaping.
+            p.literal = quoted && (p.op == OP_EQ || p.op == OP_NE);
+            p.text = p.literal ? value : lower(value);
+        } else if (field->id == F_STATE) {
+            if (p.op != OP_MATCH && p.op != OP_EQ && p.op != OP_NE) { err = "state only supports : = !="; return false; }
+            p.text = value;
+        } else {
+            if (p.op == OP_REGEX || p.op == OP_NREGEX) { err = "~ needs a text field"; return false; }
+            if (p.op == OP_MATCH) p.op = OP_EQ;
+            if (!parseNumber(value, field->unit, p.value)) { err = "Bad number: " + value; return false; }
+        }
+        prog.preds.push_back(p);
+        emit(Insn::PRED, (int)prog.preds.size() - 1);
+        return true;
     }
-    else if (filter.key == "mem")
+};
+
+// Compares one column against a constant for every candidate row. The op switch sits outside
+// the loop so each case is a plain gather-and-compare.
+struct CompareColumn {
+    const std::vector<uint32_t>& rows;
+    std::vector<uint8_t>& out;
+    int op;
+    double v;
+
+    template <class T> void operator()(const std::vector<T>& col) const
     {
-        if (filter.op == ">" && proc.mem_usage > filter.numeric_val) return true;
-        if (filter.op == "<" && proc.mem_usage < filter.numeric_val) return true;
-        if (filter.op == ":" && std::abs(proc.mem_usage - filter.numeric_val) < 0.1) return true;
+        size_t n = rows.size();
+        const uint32_t* r = rows.data();
+        uint8_t* o = out.data();
+        const T* c = col.data();
+        // Float columns compare for equality within 0.1, like the displayed precision.
+        double tol = std::is_floating_point<T>::value ? 0.1 : 0.5;
+        switch (op) {
+        case OP_LT: for (size_t k = 0; k < n; k++) o[k] = (double)c[r[k]] < v;  break;
+        case OP_LE: for (size_t k = 0; k < n; k++) o[k] = (double)c[r[k]] <= v; break;
+        case OP_GT: for (size_t k = 0; k < n; k++) o[k] = (double)c[r[k]] > v;  break;
+        case OP_GE: for (size_t k = 0; k < n; k++) o[k] = (double)c[r[k]] >= v; break;
+        case OP_EQ: for (size_t k = 0; k < n; k++) o[k] = std::fabs((double)c[r[k]] - v) < tol;  break;
+        case OP_NE: for (size_t k = 0; k < n; k++) o[k] = std::fabs((double)c[r[k]] - v) >= tol; break;
+        }
     }
-    else if (filter.key == "age")
-    {
-        if (filter.op == ">" && proc.process_age > filter.numeric_val) return true;
-        if (filter.op == "<" && proc.process_age < filter.numeric_val) return true;
-        if (filter.op == ":" && std::abs(proc.process_age - filter.numeric_val) < 0.1) return true;
+};
+
+template <class F> void withColumn(const ProcessTable& t, int field, const F& f)
+{
+    switch (field) {
+    case F_PID:         f(t.pid); break;
+    case F_PPID:        f(t.ppid); break;
+    case F_CPU:         f(t.cpu_usage); break;
+    case F_MEM:         f(t.mem_usage); break;
+    case F_RSS:         f(t.rss); break;
+    case F_THREADS:     f(t.num_threads); break;
+    case F_PRIO:        f(t.priority); break;
+    case F_NICE:        f(t.nice); break;
+    case F_AGE:         f(t.process_age); break;
+    case F_IO_R:        f(t.io_read_rate); break;
+    case F_IO_W:        f(t.io_write_rate); break;
+    case F_NET_RX:      f(t.net_rx_rate); break;
+    case F_NET_TX:      f(t.net_tx_rate); break;
+    case F_RCHAR:       f(t.rchar); break;
+    case F_WCHAR:       f(t.wchar); break;
+    case F_READ_BYTES:  f(t.read_bytes); break;
+    case F_WRITE_BYTES: f(t.write_bytes); break;
+    case F_CTXSW:       f(t.voluntary_ctxt_switches); break;
+    case F_SHARED:      f(t.shared_clean); break;
+    case F_PRIVATE:     f(t.private_dirty); break;
+    case F_FD:          f(t.fd_count); break;
+    case F_UTIME:       f(t.utime); break;
+    case F_STIME:       f(t.stime); break;
+    case F_LASTCPU:     f(t.processor); break;
+    case F_UID:         f(t.uid); break;
     }
-    return false;
 }
 
-std::vector<ProcessInfo> filterProcesses(const std::vector<ProcessInfo>& processes, const std::vector<Filter>& filters, std::string& status_msg)
+// Text predicates (cmd, cgroup) run once per distinct interned string, then rows just look up
+// the result. Substring tests scan the pool's lowercase arena in one pass; the others read it
+// per string.
+void evalText(const ProcessTable& t, const std::vector<uint32_t>& col, const std::vector<uint32_t>& rows,
+              const Predicate& p, std::vector<uint8_t>& out)
 {
-    if (filters.empty()) return processes;
-    std::vector<ProcessInfo> filtered;
-    filtered.reserve(processes.size());
-    for (const auto &proc : processes)
-    {
-        bool pass = true;
-        for (const auto &filter : filters)
-        {
-            if (!matchesFilter(proc, filter, status_msg))
-            {
-                pass = false;
-                break;
+    std::vector<uint8_t> hit;
+    if (p.op == OP_MATCH) {
+        t.strings.containing(p.text, hit);
+    } else if (p.literal) {
+        size_t nstr = t.strings.size();
+        hit.resize(nstr);
+        for (uint32_t id = 0; id < nstr; id++) {
+            bool same = p.text.size() == t.strings.length(id) && memcmp(p.text.data(), t.strings.str(id), p.text.size()) == 0;
+            hit[id] = same == (p.op == OP_EQ);
+        }
+    } else {
+        size_t nstr = t.strings.size();
+        hit.resize(nstr);
+        bool glob = p.text.find_first_of("*?[") != std::string::npos;
+        for (uint32_t id = 0; id < nstr; id++) {
+            const char* hay = t.strings.lower(id);
+            bool m;
+            switch (p.op) {
+            case OP_REGEX:  m = std::regex_search(hay, *p.regex); break;
+            case OP_NREGEX: m = !std::regex_search(hay, *p.regex); break;
+            case OP_NE:     m = glob ? fnmatch(p.text.c_str(), hay, 0) != 0 : p.text != hay; break;
+            default:        m = glob ? fnmatch(p.text.c_str(), hay, 0) == 0 : p.text == hay; break;
             }
+            hit[id] = m;
         }
-        if (pass) filtered.push_back(proc);
     }
-    return filtered;
+    for (size_t k = 0; k < rows.size(); k++) out[k] = hit[col[rows[k]]];
+}
+
+void evalState(const ProcessTable& t, const std::vector<uint32_t>& rows, const Predicate& p, std::vector<uint8_t>& out)
+{
+    bool want[256] = {false};
+    for (char ch : p.text) want[(unsigned char)ch] = true;
+    bool negate = p.op == OP_NE;
+    for (size_t k = 0; k < rows.size(); k++) out[k] = want[(unsigned char)t.state[rows[k]]] != negate;
+}
+
+}
+
+bool compile(const std::string& expr, Program& prog, std::string& error, bool groups)
+{
+    Program p;
+    Parser parser(expr, p, groups);
+    if (!parser.run(error)) return false;
+    prog = p;
+    return true;
+}
+
+Program cgroupIs(const std::string& path)
+{
+    Program prog;
+    Predicate p;
+    p.field = F_CGROUP;
+    p.op = OP_EQ;
+    p.value = 0;
+    p.text = path;
+    p.literal = true;
+    prog.preds.push_back(p);
+    Insn insn = {Insn::PRED, 0};
+    prog.code.push_back(insn);
+    return prog;
+}
+
+bool usesCgroups(const Program& prog)
+{
+    for (const Predicate& p : prog.preds)
+        if (p.field == F_CGROUP) return true;
+    return false;
+}
+
+namespace {
+
+// counts is the group table's member count, or NULL for processes, where count never matches.
+void filterRows(const ProcessTable& table, const std::vector<uint32_t>* counts, std::vector<uint32_t>& rows,
+                const Program& prog)
+{
+    if (prog.empty() || rows.empty()) return;
+    size_t n = rows.size();
+    std::vector<std::vector<uint8_t>> stack;
+    for (const Insn& insn : prog.code) {
+        if (insn.code == Insn::PRED) {
+            stack.push_back(std::vector<uint8_t>(n));
+            const Predicate& p = prog.preds[insn.pred];
+            if (p.field == F_CMD) evalText(table, table.cmd, rows, p, stack.back());
+            else if (p.field == F_CGROUP) evalText(table, table.cgroup, rows, p, stack.back());
+            else if (p.field == F_STATE) evalState(table, rows, p, stack.back());
+            else if (p.field == F_COUNT) { if (counts) CompareColumn{rows, stack.back(), p.op, p.value}(*counts); }
+            else withColumn(table, p.field, CompareColumn{rows, stack.back(), p.op, p.value});
+        } else if (insn.code == Insn::NOT) {
+            for (uint8_t& b : stack.back()) b ^= 1;
+        } else {
+            std::vector<uint8_t> rhs;
+            rhs.swap(stack.back());
+            stack.pop_back();
+            uint8_t* a = stack.back().data();
+            if (insn.code == Insn::AND) for (size_t k = 0; k < n; k++) a[k] &= rhs[k];
+            else                        for (size_t k = 0; k < n; k++) a[k] |= rhs[k];
+        }
+    }
+
+    const std::vector<uint8_t>& keep = stack.back();
+    size_t kept = 0;
+    for (size_t k = 0; k < n; k++)
+        if (keep[k]) rows[kept++] = rows[k];
+    rows.resize(kept);
+}
+
+}
+
+void filterProcesses(const ProcessTable& table, std::vector<uint32_t>& rows, const Program& prog)
+{
+    filterRows(table, NULL, rows, prog);
+}
+
+void filterGroups(const GroupBy::Groups& groups, std::vector<uint32_t>& rows, const Program& prog)
+{
+    filterRows(groups.table, &groups.count, rows, prog);
 }
 
 }
@@ -0,0 +1,117 @@
+#include "GroupBy.h"
+#include <pwd.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace GroupBy {
+
+const char* name(Key key)
+{
+    static const char* names[KEY_COUNT] = { "none", "command", "user", "parent", "cgroup" };
+    return key >= 0 && key < KEY_COUNT ? names[key] : "?";
+}
+
+Key next(Key key)
+{
+    return (Key)((key + 1) % KEY_COUNT);
+}
+
+static const std::string& userName(Groups& g, int32_t uid)
+{
+    auto it = g.users.find(uid);
+    if (it != g.users.end()) return it->second;
+    std::string name;
+    if (uid >= 0) {
+        struct passwd pw, *found = NULL;
+        char buf[1024];
+        if (getpwuid_r((uid_t)uid, &pw, buf, sizeof(buf), &found) == 0 && found) name = found->pw_name;
+        else name = std::to_string(uid);
+    } else name = "?";
+    return g.users.insert(std::make_pair(uid, name)).first->second;
+}
+
+static uint32_t label(Groups& g, const ProcessTable& t, uint32_t r, Key key)
+{
+    StringPool& s = g.table.strings;
+    switch (key) {
+    case COMMAND: return s.intern(t.strings.str(t.cmd[r]), t.strings.length(t.cmd[r]));
+    case USER: {
+        const std::string& name = userName(g, t.uid[r]);
+        return s.intern(name.data(), name.size());
+    }
+    case PARENT: {
+        char buf[96];
+        int p = t.parent[r];
+        int n = std::snprintf(buf, sizeof(buf), "%d %s", (int)t.ppid[r], p >= 0 ? t.cmdStr(p) : "");
+        return s.intern(buf, std::min<size_t>(n, sizeof(buf) - 1));
+    }
+    default:
+        if (!t.cgroup[r]) return s.intern("-", 1);
+        return s.intern(t.strings.str(t.cgroup[r]), t.strings.length(t.cgroup[r]));
+    }
+}
+
+void aggregate(const ProcessTable& t, const std::vector<uint32_t>& rows, Key key, Groups& out)
+{
+    ProcessTable& g = out.table;
+    g.clear();
+    out.count.clear();
+    out.group_of.assign(t.size(), UINT32_MAX);
+    out.index.clear();
+    for (uint32_t r : rows) {
+        int64_t k = key == COMMAND ? (int64_t)t.cmd[r] : key == USER ? (int64_t)t.uid[r]
+                  : key == PARENT ? (int64_t)t.ppid[r] : (int64_t)t.cgroup[r];
+        auto ins = out.index.insert(std::make_pair(k, (uint32_t)g.size()));
+        uint32_t id = ins.first->second;
+        if (ins.second) {
+            // Rows come in PID order, so the first member seen is the lowest PID.
+            g.resize(id + 1);
+            out.count.push_back(0);
+            g.pid[id] = t.pid[r];
+            g.ppid[id] = key == PARENT ? t.ppid[r] : 0;
+            g.state[id] = t.state[r];
+            g.priority[id] = t.priority[r];
+            g.nice[id] = t.nice[r];
+            g.uid[id] = t.uid[r];
+            g.processor[id] = -1;
+            g.cmd[id] = label(out, t, r, key);
+            if (key == CGROUP) g.cgroup[id] = g.cmd[id];
+        }
+        out.group_of[r] = id;
+        out.count[id]++;
+        if (t.state[r] == 'R') g.state[id] = 'R';
+        g.process_age[id] = std::max(g.process_age[id], t.process_age[r]);
+        g.cpu_usage[id] += t.cpu_usage[r];
+        g.mem_usage[id] += t.mem_usage[r];
+        g.rss[id] += t.rss[r];
+        g.num_threads[id] += t.num_threads[r];
+        g.fd_count[id] += t.fd_count[r];
+        g.io_read_rate[id] += t.io_read_rate[r];   g.io_write_rate[id] += t.io_write_rate[r];
+        g.net_rx_rate[id] += t.net_rx_rate[r];     g.net_tx_rate[id] += t.net_tx_rate[r];
+        g.rchar[id] += t.rchar[r];                 g.wchar[id] += t.wchar[r];
+        g.read_bytes[id] += t.read_bytes[r];       g.write_bytes[id] += t.write_bytes[r];
+        g.voluntary_ctxt_switches[id] += t.voluntary_ctxt_switches[r];
+        g.shared_clean[id] += t.shared_clean[r];   g.private_dirty[id] += t.private_dirty[r];
+        g.utime[id] += t.utime[r];                 g.stime[id] += t.stime[r];
+        g.sampled_fields[id] |= t.sampled_fields[r];
+    }
+}
+
+void members(const Groups& groups, uint32_t g, std::vector<uint32_t>& out)
+{
+    out.clear();
+    for (uint32_t r = 0; r < groups.group_of.size(); r++)
+        if (groups.group_of[r] == g) out.push_back(r);
+}
+
+int find(const Groups& groups, const std::string& label)
+{
+    const ProcessTable& g = groups.table;
+    for (size_t i = 0; i < g.size(); i++)
+        if (g.strings.length(g.cmd[i]) == label.size() && std::memcmp(g.cmdStr(i), label.data(), label.size()) == 0)
+            return (int)i;
+    return -1;
+}
+
+}
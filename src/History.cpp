@@ -0,0 +1,429 @@
+#include "History.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t SEGMENT_MAGIC = 0x31484150;   // "PAH1"
+
+// Fixed layout at the start of every segment. used and frames are updated after the frame
+// bytes are written, so a crash mid-append loses at most that frame.
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t used;           // bytes, including this header
+    uint64_t sequence;       // order of segments in the ring; 0 = never written
+    uint32_t frames;
+    uint32_t reserved;
+    uint64_t first_ms, last_ms;
+};
+
+SegmentHeader* header(char* base) { return reinterpret_cast<SegmentHeader*>(base); }
+
+void putVarint(std::vector<char>& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+void putSigned(std::vector<char>& out, int64_t v)
+{
+    putVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+// Decoding stops at the end of the record; a truncated record reads as zeros and fails the
+// final bounds check in decodeFrame.
+struct Reader {
+    const char* p;
+    const char* end;
+    bool ok;
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) { ok = false; return 0; }
+            uint8_t b = (uint8_t)*p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return v;
+    }
+
+    int64_t svarint()
+    {
+        uint64_t v = varint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+};
+
+int64_t fixed(double v, double scale)
+{
+    return std::isnan(v) ? 0 : (int64_t)std::llround(v * scale);
+}
+
+// System-wide totals carried by every frame, for the header bars.
+enum SysValue {
+    S_CPU, S_MEM, S_UPTIME, S_CORES, S_MEM_TOTAL, S_MEM_FREE, S_BUFFERS, S_CACHED, S_RECLAIMABLE, S_USED,
+    S_USER, S_NICE, S_SYS, S_IRQ, S_SOFTIRQ, S_COUNT
+};
+
+}
+
+History::History(size_t seg_bytes, size_t count, const std::string& path, std::string& error)
+{
+    segment_bytes = std::max<size_t>(seg_bytes, 4096) & ~(size_t)4095;
+    map_bytes = segment_bytes * count;
+    if (!count) { error = "history disabled"; return; }
+
+    if (!path.empty()) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            error = "cannot open history file " + path + ": " + strerror(errno);
+            if (fd >= 0) close(fd);
+            fd = -1;
+            return;
+        }
+        // A file of another size was written with other settings; start it over.
+        if ((size_t)st.st_size != map_bytes && (ftruncate(fd, 0) < 0 || ftruncate(fd, map_bytes) < 0)) {
+            error = "cannot size history file " + path + ": " + strerror(errno);
+            close(fd);
+            fd = -1;
+            return;
+        }
+        void* m = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        map = m == MAP_FAILED ? NULL : (char*)m;
+    } else {
+        void* m = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        map = m == MAP_FAILED ? NULL : (char*)m;
+    }
+    if (!map) {
+        error = std::string("cannot map history: ") + strerror(errno);
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return;
+    }
+
+    segments.resize(count);
+    for (size_t i = 0; i < count; i++) segments[i].base = map + i * segment_bytes;
+    recover();
+}
+
+History::~History()
+{
+    if (map) munmap(map, map_bytes);
+    if (fd >= 0) close(fd);
+}
+
+// Re-indexes whatever a previous run left in the file. Writing always resumes in a fresh
+// segment, because the encoder state of the old one is gone.
+void History::recover()
+{
+    for (size_t i = 0; i < segments.size(); i++) {
+        Segment& s = segments[i];
+        SegmentHeader* h = header(s.base);
+        bool valid = h->magic == SEGMENT_MAGIC && h->sequence && h->used >= sizeof(SegmentHeader) &&
+                     h->used <= segment_bytes;
+        uint32_t off = sizeof(SegmentHeader);
+        while (valid && s.frames.size() < h->frames && off + 4 <= h->used) {
+            uint32_t len;
+            memcpy(&len, s.base + off, 4);
+            if (len > h->used - off - 4) break;   // off + 4 <= used, so this cannot wrap
+            s.frames.push_back(off);
+            off += 4 + len;
+        }
+        if (!valid || s.frames.empty()) {
+            memset(h, 0, sizeof(SegmentHeader));
+            s.frames.clear();
+            continue;
+        }
+        h->frames = (uint32_t)s.frames.size();
+        h->used = off;
+        appended += s.frames.size();
+        if (h->sequence >= next_sequence) {
+            next_sequence = h->sequence + 1;
+            current = (int)i;
+        }
+    }
+}
+
+// Overwrites the oldest segment (the one after the newest) and resets the encoder.
+void History::startSegment()
+{
+    current = (current + 1) % (int)segments.size();
+    Segment& s = segments[current];
+    s.frames.clear();
+    SegmentHeader* h = header(s.base);
+    memset(h, 0, sizeof(SegmentHeader));
+    h->magic = SEGMENT_MAGIC;
+    h->used = sizeof(SegmentHeader);
+    h->sequence = next_sequence++;
+    enc.dict.clear();
+    enc.prev.clear();
+    writing = true;
+}
+
+// Encodes snap into scratch against the current segment's dictionary and previous frame. rows
+// gets the frame's values and fresh the string ids of its new commands; both join the encoder
+// state only once the caller has stored the frame.
+void History::encode(const Snapshot& snap, uint64_t time_ms, std::vector<Row>& rows, std::vector<uint32_t>& fresh)
+{
+    const ProcessTable& t = snap.table;
+    scratch.assign(4, 0);    // length, patched by the caller
+    for (int i = 0; i < 8; i++) scratch.push_back((char)(time_ms >> (8 * i)));
+    putVarint(scratch, snap.sequence);
+
+    const SystemStats& sys = snap.system;
+    const SystemUtils::MemBreakdown& m = snap.mem_breakdown;
+    const SystemUtils::CPULoadBreakdown& c = snap.cpu_breakdown;
+    int64_t sysv[S_COUNT] = {
+        fixed(sys.cpu_usage, 10), fixed(sys.mem_usage, 10), fixed(sys.uptime, 1), sys.num_cores,
+        (int64_t)m.total, (int64_t)m.free, (int64_t)m.buffers, (int64_t)m.cached, (int64_t)m.s_reclaimable,
+        (int64_t)m.shorthand_used,
+        fixed(c.user, 10), fixed(c.nice, 10), fixed(c.sys, 10), fixed(c.irq, 10), fixed(c.softirq, 10),
+    };
+    for (int i = 0; i < S_COUNT; i++) putSigned(scratch, sysv[i]);
+
+    // Commands first seen in this segment get the next dictionary ids.
+    std::vector<uint32_t> cmd_ids(t.strings.size(), UINT32_MAX);
+    fresh.clear();
+    rows.resize(t.size());
+    for (size_t r = 0; r < t.size(); r++) {
+        uint32_t sid = t.cmd[r];
+        if (cmd_ids[sid] == UINT32_MAX) {
+            std::string s(t.strings.str(sid), t.strings.length(sid));
+            auto it = enc.dict.find(s);
+            if (it != enc.dict.end()) cmd_ids[sid] = it->second;
+            else {
+                cmd_ids[sid] = (uint32_t)(enc.dict.size() + fresh.size());
+                fresh.push_back(sid);
+            }
+        }
+        Row& row = rows[r];
+        row.pid = t.pid[r];
+        row.v[H_CPU] = fixed(t.cpu_usage[r], 10);
+        row.v[H_MEM] = fixed(t.mem_usage[r], 100);
+        row.v[H_RSS] = t.rss[r];
+        row.v[H_IO_R] = fixed(t.io_read_rate[r], 10);
+        row.v[H_IO_W] = fixed(t.io_write_rate[r], 10);
+        row.v[H_NET_RX] = fixed(t.net_rx_rate[r], 10);
+        row.v[H_NET_TX] = fixed(t.net_tx_rate[r], 10);
+        row.v[H_AGE] = fixed(t.process_age[r], 100);
+        row.v[H_PPID] = t.ppid[r];
+        row.v[H_STATE] = t.state[r];
+        row.v[H_CMD] = cmd_ids[sid];
+        row.v[H_THREADS] = t.num_threads[r];
+        row.v[H_FD] = (int64_t)t.fd_count[r];
+        row.v[H_CTXSW] = (int64_t)t.voluntary_ctxt_switches[r];
+    }
+    putVarint(scratch, fresh.size());
+    for (uint32_t sid : fresh) {
+        size_t len = t.strings.length(sid);
+        putVarint(scratch, len);
+        scratch.insert(scratch.end(), t.strings.str(sid), t.strings.str(sid) + len);
+    }
+
+    // Rows and the previous frame are both in PID order, so deltas come from a merge.
+    putVarint(scratch, rows.size());
+    static const int64_t zeros[H_COUNT] = {0};
+    size_t j = 0;
+    pid_t last_pid = 0;
+    for (const Row& row : rows) {
+        while (j < enc.prev.size() && enc.prev[j].pid < row.pid) j++;
+        const int64_t* base = (j < enc.prev.size() && enc.prev[j].pid == row.pid) ? enc.prev[j].v : zeros;
+        uint32_t mask = 0;
+        for (int col = 0; col < H_COUNT; col++)
+            if (row.v[col] != base[col]) mask |= 1u << col;
+        putVarint(scratch, (uint64_t)(row.pid - last_pid));
+        putVarint(scratch, mask);
+        for (int col = 0; col < H_COUNT; col++)
+            if (mask & (1u << col)) putSigned(scratch, row.v[col] - base[col]);
+        last_pid = row.pid;
+    }
+    uint32_t len = (uint32_t)(scratch.size() - 4);
+    memcpy(&scratch[0], &len, 4);
+}
+
+void History::append(const Snapshot& snap, uint64_t time_ms)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!map) return;
+    std::vector<Row> rows;
+    std::vector<uint32_t> fresh;
+    if (!writing) startSegment();
+    encode(snap, time_ms, rows, fresh);
+    SegmentHeader* h = header(segments[current].base);
+    if (h->used + scratch.size() > segment_bytes) {
+        // A frame that does not fit is re-encoded from scratch for the start of the next segment,
+        // and the oldest segment is overwritten only if it fits there. A frame larger than a whole
+        // segment is dropped and the ring left as it is; an empty segment already held a key frame.
+        if (!h->frames) return;
+        Encoder kept;
+        std::swap(kept, enc);
+        encode(snap, time_ms, rows, fresh);
+        if (sizeof(SegmentHeader) + scratch.size() > segment_bytes) {
+            std::swap(kept, enc);
+            return;
+        }
+        startSegment();
+        h = header(segments[current].base);
+    }
+
+    Segment& s = segments[current];
+    memcpy(s.base + h->used, scratch.data(), scratch.size());
+    s.frames.push_back(h->used);
+    if (!h->frames) h->first_ms = time_ms;
+    h->last_ms = time_ms;
+    h->used += (uint32_t)scratch.size();
+    h->frames++;
+    appended++;
+    for (uint32_t sid : fresh)
+        enc.dict.emplace(std::string(snap.table.strings.str(sid), snap.table.strings.length(sid)), (uint32_t)enc.dict.size());
+    enc.prev.swap(rows);
+}
+
+std::vector<int> History::newestFirst() const
+{
+    std::vector<int> order;
+    for (size_t i = 0; i < segments.size(); i++)
+        if (!segments[i].frames.empty()) order.push_back((int)i);
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return header(segments[a].base)->sequence > header(segments[b].base)->sequence;
+    });
+    return order;
+}
+
+bool History::read(uint64_t frame, Snapshot& out, uint64_t& time_ms) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (frame >= appended) return false;
+    uint64_t back = appended - 1 - frame;
+    const Segment* seg = NULL;
+    size_t local = 0;
+    for (int i : newestFirst()) {
+        size_t n = segments[i].frames.size();
+        if (back < n) { seg = &segments[i]; local = n - 1 - back; break; }
+        back -= n;
+    }
+    if (!seg) return false;
+
+    // Frames are deltas within their segment, so decode from its first frame.
+    std::vector<std::string> dict;
+    std::vector<Row> prev, rows;
+    int64_t sysv[S_COUNT] = {0};
+    uint64_t sequence = 0;
+    for (size_t f = 0; f <= local; f++) {
+        uint32_t off = seg->frames[f], len;
+        memcpy(&len, seg->base + off, 4);
+        if (len < 8 || len > segment_bytes - off - 4) return false;
+        Reader in = {seg->base + off + 4, seg->base + off + 4 + len, true};
+        time_ms = 0;
+        for (int i = 0; i < 8; i++) time_ms |= (uint64_t)(uint8_t)in.p[i] << (8 * i);
+        in.p += 8;
+        sequence = in.varint();
+        for (int i = 0; i < S_COUNT; i++) sysv[i] = in.svarint();
+        uint64_t fresh = in.varint();
+        for (uint64_t k = 0; k < fresh && in.ok; k++) {
+            uint64_t slen = in.varint();
+            if (slen > (uint64_t)(in.end - in.p)) return false;
+            dict.push_back(std::string(in.p, slen));
+            in.p += slen;
+        }
+
+        uint64_t n = in.varint();
+        // Each row takes at least a pid-delta byte and a mask byte.
+        if (!in.ok || n > (uint64_t)(in.end - in.p) / 2) return false;
+        rows.resize(n);
+        static const int64_t zeros[H_COUNT] = {0};
+        size_t j = 0;
+        pid_t pid = 0;
+        for (Row& row : rows) {
+            pid += (pid_t)in.varint();
+            row.pid = pid;
+            while (j < prev.size() && prev[j].pid < pid) j++;
+            const int64_t* base = (j < prev.size() && prev[j].pid == pid) ? prev[j].v : zeros;
+            uint64_t mask = in.varint();
+            for (int col = 0; col < H_COUNT; col++)
+                row.v[col] = base[col] + ((mask & (1u << col)) ? in.svarint() : 0);
+        }
+        if (!in.ok) return false;
+        prev.swap(rows);
+    }
+
+    ProcessTable& t = out.table;
+    t.clear();
+    t.resize(prev.size());
+    for (size_t r = 0; r < prev.size(); r++) {
+        const Row& row = prev[r];
+        t.pid[r] = row.pid;
+        t.ppid[r] = (pid_t)row.v[H_PPID];
+        t.state[r] = (char)row.v[H_STATE];
+        const std::string& cmd = (uint64_t)row.v[H_CMD] < dict.size() ? dict[row.v[H_CMD]] : std::string();
+        t.cmd[r] = t.strings.intern(cmd.data(), cmd.size());
+        t.cpu_usage[r] = row.v[H_CPU] / 10.0;
+        t.mem_usage[r] = row.v[H_MEM] / 100.0;
+        t.rss[r] = (long)row.v[H_RSS];
+        t.io_read_rate[r] = row.v[H_IO_R] / 10.0;
+        t.io_write_rate[r] = row.v[H_IO_W] / 10.0;
+        t.net_rx_rate[r] = row.v[H_NET_RX] / 10.0;
+        t.net_tx_rate[r] = row.v[H_NET_TX] / 10.0;
+        t.process_age[r] = row.v[H_AGE] / 100.0;
+        t.num_threads[r] = (long)row.v[H_THREADS];
+        t.fd_count[r] = (uint64_t)row.v[H_FD];
+        t.voluntary_ctxt_switches[r] = (uint64_t)row.v[H_CTXSW];
+        t.uid[r] = -1;
+    }
+    t.linkTree();
+    t.indexTree();
+
+    SystemStats& sys = out.system;
+    sys.cpu_usage = sysv[S_CPU] / 10.0;
+    sys.mem_usage = sysv[S_MEM] / 10.0;
+    sys.uptime = (double)sysv[S_UPTIME];
+    sys.num_cores = (int)sysv[S_CORES];
+    sys.mem_total = (uint64_t)sysv[S_MEM_TOTAL];
+    sys.mem_free = (uint64_t)sysv[S_MEM_FREE];
+    SystemUtils::MemBreakdown& m = out.mem_breakdown;
+    m.total = sys.mem_total;
+    m.free = sys.mem_free;
+    m.buffers = (uint64_t)sysv[S_BUFFERS];
+    m.cached = (uint64_t)sysv[S_CACHED];
+    m.s_reclaimable = (uint64_t)sysv[S_RECLAIMABLE];
+    m.shorthand_used = (uint64_t)sysv[S_USED];
+    SystemUtils::CPULoadBreakdown& c = out.cpu_breakdown;
+    c = SystemUtils::CPULoadBreakdown();
+    c.user = sysv[S_USER] / 10.0;
+    c.nice = sysv[S_NICE] / 10.0;
+    c.sys = sysv[S_SYS] / 10.0;
+    c.irq = sysv[S_IRQ] / 10.0;
+    c.softirq = sysv[S_SOFTIRQ] / 10.0;
+    out.exited.clear();
+    out.sequence = sequence;
+    out.event_driven = false;
+    return true;
+}
+
+History::Stats History::stats() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Stats st = {0, 0, 0, map_bytes, appended, 0, 0};
+    for (int i : newestFirst()) {
+        const SegmentHeader* h = header(segments[i].base);
+        st.frames += segments[i].frames.size();
+        st.segments++;
+        st.bytes_used += h->used;
+        if (!st.newest_ms) st.newest_ms = h->last_ms;
+        st.oldest_ms = h->first_ms;
+    }
+    return st;
+}
@@ -0,0 +1,191 @@
+#include "JsonOutput.h"
+#include "TextFormat.h"
+#include <cstring>
+#include <unistd.h>
+
+namespace JsonOutput {
+
+using namespace TextFormat;
+
+namespace {
+
+struct FieldInfo {
+    const char* name;
+    const char* key;      // with quotes and colon, as written
+    unsigned scan;        // FIELD_* bit it depends on, 0 = always read
+};
+
+const FieldInfo FIELDS[J_FIELD_COUNT] = {
+    {"pid",           "\"pid\":",           0},
+    {"ppid",          "\"ppid\":",          0},
+    {"state",         "\"state\":",         0},
+    {"cmd",           "\"cmd\":",           0},
+    {"cpu",           "\"cpu\":",           0},
+    {"mem",           "\"mem\":",           0},
+    {"rss",           "\"rss\":",           0},
+    {"threads",       "\"threads\":",       0},
+    {"io_r",          "\"io_r\":",          FIELD_IO},
+    {"io_w",          "\"io_w\":",          FIELD_IO},
+    {"net_rx",        "\"net_rx\":",        FIELD_NET},
+    {"net_tx",        "\"net_tx\":",        FIELD_NET},
+    {"ctxsw",         "\"ctxsw\":",         FIELD_STATUS},
+    {"shared_clean",  "\"shared_clean\":",  FIELD_SMAPS},
+    {"private_dirty", "\"private_dirty\":", FIELD_SMAPS},
+    {"fd",            "\"fd\":",            FIELD_FD},
+    {"age",           "\"age\":",           0},
+    {"prio",          "\"prio\":",          0},
+    {"nice",          "\"nice\":",          0},
+    {"utime",         "\"utime\":",         0},
+    {"stime",         "\"stime\":",         0},
+    {"last_cpu",      "\"last_cpu\":",      0},
+    {"cpus_allowed",  "\"cpus_allowed\":",  FIELD_STATUS},
+};
+
+// FNV-1a, enough to notice that a process's values changed between ticks.
+uint64_t hashBytes(uint64_t h, const char* p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+double ticksToSeconds(unsigned long ticks)
+{
+    static const long clk_tck = sysconf(_SC_CLK_TCK);
+    return clk_tck > 0 ? (double)ticks / clk_tck : 0;
+}
+
+}
+
+bool parseFields(const std::string& list, std::vector<int>& fields)
+{
+    fields.clear();
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (name.empty()) continue;
+        if (name == "all") {
+            for (int f = 0; f < J_FIELD_COUNT; f++) fields.push_back(f);
+            continue;
+        }
+        int f = 0;
+        while (f < J_FIELD_COUNT && name != FIELDS[f].name) f++;
+        if (f == J_FIELD_COUNT) return false;
+        fields.push_back(f);
+    }
+    return !fields.empty();
+}
+
+const std::vector<int>& defaultFields()
+{
+    static const std::vector<int> fields = {
+        J_PID, J_PPID, J_STATE, J_CMD, J_CPU, J_MEM, J_RSS, J_THREADS, J_IO_R, J_IO_W,
+        J_NET_RX, J_NET_TX, J_CTXSW, J_SHARED, J_PRIVATE, J_FD, J_AGE
+    };
+    return fields;
+}
+
+const char* fieldList()
+{
+    return "pid ppid state cmd cpu mem rss threads io_r io_w net_rx net_tx ctxsw shared_clean private_dirty fd age prio nice utime stime last_cpu cpus_allowed";
+}
+
+unsigned scanFieldsFor(const std::vector<int>& fields)
+{
+    unsigned scan = 0;
+    for (int f : fields) scan |= FIELDS[f].scan;
+    return scan;
+}
+
+void appendSystem(std::string& out, const SystemStats& sys)
+{
+    out += "{\"cpu_usage\":";
+    appendFixed(out, sys.cpu_usage);
+    out += ",\"mem_usage\":";
+    appendFixed(out, sys.mem_usage);
+    out += ",\"mem_total\":";
+    appendUint(out, sys.mem_total);
+    out += ",\"mem_free\":";
+    appendUint(out, sys.mem_free);
+    out += ",\"uptime\":";
+    appendFixed(out, sys.uptime);
+    out += ",\"num_cores\":";
+    appendInt(out, sys.num_cores);
+    out += '}';
+}
+
+uint64_t appendProcess(std::string& out, const ProcessTable& t, size_t r, const std::vector<int>& fields, unsigned scanned)
+{
+    uint64_t h = 14695981039346656037ull;
+    out += '{';
+    bool first = true;
+    for (int f : fields) {
+        if (FIELDS[f].scan && !(scanned & FIELDS[f].scan)) continue;
+        if (!first) out += ',';
+        first = false;
+        size_t start = out.size();
+        out += FIELDS[f].key;
+        switch (f) {
+        case J_PID:     appendInt(out, t.pid[r]); break;
+        case J_PPID:    appendInt(out, t.ppid[r]); break;
+        case J_STATE:   appendJson(out, &t.state[r], 1); break;
+        case J_CMD:     appendJson(out, t.strings.str(t.cmd[r]), t.strings.length(t.cmd[r])); break;
+        case J_CPU:     appendFixed(out, t.cpu_usage[r]); break;
+        case J_MEM:     appendFixed(out, t.mem_usage[r]); break;
+        case J_RSS:     appendInt(out, t.rss[r]); break;
+        case J_THREADS: appendInt(out, t.num_threads[r]); break;
+        case J_IO_R:    appendFixed(out, t.io_read_rate[r]); break;
+        case J_IO_W:    appendFixed(out, t.io_write_rate[r]); break;
+        case J_NET_RX:  appendFixed(out, t.net_rx_rate[r]); break;
+        case J_NET_TX:  appendFixed(out, t.net_tx_rate[r]); break;
+        case J_CTXSW:   appendUint(out, t.voluntary_ctxt_switches[r]); break;
+        case J_SHARED:  appendUint(out, t.shared_clean[r]); break;
+        case J_PRIVATE: appendUint(out, t.private_dirty[r]); break;
+        case J_FD:      appendUint(out, t.fd_count[r]); break;
+        case J_AGE:     appendFixed(out, t.process_age[r], 4); break;
+        case J_PRIO:    appendInt(out, t.priority[r]); break;
+        case J_NICE:    appendInt(out, t.nice[r]); break;
+        case J_UTIME:   appendFixed(out, ticksToSeconds(t.utime[r])); break;
+        case J_STIME:   appendFixed(out, ticksToSeconds(t.stime[r])); break;
+        case J_LAST_CPU: appendInt(out, t.processor[r]); break;
+        case J_CPUS_ALLOWED:
+            appendJson(out, t.strings.str(t.cpus_allowed_list[r]), t.strings.length(t.cpus_allowed_list[r]));
+            break;
+        }
+        if (f != J_AGE) h = hashBytes(h, out.data() + start, out.size() - start);
+    }
+    out += '}';
+    return h;
+}
+
+void appendExited(std::string& out, const ExitedProcess& x)
+{
+    out += "{\"pid\":";
+    appendInt(out, x.pid);
+    out += ",\"ppid\":";
+    appendInt(out, x.ppid);
+    out += ",\"cmd\":";
+    appendJson(out, x.cmd.data(), x.cmd.size());
+    out += ",\"exit_code\":";
+    appendInt(out, x.exit_code);
+    if (x.accounted) {
+        out += ",\"cpu_time\":";
+        appendFixed(out, x.cpu_time, 3);
+        out += ",\"lifetime\":";
+        appendFixed(out, x.lifetime, 3);
+        out += ",\"read_bytes\":";
+        appendUint(out, x.read_bytes);
+        out += ",\"write_bytes\":";
+        appendUint(out, x.write_bytes);
+        out += ",\"max_rss\":";
+        appendUint(out, x.hiwater_rss);
+    }
+    out += '}';
+}
+
+}
@@ -0,0 +1,270 @@
+#include "ProcEvents.h"
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+static const int RCVBUF_SIZE = 4 << 20;
+
+ProcEvents::~ProcEvents() { close(); }
+
+void ProcEvents::close()
+{
+    if (cn_fd >= 0) ::close(cn_fd);
+    if (ts_fd >= 0) ::close(ts_fd);
+    cn_fd = ts_fd = -1;
+}
+
+static void growReceiveBuffer(int fd)
+{
+    int size = RCVBUF_SIZE;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+bool ProcEvents::openConnector(std::string& error)
+{
+    cn_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (cn_fd < 0) { error = std::string("proc connector: ") + strerror(errno); return false; }
+
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (bind(cn_fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = std::string("proc connector: ") + strerror(errno);
+        close();
+        return false;
+    }
+    growReceiveBuffer(cn_fd);
+
+    char req[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))];
+    memset(req, 0, sizeof(req));
+    nlmsghdr* hdr = (nlmsghdr*)req;
+    cn_msg* msg = (cn_msg*)NLMSG_DATA(hdr);
+    proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    hdr->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(op));
+    hdr->nlmsg_type = NLMSG_DONE;
+    hdr->nlmsg_pid = getpid();
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(op);
+    memcpy(msg->data, &op, sizeof(op));
+    if (send(cn_fd, req, hdr->nlmsg_len, 0) < 0) {
+        error = std::string("proc connector: ") + strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Sends a generic netlink request with one attribute and waits for the reply or ack.
+static bool genlRequest(int fd, uint16_t family, uint8_t cmd, uint16_t attr_type,
+                        const void* attr, size_t attr_len, char* reply, size_t reply_len, ssize_t& got)
+{
+    char buf[256];
+    memset(buf, 0, sizeof(buf));
+    nlmsghdr* hdr = (nlmsghdr*)buf;
+    genlmsghdr* genl = (genlmsghdr*)NLMSG_DATA(hdr);
+    nlattr* na = (nlattr*)((char*)genl + GENL_HDRLEN);
+    if (NLMSG_LENGTH(GENL_HDRLEN + NLA_HDRLEN + attr_len) > sizeof(buf)) return false;
+
+    genl->cmd = cmd;
+    genl->version = 1;
+    na->nla_type = attr_type;
+    na->nla_len = NLA_HDRLEN + attr_len;
+    memcpy((char*)na + NLA_HDRLEN, attr, attr_len);
+    hdr->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_ALIGN(na->nla_len));
+    hdr->nlmsg_type = family;
+    hdr->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    hdr->nlmsg_pid = 0;
+    if (send(fd, buf, hdr->nlmsg_len, 0) < 0) return false;
+
+    pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) <= 0) return false;
+    got = recv(fd, reply, reply_len, 0);
+    if (got < (ssize_t)sizeof(nlmsghdr)) return false;
+    nlmsghdr* rh = (nlmsghdr*)reply;
+    if (rh->nlmsg_type == NLMSG_ERROR) {
+        nlmsgerr* err = (nlmsgerr*)NLMSG_DATA(rh);
+        return err->error == 0;
+    }
+    return true;
+}
+
+bool ProcEvents::openTaskstats()
+{
+    ts_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (ts_fd < 0) return false;
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    if (bind(ts_fd, (sockaddr*)&addr, sizeof(addr)) != 0) { ::close(ts_fd); ts_fd = -1; return false; }
+    growReceiveBuffer(ts_fd);
+
+    char reply[4096];
+    ssize_t got = 0;
+    const char name[] = TASKSTATS_GENL_NAME;
+    if (!genlRequest(ts_fd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                     name, sizeof(name), reply, sizeof(reply), got)) {
+        ::close(ts_fd); ts_fd = -1;
+        return false;
+    }
+
+    nlmsghdr* rh = (nlmsghdr*)reply;
+    if (rh->nlmsg_type != NLMSG_ERROR) {
+        int len = (int)rh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+        nlattr* na = (nlattr*)((char*)NLMSG_DATA(rh) + GENL_HDRLEN);
+        while (len >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN && (int)na->nla_len <= len) {
+            if (na->nla_type == CTRL_ATTR_FAMILY_ID)
+                ts_family = *(uint16_t*)((char*)na + NLA_HDRLEN);
+            len -= NLA_ALIGN(na->nla_len);
+            na = (nlattr*)((char*)na + NLA_ALIGN(na->nla_len));
+        }
+        // Swallow the trailing ack of the family lookup.
+        pollfd pfd = {ts_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) > 0) recv(ts_fd, reply, sizeof(reply), 0);
+    }
+    if (ts_family == 0) { ::close(ts_fd); ts_fd = -1; return false; }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    char mask[32];
+    snprintf(mask, sizeof(mask), "0-%ld", ncpu > 0 ? ncpu - 1 : 0);
+    if (!genlRequest(ts_fd, ts_family, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+                     mask, strlen(mask) + 1, reply, sizeof(reply), got)) {
+        ::close(ts_fd); ts_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool ProcEvents::open(std::string& error)
+{
+    close();
+    if (!openConnector(error)) return false;
+    openTaskstats();
+    return true;
+}
+
+bool ProcEvents::drainConnector(std::vector<ProcEvent>& out)
+{
+    char buf[65536] __attribute__((aligned(NLMSG_ALIGNTO)));
+    for (;;) {
+        ssize_t n = recv(cn_fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno != ENOBUFS;
+        }
+        if (n == 0) return true;
+
+        for (nlmsghdr* hdr = (nlmsghdr*)buf; NLMSG_OK(hdr, (size_t)n); hdr = NLMSG_NEXT(hdr, n)) {
+            if (hdr->nlmsg_type == NLMSG_ERROR || hdr->nlmsg_type == NLMSG_NOOP) continue;
+            cn_msg* msg = (cn_msg*)NLMSG_DATA(hdr);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC) continue;
+            proc_event* ev = (proc_event*)msg->data;
+
+            ProcEvent e;
+            memset(&e, 0, sizeof(e));
+            switch (ev->what) {
+            case proc_event::PROC_EVENT_FORK:
+                // Thread creation shares the parent's tgid; only new processes are interesting.
+                if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) continue;
+                e.type = ProcEvent::FORK;
+                e.pid  = ev->event_data.fork.child_tgid;
+                e.ppid = ev->event_data.fork.parent_tgid;
+                break;
+            case proc_event::PROC_EVENT_EXEC:
+                e.type = ProcEvent::EXEC;
+                e.pid  = ev->event_data.exec.process_tgid;
+                break;
+            case proc_event::PROC_EVENT_EXIT:
+                if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) continue;
+                e.type = ProcEvent::EXIT;
+                e.pid  = ev->event_data.exit.process_tgid;
+                e.ppid = ev->event_data.exit.parent_tgid;
+                e.exit_code = (int)ev->event_data.exit.exit_code;
+                break;
+            default:
+                continue;
+            }
+            out.push_back(e);
+        }
+    }
+}
+
+static void accountingFromStats(const nlattr* na, ProcEvent& e)
+{
+    taskstats ts;
+    memset(&ts, 0, sizeof(ts));
+    size_t len = na->nla_len - NLA_HDRLEN;
+    memcpy(&ts, (const char*)na + NLA_HDRLEN, len < sizeof(ts) ? len : sizeof(ts));
+
+    e.type = ProcEvent::ACCOUNTING;
+    e.pid  = ts.ac_tgid ? (pid_t)ts.ac_tgid : (pid_t)ts.ac_pid;
+    e.ppid = (pid_t)ts.ac_ppid;
+    e.exit_code   = (int)ts.ac_exitcode;
+    e.cpu_us      = ts.ac_utime + ts.ac_stime;
+    e.lifetime_us = ts.ac_etime;
+    e.read_bytes  = ts.read_bytes;
+    e.write_bytes = ts.write_bytes;
+    e.hiwater_rss = ts.hiwater_rss;
+    memcpy(e.comm, ts.ac_comm, sizeof(e.comm) - 1);
+    e.comm[sizeof(e.comm) - 1] = '\0';
+}
+
+// Exit records come as TASKSTATS_TYPE_AGGR_PID per thread and, for the last thread of a
+// multi-threaded process, an extra TASKSTATS_TYPE_AGGR_TGID. Only process-level records are kept.
+bool ProcEvents::drainTaskstats(std::vector<ProcEvent>& out)
+{
+    char buf[65536] __attribute__((aligned(NLMSG_ALIGNTO)));
+    for (;;) {
+        ssize_t n = recv(ts_fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno != ENOBUFS;
+        }
+        if (n == 0) return true;
+
+        for (nlmsghdr* hdr = (nlmsghdr*)buf; NLMSG_OK(hdr, (size_t)n); hdr = NLMSG_NEXT(hdr, n)) {
+            if (hdr->nlmsg_type != ts_family) continue;
+            int len = (int)hdr->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+            nlattr* na = (nlattr*)((char*)NLMSG_DATA(hdr) + GENL_HDRLEN);
+            while (len >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN && (int)na->nla_len <= len) {
+                if (na->nla_type == TASKSTATS_TYPE_AGGR_PID || na->nla_type == TASKSTATS_TYPE_AGGR_TGID) {
+                    bool tgid_record = na->nla_type == TASKSTATS_TYPE_AGGR_TGID;
+                    int nlen = (int)na->nla_len - NLA_HDRLEN;
+                    nlattr* inner = (nlattr*)((char*)na + NLA_HDRLEN);
+                    uint32_t id = 0;
+                    while (nlen >= NLA_HDRLEN && inner->nla_len >= NLA_HDRLEN && (int)inner->nla_len <= nlen) {
+                        if (inner->nla_type == TASKSTATS_TYPE_PID || inner->nla_type == TASKSTATS_TYPE_TGID)
+                            id = *(uint32_t*)((char*)inner + NLA_HDRLEN);
+                        else if (inner->nla_type == TASKSTATS_TYPE_STATS) {
+                            ProcEvent e;
+                            memset(&e, 0, sizeof(e));
+                            accountingFromStats(inner, e);
+                            if (tgid_record) e.pid = (pid_t)id;
+                            if (tgid_record || e.pid == (pid_t)id) out.push_back(e);
+                        }
+                        nlen -= NLA_ALIGN(inner->nla_len);
+                        inner = (nlattr*)((char*)inner + NLA_ALIGN(inner->nla_len));
+                    }
+                }
+                len -= NLA_ALIGN(na->nla_len);
+                na = (nlattr*)((char*)na + NLA_ALIGN(na->nla_len));
+            }
+        }
+    }
+}
+
+bool ProcEvents::drain(std::vector<ProcEvent>& out)
+{
+    bool ok = true;
+    if (cn_fd >= 0) ok = drainConnector(out) && ok;
+    if (ts_fd >= 0) ok = drainTaskstats(out) && ok;
+    return ok;
+}
@@ -0,0 +1,374 @@
+#include "ProcParse.h"
+#include <cstring>
+
+namespace ProcParse {
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static inline uint64_t parseU64(const char*& p, const char* end)
+{
+    p = skipBlanks(p, end);
+    uint64_t v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) v = v * 10 + (uint64_t)(*p++ - '0');
+    return v;
+}
+
+static inline long parseLong(const char*& p, const char* end)
+{
+    p = skipBlanks(p, end);
+    bool neg = p < end && *p == '-';
+    if (neg) p++;
+    long v = (long)parseU64(p, end);
+    return neg ? -v : v;
+}
+
+static inline const char* lineEnd(const char* p, const char* end)
+{
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+int scanKeyed(const char* buf, size_t len, const KeySpec* keys, int nkeys, uint64_t* out)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    unsigned found_mask = 0;
+    int found = 0;
+    while (p < end && found < nkeys) {
+        const char* eol = lineEnd(p, end);
+        const char* colon = (const char*)memchr(p, ':', eol - p);
+        if (colon) {
+            size_t klen = colon - p;
+            for (int k = 0; k < nkeys; k++) {
+                if (keys[k].len != klen || keys[k].key[0] != *p || (found_mask & (1u << k))) continue;
+                if (memcmp(keys[k].key, p, klen) != 0) continue;
+                const char* v = colon + 1;
+                out[k] = parseU64(v, eol);
+                found_mask |= 1u << k;
+                found++;
+                break;
+            }
+        }
+        p = eol + 1;
+    }
+    return found;
+}
+
+#define KEY(s) { s, sizeof(s) - 1 }
+
+bool parsePidStat(const char* buf, size_t len, PidStat& out, bool with_processor)
+{
+    const char* end = buf + len;
+    const char* fp = (const char*)memchr(buf, '(', len);
+    // comm may itself contain ')', so the name ends at the last one on the line.
+    const char* lp = (const char*)memrchr(buf, ')', len);
+    if (!fp || !lp || lp <= fp) return false;
+
+    out.comm = fp + 1;
+    out.comm_len = lp - fp - 1;
+    const char* p = skipBlanks(lp + 1, end);
+    if (p >= end) return false;
+    out.state = *p++;
+
+    // Field numbers as in proc(5); only the ones we keep are decoded.
+    int last = with_processor ? 39 : 24;
+    for (int field = 4; field <= last && p < end; field++) {
+        switch (field) {
+        case 4:  out.ppid        = parseLong(p, end); break;
+        case 9:  out.flags       = (unsigned long)parseU64(p, end); break;
+        case 14: out.utime       = (unsigned long)parseU64(p, end); break;
+        case 15: out.stime       = (unsigned long)parseU64(p, end); break;
+        case 18: out.priority    = parseLong(p, end); break;
+        case 19: out.nice        = parseLong(p, end); break;
+        case 20: out.num_threads = parseLong(p, end); break;
+        case 22: out.starttime   = (unsigned long)parseU64(p, end); break;
+        case 24: out.rss         = parseLong(p, end); break;
+        case 39: out.processor   = (int)parseLong(p, end); break;
+        default:
+            p = skipBlanks(p, end);
+            while (p < end && *p != ' ') p++;
+        }
+    }
+    return true;
+}
+
+bool parseMeminfo(const char* buf, size_t len, MemInfo& out)
+{
+    static const KeySpec keys[] = { KEY("MemTotal"), KEY("MemFree"), KEY("Buffers"), KEY("Cached"), KEY("SReclaimable") };
+    uint64_t v[5] = {0, 0, 0, 0, 0};
+    int n = scanKeyed(buf, len, keys, 5, v);
+    out.total = v[0]; out.free = v[1]; out.buffers = v[2]; out.cached = v[3]; out.s_reclaimable = v[4];
+    return n > 0;
+}
+
+bool parseStatusCtxt(const char* buf, size_t len, uint64_t& voluntary_ctxt_switches)
+{
+    static const KeySpec keys[] = { KEY("voluntary_ctxt_switches") };
+    return scanKeyed(buf, len, keys, 1, &voluntary_ctxt_switches) == 1;
+}
+
+bool parseStatusAffinity(const char* buf, size_t len, uint64_t& voluntary_ctxt_switches,
+                         const char*& cpus, size_t& cpus_len)
+{
+    static const char key[] = "\nCpus_allowed_list:";
+    const char* end = buf + len;
+    const char* p = (const char*)memmem(buf, len, key, sizeof(key) - 1);
+    cpus = NULL;
+    cpus_len = 0;
+    if (p) {
+        p += sizeof(key) - 1;
+        const char* eol = lineEnd(p, end);
+        cpus = skipBlanks(p, eol);
+        cpus_len = eol - cpus;
+        p = eol;
+    } else p = buf;
+    return parseStatusCtxt(p, end - p, voluntary_ctxt_switches);
+}
+
+bool parseStatusUid(const char* buf, size_t len, uint32_t& euid)
+{
+    static const char key[] = "\nUid:";
+    const char* end = buf + len;
+    const char* p = (const char*)memmem(buf, len, key, sizeof(key) - 1);
+    if (!p) return false;
+    p += sizeof(key) - 1;
+    const char* eol = lineEnd(p, end);
+    // "Uid:\treal\teffective\tsaved\tfs"
+    parseU64(p, eol);
+    p = skipBlanks(p, eol);
+    if (p == eol) return false;
+    euid = (uint32_t)parseU64(p, eol);
+    return true;
+}
+
+bool parseStatusSwitches(const char* buf, size_t len, uint64_t& voluntary, uint64_t& nonvoluntary)
+{
+    static const KeySpec keys[] = { KEY("voluntary_ctxt_switches"), KEY("nonvoluntary_ctxt_switches") };
+    uint64_t v[2] = {0, 0};
+    int n = scanKeyed(buf, len, keys, 2, v);
+    voluntary = v[0];
+    nonvoluntary = v[1];
+    return n > 0;
+}
+
+bool parsePidIo(const char* buf, size_t len, PidIo& out)
+{
+    static const KeySpec keys[] = { KEY("rchar"), KEY("wchar"), KEY("read_bytes"), KEY("write_bytes") };
+    uint64_t v[4] = {0, 0, 0, 0};
+    int n = scanKeyed(buf, len, keys, 4, v);
+    out.rchar = v[0]; out.wchar = v[1]; out.read_bytes = v[2]; out.write_bytes = v[3];
+    return n > 0;
+}
+
+bool parseSmapsRollup(const char* buf, size_t len, SmapsRollup& out)
+{
+    static const KeySpec keys[] = { KEY("Shared_Clean"), KEY("Private_Dirty") };
+    uint64_t v[2] = {0, 0};
+    int n = scanKeyed(buf, len, keys, 2, v);
+    out.shared_clean = v[0]; out.private_dirty = v[1];
+    return n > 0;
+}
+
+#undef KEY
+
+bool parseNetDev(const char* buf, size_t len, uint64_t& rx, uint64_t& tx)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    bool any = false;
+    rx = tx = 0;
+    // Two header lines, then "iface: rx_bytes packets errs drop fifo frame compressed multicast tx_bytes ..."
+    for (int line = 0; p < end; line++) {
+        const char* eol = lineEnd(p, end);
+        const char* colon = line >= 2 ? (const char*)memchr(p, ':', eol - p) : NULL;
+        if (colon) {
+            const char* q = colon + 1;
+            uint64_t r = parseU64(q, eol);
+            for (int k = 0; k < 7; k++) parseU64(q, eol);
+            q = skipBlanks(q, eol);
+            if (q < eol) {
+                rx += r;
+                tx += parseU64(q, eol);
+                any = true;
+            }
+        }
+        p = eol + 1;
+    }
+    return any;
+}
+
+int parseCpuLine(const char* buf, size_t len, uint64_t* out, int max)
+{
+    const char* end = buf + len;
+    if (len < 4 || memcmp(buf, "cpu ", 4) != 0) return 0;
+    const char* p = buf + 4;
+    const char* eol = lineEnd(p, end);
+    int n = 0;
+    for (; n < max; n++) {
+        p = skipBlanks(p, eol);
+        if (p >= eol || (unsigned)(*p - '0') >= 10) break;
+        out[n] = parseU64(p, eol);
+    }
+    return n;
+}
+
+int parseStatCpus(const char* buf, size_t len, uint64_t* all, CpuTimes* cores, int max_cores)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    for (int k = 0; k < 10; k++) all[k] = 0;
+    parseCpuLine(buf, len, all, 10);
+    int n = 0;
+    // The cpuN lines follow the aggregate one; the first line that is not a cpu line ends them.
+    for (p = lineEnd(p, end) + 1; p < end && n < max_cores; p++) {
+        const char* eol = lineEnd(p, end);
+        if (eol == end || eol - p < 4 || memcmp(p, "cpu", 3) != 0 || (unsigned)(p[3] - '0') >= 10) break;
+        const char* q = p + 3;
+        CpuTimes& c = cores[n];
+        c.cpu = (int)parseU64(q, eol);
+        for (int k = 0; k < 10; k++) c.v[k] = parseU64(q, eol);
+        n++;
+        p = eol;
+    }
+    return n;
+}
+
+int parseCpuList(const char* buf, size_t len, uint8_t* mask, int max_cpus)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    int set = 0;
+    while (p < end) {
+        p = skipBlanks(p, end);
+        if (p >= end || (unsigned)(*p - '0') >= 10) break;
+        uint64_t lo = parseU64(p, end), hi = lo;
+        if (p < end && *p == '-') { p++; hi = parseU64(p, end); }
+        for (uint64_t c = lo; c <= hi && c < (uint64_t)max_cpus; c++)
+            if (!mask[c]) { mask[c] = 1; set++; }
+        if (p < end && *p == ',') p++;
+        else break;
+    }
+    return set;
+}
+
+int parseNumaMaps(const char* buf, size_t len, uint64_t* node_kb, int max_nodes)
+{
+    static const char page_key[] = "kernelpagesize_kB=";
+    const char* p = buf;
+    const char* end = buf + len;
+    int seen = 0;
+    while (p < end) {
+        const char* eol = lineEnd(p, end);
+        // kernelpagesize_kB is the last word of a line with any pages mapped.
+        const char* last = eol;
+        while (last > p && last[-1] != ' ') last--;
+        uint64_t page_kb = 4;
+        if ((size_t)(eol - last) > sizeof(page_key) - 1 && memcmp(last, page_key, sizeof(page_key) - 1) == 0) {
+            const char* q = last + sizeof(page_key) - 1;
+            page_kb = parseU64(q, eol);
+        }
+        for (const char* w = (const char*)memchr(p, ' ', eol - p); w; w = (const char*)memchr(w + 1, ' ', eol - w - 1)) {
+            if (eol - w < 4 || w[1] != 'N' || (unsigned)(w[2] - '0') >= 10) continue;
+            const char* q = w + 2;
+            uint64_t node = parseU64(q, eol);
+            if (q >= eol || *q != '=') continue;
+            q++;
+            uint64_t pages = parseU64(q, eol);
+            if (node < (uint64_t)max_nodes) node_kb[node] += pages * page_kb;
+            if ((int)node >= seen) seen = (int)node + 1;
+        }
+        p = eol + 1;
+    }
+    return seen;
+}
+
+// "12.34" without strtod; pressure averages always have two decimals.
+static double parseFixed(const char*& p, const char* end)
+{
+    double v = (double)parseU64(p, end);
+    if (p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        for (; p < end && (unsigned)(*p - '0') < 10; p++, scale *= 0.1) v += (*p - '0') * scale;
+    }
+    return v;
+}
+
+bool parsePressure(const char* buf, size_t len, PsiLine& some, PsiLine& full)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    some = PsiLine();
+    full = PsiLine();
+    bool found = false;
+    while (p < end) {
+        const char* eol = lineEnd(p, end);
+        PsiLine* out = NULL;
+        if (eol - p > 5 && memcmp(p, "some ", 5) == 0) { out = &some; found = true; }
+        else if (eol - p > 5 && memcmp(p, "full ", 5) == 0) out = &full;
+        // "avg10=0.00 avg60=0.00 avg300=0.00 total=0", always in that order.
+        for (const char* q = p; out && q < eol; ) {
+            const char* eq = (const char*)memchr(q, '=', eol - q);
+            if (!eq) break;
+            const char* v = eq + 1;
+            if      (eq - q >= 6 && memcmp(eq - 6, "avg300", 6) == 0) out->avg300 = parseFixed(v, eol);
+            else if (eq - q >= 5 && memcmp(eq - 5, "avg10", 5) == 0)  out->avg10 = parseFixed(v, eol);
+            else if (eq - q >= 5 && memcmp(eq - 5, "avg60", 5) == 0)  out->avg60 = parseFixed(v, eol);
+            else if (eq - q >= 5 && memcmp(eq - 5, "total", 5) == 0)  out->total = parseU64(v, eol);
+            q = v;
+        }
+        p = eol + 1;
+    }
+    return found;
+}
+
+bool parseCgroupV2(const char* buf, size_t len, const char*& path, size_t& path_len)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    while (p < end) {
+        const char* eol = lineEnd(p, end);
+        if (eol - p >= 3 && memcmp(p, "0::", 3) == 0) {
+            path = p + 3;
+            path_len = eol - path;
+            return true;
+        }
+        p = eol + 1;
+    }
+    return false;
+}
+
+bool parseCpuStatUsage(const char* buf, size_t len, uint64_t& usage_usec)
+{
+    static const char key[] = "usage_usec ";
+    if (len < sizeof(key) - 1 || memcmp(buf, key, sizeof(key) - 1) != 0) return false;
+    const char* p = buf + sizeof(key) - 1;
+    usage_usec = parseU64(p, buf + len);
+    return true;
+}
+
+void parseIoStat(const char* buf, size_t len, uint64_t& rbytes, uint64_t& wbytes)
+{
+    const char* p = buf;
+    const char* end = buf + len;
+    rbytes = wbytes = 0;
+    // "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0"
+    while (p < end) {
+        const char* eol = lineEnd(p, end);
+        for (const char* q = p; q < eol; ) {
+            const char* eq = (const char*)memchr(q, '=', eol - q);
+            if (!eq) break;
+            const char* v = eq + 1;
+            if (eq - q >= 6 && memcmp(eq - 6, "rbytes", 6) == 0) rbytes += parseU64(v, eol);
+            else if (eq - q >= 6 && memcmp(eq - 6, "wbytes", 6) == 0) wbytes += parseU64(v, eol);
+            q = v;
+        }
+        p = eol + 1;
+    }
+}
+
+}
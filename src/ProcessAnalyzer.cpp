@@ -4,6 +4,10 @@
 #include "DisplayEngine.h"
 #include "ProcessSorter.h"
 #include "ProcessLogger.h"
+#include "JsonOutput.h"
+#include "TextFormat.h"
+#include "SnapshotFormat.h"
+#include "Daemon.h"
 
 #include <iostream>
 #include <chrono>
@@ -12,6 +16,17 @@
 #include <algorithm>
 #include <cstring>
 #include <cctype>
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+#include <unordered_map>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
 
 static void drawFunctionBar(WINDOW* win, bool filter_mode, const std::string& filter_input)
 {
@@ -22,7 +37,7 @@ static void drawFunctionBar(WINDOW* win, bool filter_mode, const std::string& fi
     mvwhline(win, y, 0, ' ', width);
 
     if (filter_mode) {
-        mvwprintw(win, y, 0, " Filter: %s", filter_input.c_str());
+        mvwprintw(win, y, 0, " %s", filter_input.c_str());
         wattroff(win, A_REVERSE);
         return;
     }
@@ -60,9 +75,17 @@ static void showHelp(WINDOW* win)
     line++;
     mvwprintw(win, line++, 0, " F1 h ?      : show this help screen");
     mvwprintw(win, line++, 0, " F3 /        : incremental search by name");
-    mvwprintw(win, line++, 0, " F4 \\        : incremental filter by name");
+    mvwprintw(win, line++, 0, " F4 \\        : filter expression, e.g. cpu>5 and (cmd~^py or cmd:java) and not state:Z");
+    mvwprintw(win, line++, 0, "               fields: %s", FilterEngine::fieldList());
+    mvwprintw(win, line++, 0, "               ops: : = != < <= > >= ~ !~, units: rss>2G age>1d, cmd=py* globs");
     mvwprintw(win, line++, 0, " F5 t        : toggle tree/list view");
-    mvwprintw(win, line++, 0, " F6 > .      : cycle sort (CPU/Mem/IO/Net)");
+    mvwprintw(win, line++, 0, " - + *       : tree view: collapse/expand the selected subtree, expand all");
+    mvwprintw(win, line++, 0, " c           : show or hide per-core load (bars, or a heatmap per NUMA node)");
+    mvwprintw(win, line++, 0, " H           : threads of the selected and tagged processes, or of all filtered ones");
+    mvwprintw(win, line++, 0, " g           : group by command, user, parent or cgroup; Enter lists a group, Backspace returns");
+    mvwprintw(win, line++, 0, "               groups add the filter field and sort key count, e.g. count>10");
+    mvwprintw(win, line++, 0, " C           : cgroup panel: totals and controller stats per cgroup, Enter filters to one");
+    mvwprintw(win, line++, 0, " F6 > .      : cycle sort column: %s", ProcessSorter::keyList());
     mvwprintw(win, line++, 0, " F9 k        : kill selected process");
     mvwprintw(win, line++, 0, " F10 q       : quit");
     line++;
@@ -75,6 +98,8 @@ static void showHelp(WINDOW* win)
     mvwprintw(win, line++, 0, " N           : sort by PID");
     mvwprintw(win, line++, 0, " Space       : tag/untag process");
     mvwprintw(win, line++, 0, " U           : untag all");
+    mvwprintw(win, line++, 0, " S           : show the monitor's own cost (p50/p99 per phase)");
+    mvwprintw(win, line++, 0, " [ ] { }     : step back/forward through history by 1 or 60 ticks (read-only)");
     line++;
     wattron(win, A_BOLD);
     mvwprintw(win, line++, 0, " Process state: R=running S=sleeping Z=zombie D=disk T=stopped");
@@ -88,45 +113,238 @@ static void showHelp(WINDOW* win)
     timeout(0);
 }
 
+// Rebuilds the filtered/sorted view from the current snapshot. Runs on the UI thread only.
 void ProcessAnalyzer::updateProcessList()
 {
-    SystemUtils::scanProcesses(processes, process_tree, process_map, mem_total, mem_free,
-                               system_mem_usage, system_cpu_usage, prev_total_jiffies,
-                               prev_work_jiffies, prev_processes, num_cores, clk_tck,
-                               system_uptime, poll_interval, status_msg, cpu_breakdown, mem_breakdown);
-
-    for (const auto &p : processes) prev_processes[p.pid] = p;
-
-    if (zombie_only) {
-        std::vector<ProcessInfo> filtered;
-        for (const auto &proc : processes)
-            if (proc.state == 'Z' || (proc.ppid == 1 && proc.pid != 1))
-                filtered.push_back(proc);
-        processes = filtered;
+    view_dirty = false;
+    rows.clear();
+    if (!snapshot) return;
+    const ProcessTable& t = snapshot->table;
+    rows.reserve(t.size());
+
+    Clock::time_point t0 = Clock::now();
+    for (uint32_t r = 0; r < t.size(); r++)
+        if (!zombie_only || t.state[r] == 'Z' || (t.ppid[r] == 1 && t.pid[r] != 1))
+            rows.push_back(r);
+    if (zombie_only) ui_cost[UI_ZOMBIE].add(msSince(t0));
+
+    if (group_by != GroupBy::NONE) {
+        t0 = Clock::now();
+        GroupBy::aggregate(t, rows, group_by, groups);
+        ui_cost[UI_GROUP].add(msSince(t0));
+        if (!drilled) { groupOrder(); return; }
+        // The filter was for the groups; a drilled-in group lists all of its members.
+        int g = GroupBy::find(groups, drill_label);
+        if (g >= 0) GroupBy::members(groups, (uint32_t)g, rows);
+        else rows.clear();
+    } else if (!filter_prog.empty()) {
+        t0 = Clock::now();
+        FilterEngine::filterProcesses(t, rows, filter_prog);
+        ui_cost[UI_FILTER].add(msSince(t0));
     }
 
-    if (!filter_input.empty()) {
-        std::vector<ProcessInfo> filtered;
-        std::string lower_filter = filter_input;
-        std::transform(lower_filter.begin(), lower_filter.end(), lower_filter.begin(), ::tolower);
-        for (const auto &proc : processes) {
-            std::string lower_cmd = proc.cmd;
-            std::transform(lower_cmd.begin(), lower_cmd.end(), lower_cmd.begin(), ::tolower);
-            if (lower_cmd.find(lower_filter) != std::string::npos)
-                filtered.push_back(proc);
-        }
-        processes = filtered;
+    if (thread_view) threadOrder();
+    else if (cgroup_view) cgroupOrder();
+    else if (tree_view) treeOrder();
+    else sortView(sortWindow());
+}
+
+// Swaps the filtered process rows for the rows of their threads, or of the expanded processes'
+// threads when nothing is filtered. The collector scans threads for thread_scope from the next
+// tick, so a newly expanded process shows up one tick later.
+void ProcessAnalyzer::threadOrder()
+{
+    const ProcessTable& t = snapshot->table;
+    process_rows = rows;
+    thread_scope.clear();
+    if (zombie_only || !filter_prog.empty())
+        for (uint32_t r : rows) thread_scope.push_back(t.pid[r]);
+    else
+        thread_scope.assign(expanded.begin(), expanded.end());
+    std::sort(thread_scope.begin(), thread_scope.end());
+
+    const ThreadTable& th = snapshot->threads;
+    rows.clear();
+    for (uint32_t i = 0; i < th.size(); i++)
+        if (std::binary_search(thread_scope.begin(), thread_scope.end(), th.tgid[i])) rows.push_back(i);
+    Clock::time_point t0 = Clock::now();
+    ProcessSorter::sortThreads(th, rows, sort_criterion, sort_inverted);
+    ui_cost[UI_SORT].add(msSince(t0));
+    sorted_upto = rows.size();
+    view_gen++;
+}
+
+// Filters and sort keys run over the group table as they do over processes, plus count.
+void ProcessAnalyzer::groupOrder()
+{
+    process_rows = rows;
+    rows.clear();
+    for (uint32_t g = 0; g < groups.table.size(); g++) rows.push_back(g);
+    if (!filter_prog.empty()) {
+        Clock::time_point t0 = Clock::now();
+        FilterEngine::filterGroups(groups, rows, filter_prog);
+        ui_cost[UI_FILTER].add(msSince(t0));
+    }
+    Clock::time_point t0 = Clock::now();
+    ProcessSorter::sortGroups(groups, rows, sort_criterion, sort_inverted);
+    ui_cost[UI_SORT].add(msSince(t0));
+    sorted_upto = rows.size();
+    view_gen++;
+}
+
+// The cgroup panel lists every cgroup the collector found; a filter narrows the processes it
+// would drill down to, not the cgroups' totals.
+void ProcessAnalyzer::cgroupOrder()
+{
+    process_rows = rows;
+    rows.clear();
+    for (uint32_t i = 0; i < snapshot->cgroups.size(); i++) rows.push_back(i);
+    Clock::time_point t0 = Clock::now();
+    ProcessSorter::sortCgroups(snapshot->cgroups, snapshot->table.strings, rows, sort_criterion, sort_inverted);
+    ui_cost[UI_SORT].add(msSince(t0));
+    sorted_upto = rows.size();
+    view_gen++;
+}
+
+// Tree mode lists the rows that passed the filters in the scan's pre-order and skips the
+// descendants of collapsed nodes, so selection, search and kill index the lines that are drawn.
+void ProcessAnalyzer::treeOrder()
+{
+    const ProcessTable& t = snapshot->table;
+    const TreeIndex& tree = t.tree;
+    std::vector<char> keep(t.size(), 0);
+    for (uint32_t r : rows) keep[r] = 1;
+    collapsed_rows.assign(t.size(), 0);
+    for (auto it = collapsed.begin(); it != collapsed.end(); ) {
+        int r = t.find(*it);
+        if (r < 0) { it = collapsed.erase(it); continue; }
+        collapsed_rows[r] = 1;
+        ++it;
+    }
+
+    rows.clear();
+    for (size_t k = 0; k < tree.order.size(); k++) {
+        uint32_t r = tree.order[k];
+        if (keep[r]) rows.push_back(r);
+        if (collapsed_rows[r]) k += tree.subtree_size[r] - 1;
+    }
+    sorted_upto = rows.size();
+    view_gen++;
+}
+
+// Rows past the visible window only need ordering once the user scrolls to them, so the UI sorts
+// a top-K prefix of two screens past the scroll offset. JSON and CSV logging need the full order.
+size_t ProcessAnalyzer::sortWindow() const
+{
+    if (!win || logging_enabled) return 0;
+    int page = std::max(1, listLines());
+    return scroll_offset + 2 * page;
+}
+
+void ProcessAnalyzer::sortView(size_t top)
+{
+    Clock::time_point t0 = Clock::now();
+    if (top >= rows.size()) top = 0;
+    ProcessSorter::sortProcesses(snapshot->table, rows, sort_criterion, sort_inverted, top);
+    sorted_upto = top ? top : rows.size();
+    view_gen++;
+    ui_cost[UI_SORT].add(msSince(t0));
+}
+
+// Moves through the history ring; negative is back in time. Live counts as the newest frame, so
+// the first step back shows the tick before it, and stepping forward onto it returns to live.
+void ProcessAnalyzer::stepHistory(long ticks)
+{
+    const History* h = collector.history();
+    if (!h) {
+        status_msg = collector.historyError().empty() ? "History is off (--history-mb 0)" : collector.historyError();
+        return;
+    }
+    History::Stats st = h->stats();
+    if (!st.frames) { status_msg = "No history yet"; return; }
+    int64_t newest = (int64_t)st.appended - 1, oldest = (int64_t)(st.appended - st.frames);
+    int64_t at = (history_mode ? (int64_t)history_frame : newest) + ticks;
+    view_dirty = needs_redraw = true;
+    if (at >= newest && ticks > 0) {
+        history_mode = false;
+        snapshot = collector.latest();
+        status_msg = "Live";
+        return;
     }
+    if (at < oldest) at = oldest;
+
+    std::shared_ptr<Snapshot> past = std::make_shared<Snapshot>();
+    uint64_t ms = 0;
+    if (!h->read((uint64_t)at, *past, ms)) { status_msg = "History frame no longer available"; return; }
+    if (snapshot) past->self = snapshot->self;
+    snapshot = past;
+    history_mode = true;
+    history_frame = (uint64_t)at;
+    history_ms = ms;
+}
 
-    if (!sort_criterion.empty()) ProcessSorter::sortProcesses(processes, sort_criterion);
-    if (sort_inverted) std::reverse(processes.begin(), processes.end());
-    if (logging_enabled) ProcessLogger::logProcesses(log_file, processes, status_msg);
+std::string ProcessAnalyzer::historyLabel() const
+{
+    time_t secs = (time_t)(history_ms / 1000);
+    struct tm tm;
+    char when[16];
+    localtime_r(&secs, &tm);
+    strftime(when, sizeof(when), "%H:%M:%S", &tm);
+    uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    long ago = now_ms > history_ms ? (long)((now_ms - history_ms) / 1000) : 0;
+    return std::string("HISTORY ") + when + " (" + std::to_string(ago) + "s ago)  [ ] step 1, { } step 60, forward past newest for live";
+}
+
+// An expression that does not parse (often one still being typed) keeps the last good program
+// in force and shows the error next to the input. Switching grouping on or off recompiles from
+// scratch, since count is only valid for groups.
+void ProcessAnalyzer::compileFilter(bool regroup)
+{
+    filter_error.clear();
+    if (filter_input.empty() || regroup) filter_prog = FilterEngine::Program();
+    if (filter_input.empty()) return;
+    FilterEngine::compile(filter_input, filter_prog, filter_error, group_by != GroupBy::NONE);
+}
+
+// Back to processes: a count filter or sort key no longer applies.
+void ProcessAnalyzer::leaveGroups()
+{
+    group_by = GroupBy::NONE;
+    compileFilter(true);
+    if (!ProcessSorter::isKey(sort_criterion)) sort_criterion = "cpu";
+}
+
+// Tells the collector which PIDs need every field on its next scan: visible and tagged rows,
+// everything left by an active filter, plus whatever the sort key and CSV log need for all PIDs.
+void ProcessAnalyzer::publishDemand(const std::vector<pid_t>& visible)
+{
+    SystemUtils::ScanDemand d;
+    d.refresh_ticks = opts.refresh_ticks;
+    d.all_fields = 0;
+    d.all_fields |= ProcessSorter::fieldsFor(sort_criterion);
+    if (logging_enabled) d.all_fields |= opts.fields & ProcessLogger::fieldsFor(log_cfg.columns);
+    // Group rows sum their members' rates and descriptors, so every member needs a fresh sample.
+    if (group_by != GroupBy::NONE) d.all_fields |= FIELD_IO | FIELD_NET | FIELD_FD;
+
+    d.hot_pids.insert(visible.begin(), visible.end());
+    d.hot_pids.insert(tagged_pids.begin(), tagged_pids.end());
+    // A filter over groups leaves every process in play, so only a process filter narrows them.
+    if (zombie_only || drilled || (!filter_prog.empty() && group_by == GroupBy::NONE))
+        for (uint32_t r : processRows() ? rows : process_rows) d.hot_pids.insert(snapshot->table.pid[r]);
+    if (thread_view) d.thread_pids.insert(thread_scope.begin(), thread_scope.end());
+    d.cgroups = cgroup_view || group_by == GroupBy::CGROUP || FilterEngine::usesCgroups(filter_prog);
+    // numa_maps walks the page tables, so only the selected and tagged processes get it.
+    d.numa_pids.insert(tagged_pids.begin(), tagged_pids.end());
+    if (processRows() && selected_row >= 0 && selected_row < (int)rows.size())
+        d.numa_pids.insert(snapshot->table.pid[rows[selected_row]]);
+    collector.setDemand(d);
 }
 
 void ProcessAnalyzer::handleInput(int ch)
 {
-    int max_lines = getmaxy(win) - 6;
-    int total_lines = (int)processes.size();
+    int max_lines = listLines();
+    int total_lines = (int)rows.size();
 
     if (filter_mode) {
         if (ch == 27 || ch == KEY_F(4)) {
@@ -140,8 +358,9 @@ void ProcessAnalyzer::handleInput(int ch)
         } else if (ch > 0 && ch < 256 && isprint(ch)) {
             filter_input += (char)ch;
         }
+        compileFilter();
         selected_row = 0; scroll_offset = 0;
-        needs_redraw = true;
+        view_dirty = needs_redraw = true;
         return;
     }
 
@@ -154,12 +373,15 @@ void ProcessAnalyzer::handleInput(int ch)
         else if (ch == '\n' || ch == KEY_ENTER) { search_mode = false; }
         else if (ch > 0 && ch < 256 && isprint(ch)) {
             search_input += (char)ch;
-            std::string lower_search = search_input;
-            std::transform(lower_search.begin(), lower_search.end(), lower_search.begin(), ::tolower);
+            if (sorted_upto < rows.size()) sortView(0);
+            const ProcessTable& t = groupList() ? groups.table : snapshot->table;
+            const ThreadTable& th = snapshot->threads;
+            std::vector<uint8_t> hit;
+            if (thread_view) th.names.containing(search_input, hit);
+            else t.strings.containing(search_input, hit);
             for (int i = 0; i < total_lines; i++) {
-                std::string lower_cmd = processes[i].cmd;
-                std::transform(lower_cmd.begin(), lower_cmd.end(), lower_cmd.begin(), ::tolower);
-                if (lower_cmd.find(lower_search) != std::string::npos) {
+                uint32_t id = thread_view ? th.name[rows[i]] : cgroup_view ? snapshot->cgroups[rows[i]].path : t.cmd[rows[i]];
+                if (hit[id]) {
                     selected_row = i;
                     if (selected_row >= scroll_offset + max_lines) scroll_offset = selected_row - max_lines + 1;
                     if (selected_row < scroll_offset) scroll_offset = selected_row;
@@ -209,7 +431,7 @@ void ProcessAnalyzer::handleInput(int ch)
         needs_redraw = true; break;
 
     case KEY_F(1): case 'h': case '?':
-        showHelp(win); needs_redraw = true; break;
+        showHelp(win); frame.invalidate(); needs_redraw = true; break;
 
     case KEY_F(3): case '/':
         search_mode = true; search_input.clear();
@@ -218,24 +440,48 @@ void ProcessAnalyzer::handleInput(int ch)
 
     case KEY_F(4): case '\\':
         filter_mode = true;
-        status_msg = "Filter: type to filter, Enter to confirm, Esc to clear";
+        status_msg = "Filter: e.g. cpu>5 and not state:S, rss>=1G, cmd~^py; Enter to confirm, Esc to clear";
         needs_redraw = true; break;
 
     case KEY_F(5): case 't':
         tree_view = !tree_view; selected_row = 0; scroll_offset = 0;
         status_msg = tree_view ? "Tree view" : "List view";
-        needs_redraw = true; break;
+        view_dirty = needs_redraw = true; break;
+
+    case '-': case '+': case '=':
+        if (tree_view && processRows() && selected_row >= 0 && selected_row < total_lines) {
+            uint32_t r = rows[selected_row];
+            if (snapshot->table.tree.subtree_size[r] > 1) {
+                if (ch == '-') collapsed.insert(snapshot->table.pid[r]);
+                else collapsed.erase(snapshot->table.pid[r]);
+                view_dirty = needs_redraw = true;
+            }
+        }
+        break;
+
+    case '*':
+        if (tree_view && processRows()) { collapsed.clear(); view_dirty = needs_redraw = true; }
+        break;
 
     // Here be dragons.
     case KEY_F(6): case '>': case '.':
-        sort_criterion = (sort_criterion == "cpu") ? "mem" : (sort_criterion == "mem") ? "io" : (sort_criterion == "io") ? "net" : "cpu";
+        sort_criterion = ProcessSorter::nextKey(sort_criterion, groupList());
         status_msg = "Sort: " + sort_criterion;
         selected_row = 0; scroll_offset = 0;
-        needs_redraw = true; break;
+        view_dirty = needs_redraw = true; break;
+
+    case '[': stepHistory(-1); break;
+    case ']': stepHistory(1); break;
+    case '{': stepHistory(-60); break;
+    case '}': stepHistory(60); break;
 
     case KEY_F(9): case 'k':
-        if (selected_row >= 0 && selected_row < (int)processes.size()) {
-            auto proc = processes[selected_row];
+        if (history_mode) { status_msg = "Read-only while viewing history"; needs_redraw = true; break; }
+        if (thread_view) { status_msg = "Press H to return to processes and kill one"; needs_redraw = true; break; }
+        if (cgroup_view) { status_msg = "Press Enter to list the cgroup's processes"; needs_redraw = true; break; }
+        if (groupList()) { status_msg = "Press Enter to list the group's processes"; needs_redraw = true; break; }
+        if (selected_row >= 0 && selected_row < total_lines) {
+            ProcessInfo proc = snapshot->table.row(rows[selected_row]);
             std::string prompt;
             bool kill_parent = false;
             if (proc.state == 'Z') {
@@ -255,25 +501,27 @@ void ProcessAnalyzer::handleInput(int ch)
         }
         needs_redraw = true; break;
 
-    case KEY_F(10): case 'q': endwin(); exit(0);
+    case KEY_F(10): case 'q': running = false; break;
 
-    case 'M': sort_criterion = "mem"; status_msg = "Sort: mem"; needs_redraw = true; break;
-    case 'P': sort_criterion = "cpu"; status_msg = "Sort: cpu"; needs_redraw = true; break;
-    case 'N': sort_criterion = ""; sort_inverted = false; status_msg = "Sort: PID (default)"; needs_redraw = true; break;
-    case 'I': sort_inverted = !sort_inverted; status_msg = sort_inverted ? "Sort inverted" : "Sort normal"; needs_redraw = true; break;
+    case 'M': sort_criterion = "mem"; status_msg = "Sort: mem"; view_dirty = needs_redraw = true; break;
+    case 'P': sort_criterion = "cpu"; status_msg = "Sort: cpu"; view_dirty = needs_redraw = true; break;
+    case 'N': sort_criterion = "pid"; sort_inverted = false; status_msg = "Sort: PID (default)"; view_dirty = needs_redraw = true; break;
+    case 'I': sort_inverted = !sort_inverted; status_msg = sort_inverted ? "Sort inverted" : "Sort normal"; view_dirty = needs_redraw = true; break;
 
     case 'z':
-        zombie_only = !zombie_only; filter_input.clear();
+        zombie_only = !zombie_only; filter_input.clear(); compileFilter();
         status_msg = zombie_only ? "Zombies/orphans only" : "All processes";
         selected_row = 0; scroll_offset = 0;
-        needs_redraw = true; break;
+        view_dirty = needs_redraw = true; break;
 
     case 'x': {
+        if (history_mode) { status_msg = "Read-only while viewing history"; needs_redraw = true; break; }
         int killed = 0;
-        for (const auto &p : processes) {
-            if (p.state == 'Z') {
-                if (kill(p.ppid, SIGCHLD) == 0) killed++;
-                else kill(p.ppid, SIGTERM);
+        for (uint32_t r : processRows() ? rows : process_rows) {
+            const ProcessTable& t = snapshot->table;
+            if (t.state[r] == 'Z') {
+                if (kill(t.ppid[r], SIGCHLD) == 0) killed++;
+                else kill(t.ppid[r], SIGTERM);
             }
         }
         status_msg = "Purged " + std::to_string(killed) + " zombie(s)";
@@ -282,13 +530,14 @@ void ProcessAnalyzer::handleInput(int ch)
 
     case 'l':
         logging_enabled = !logging_enabled;
-        if (!logging_enabled && log_file.is_open()) log_file.close();
-        status_msg = logging_enabled ? "Logging ON" : "Logging OFF";
+        if (logging_enabled) logger.reset(new ProcessLogger::Logger(log_cfg));
+        else logger.reset();
+        status_msg = logging_enabled ? "Logging to " + log_cfg.path : "Logging OFF";
         needs_redraw = true; break;
 
     case ' ':
-        if (selected_row >= 0 && selected_row < (int)processes.size()) {
-            tagged_pids.insert(processes[selected_row].pid);
+        if (processRows() && selected_row >= 0 && selected_row < total_lines) {
+            tagged_pids.insert(snapshot->table.pid[rows[selected_row]]);
             if (selected_row < total_lines - 1) selected_row++;
             if (selected_row >= scroll_offset + max_lines) scroll_offset++;
         }
@@ -298,82 +547,218 @@ void ProcessAnalyzer::handleInput(int ch)
         tagged_pids.clear(); status_msg = "Untagged all";
         needs_redraw = true; break;
 
+    case 'S':
+        show_self = !show_self;
+        needs_redraw = true; break;
+
+    case 'c':
+        show_cores = !show_cores;
+        frame.invalidate();
+        needs_redraw = true; break;
+
+    case 'H':
+        if (history_mode) { status_msg = "History keeps no threads"; needs_redraw = true; break; }
+        if (cgroup_view) { status_msg = "Press C to leave the cgroup panel first"; needs_redraw = true; break; }
+        if (groupList()) { status_msg = "Press Enter to open a group first"; needs_redraw = true; break; }
+        thread_view = !thread_view;
+        expanded.clear();
+        if (thread_view) {
+            expanded = tagged_pids;
+            if (selected_row >= 0 && selected_row < total_lines) expanded.insert(snapshot->table.pid[rows[selected_row]]);
+            status_msg = zombie_only || !filter_prog.empty() ? "Threads of the filtered processes"
+                                                              : "Threads of " + std::to_string(expanded.size()) + " process(es)";
+        } else status_msg = tree_view ? "Tree view" : "List view";
+        selected_row = 0; scroll_offset = 0;
+        view_dirty = needs_redraw = true; break;
+
+    case 'C':
+        if (history_mode) { status_msg = "History keeps no cgroups"; needs_redraw = true; break; }
+        cgroup_view = !cgroup_view;
+        thread_view = false;
+        if (group_by != GroupBy::NONE) leaveGroups();
+        drilled = false;
+        // The collector maps processes to cgroups from the next tick on.
+        status_msg = cgroup_view ? "Cgroups (v2); Enter lists a cgroup's processes" : tree_view ? "Tree view" : "List view";
+        selected_row = 0; scroll_offset = 0;
+        view_dirty = needs_redraw = true; break;
+
+    // Drill-down: the selected cgroup becomes the filter and the process list returns, or the
+    // selected group's members are listed.
+    case '\n': case KEY_ENTER:
+        if (selected_row < 0 || selected_row >= total_lines) break;
+        if (cgroup_view) {
+            // Built from the path itself rather than parsed back, so blanks, parentheses and glob
+            // characters in it match literally; the quoted text recompiles to the same program.
+            std::string path = snapshot->table.strings.str(snapshot->cgroups[rows[selected_row]].path);
+            filter_input = "cgroup=\"" + path + "\"";
+            filter_error.clear();
+            filter_prog = FilterEngine::cgroupIs(path);
+            cgroup_view = false;
+            status_msg = "Filter: " + filter_input;
+        } else if (groupList()) {
+            drilled = true;
+            drill_label = groups.table.cmdStr(rows[selected_row]);
+            status_msg = "Group " + drill_label + "; Backspace returns to the groups";
+        } else break;
+        selected_row = 0; scroll_offset = 0;
+        view_dirty = needs_redraw = true;
+        break;
+
+    case 'g':
+        group_by = GroupBy::next(group_by);
+        if (group_by == GroupBy::NONE) leaveGroups();
+        else compileFilter(true);
+        drilled = false;
+        thread_view = cgroup_view = false;
+        status_msg = group_by == GroupBy::NONE ? (tree_view ? "Tree view" : "List view")
+                                               : std::string("Group by ") + GroupBy::name(group_by) + "; Enter lists a group's processes";
+        selected_row = 0; scroll_offset = 0;
+        view_dirty = needs_redraw = true; break;
+
+    case KEY_BACKSPACE: case 127:
+        if (drilled) {
+            drilled = false;
+            status_msg = std::string("Group by ") + GroupBy::name(group_by);
+            selected_row = 0; scroll_offset = 0;
+            view_dirty = needs_redraw = true;
+        }
+        break;
+
     case KEY_RESIZE:
         endwin(); refresh(); werase(win);
+        frame.invalidate();
         needs_redraw = true; break;
     }
 }
 
 void ProcessAnalyzer::render()
 {
-    werase(win);
-    DisplayEngine::displayHeader(win, mem_total, mem_free, system_cpu_usage, system_mem_usage,
-                                  system_uptime, num_cores, filters, logging_enabled,
-                                  sort_criterion, status_msg, cpu_breakdown, mem_breakdown);
+    Clock::time_point render_start = Clock::now();
+    static const Snapshot empty_snapshot;
+    const Snapshot& snap = snapshot ? *snapshot : empty_snapshot;
+    const SystemStats& sys = snap.system;
+    int height = getmaxy(win), width = getmaxx(win);
+    frame.resize(height, width);
+    int cores = !show_cores ? 0 : snap.cores.empty() ? core_rows
+                                : DisplayEngine::coreLines(snap.cores, snap.numa_nodes, width);
+    if (cores != core_rows) {
+        core_rows = cores;
+        frame.invalidate();
+    }
+    int top = listTop();
 
-    int width = getmaxx(win);
-    int cmd_w = std::min(40, std::max(15, width - 35));
-    wattrset(win, COLOR_PAIR(6) | A_BOLD | A_UNDERLINE);
-    char hdr[1024];
-    std::string cmd_hdr = "Command";
-    if ((int)cmd_hdr.size() < cmd_w) cmd_hdr += std::string(cmd_w - cmd_hdr.size(), ' ');
-    else cmd_hdr = cmd_hdr.substr(0, cmd_w);
-    std::snprintf(hdr, sizeof(hdr), "%5s %5s %1s %5s %5s %s %6s %6s %6s %6s %6s %6s %5s %4s %6s %5s %3s %3s %6s %6s",
-              "PID", "PPID", "S", "CPU%", "MEM%", cmd_hdr.c_str(),
-              "IO_R", "IO_W", "RChr", "WChr", "ShrCl", "PrvDr", "FD", "Thr", "CtxSw", "Age", "Pri", "Ni", "NetR", "NetW");
-    int hlen = (int)std::strlen(hdr);
-    if (hlen > h_scroll_offset) mvwaddnstr(win, 4, 0, hdr + h_scroll_offset, width);
-    wattrset(win, A_NORMAL);
+    // The header changes only with a new snapshot or status line, never on navigation.
+    std::string status = history_mode ? historyLabel() + (status_msg.empty() ? "" : " | " + status_msg) : status_msg;
+    std::string header_sig = std::to_string(snap.sequence) + '|' + status + '|' + sort_criterion +
+                             (logging_enabled ? "|log" : "") + (show_self ? "|self" : "");
+    if (frame.stale(0, header_sig, 0)) {
+        UiCosts ui;
+        if (show_self)
+            for (int p = 0; p < UI_PHASE_COUNT; p++) ui.phases[p] = ui_cost[p].cost();
+        DisplayEngine::displayHeader(win, sys.mem_total, sys.mem_free, sys.cpu_usage, sys.mem_usage,
+                                      sys.uptime, sys.num_cores, logging_enabled,
+                                      sort_criterion, status, snap.cpu_breakdown, snap.mem_breakdown,
+                                      snap.event_driven, snap.exited.size(), snap.self,
+                                      show_self ? &ui : NULL, snap.pressure);
+        if (core_rows) DisplayEngine::displayCores(win, 4, core_rows, snap.cores, snap.numa_nodes);
+    }
+    frame.paint(win, top, thread_view ? DisplayEngine::threadHeader(width)
+                          : cgroup_view ? DisplayEngine::cgroupHeader(width)
+                          : groupList() ? DisplayEngine::groupHeader(width, GroupBy::name(group_by)) : DisplayEngine::columnHeader(width),
+                COLOR_PAIR(6) | A_BOLD | A_UNDERLINE, h_scroll_offset);
+
+    // Row text is formatted only when the view or window moves; moving the selection reuses it,
+    // so a cursor key repaints just the two lines whose highlight changed.
+    int max_lines = listLines();
+    BodyKey key = {view_gen, scroll_offset, width, max_lines, tree_view, thread_view, cgroup_view, groupList()};
+    if (!(key == body_key)) {
+        body_key = key;
+        if (rows.empty()) body.clear();
+        else if (thread_view) DisplayEngine::threadRows(snap.threads, snap.table, rows, scroll_offset, max_lines, width, body);
+        else if (cgroup_view) DisplayEngine::cgroupRows(snap.cgroups, snap.table.strings, rows, scroll_offset, max_lines, width, body);
+        else if (groupList()) DisplayEngine::groupRows(groups, rows, scroll_offset, max_lines, width, body);
+        else if (tree_view) DisplayEngine::treeRows(snap.table, rows, scroll_offset, max_lines, width, collapsed_rows, body);
+        else DisplayEngine::listRows(snap.table, rows, scroll_offset, max_lines, width, body);
+    }
+    std::vector<pid_t> visible;
+    if (thread_view) visible = thread_scope;
+    else if (processRows()) for (const DisplayEngine::RowLine& line : body) visible.push_back(line.pid);
+    publishDemand(visible);
 
-    int max_lines = getmaxy(win) - 6;
-    if (processes.empty()) {
-        mvwprintw(win, 6, 0, "No processes to display");
-    } else if (tree_view) {
-        int line = 0;
-        auto roots = process_tree.find(0);
-        if (roots != process_tree.end()) {
-            for (auto pid : roots->second)
-                DisplayEngine::displayTree(win, pid, 0, line, max_lines, scroll_offset, h_scroll_offset, selected_row, process_map, process_tree);
+    for (int i = 0; i < max_lines; i++) {
+        if (i < (int)body.size()) {
+            int attr = scroll_offset + i == selected_row ? A_REVERSE : body[i].attr;
+            frame.paint(win, top + 1 + i, body[i].text, attr, h_scroll_offset);
         } else {
-            DisplayEngine::displayTree(win, 1, 0, line, max_lines, scroll_offset, h_scroll_offset, selected_row, process_map, process_tree);
+            const char* none = thread_view ? "No threads to display yet"
+                             : cgroup_view ? "No cgroups yet (needs cgroup v2)"
+                             : groupList() ? "No groups to display" : "No processes to display";
+            frame.paint(win, top + 1 + i, rows.empty() && i == 1 ? none : "", A_NORMAL);
         }
-    } else {
-        DisplayEngine::displayProcesses(win, max_lines, scroll_offset, h_scroll_offset, selected_row, processes);
     }
 
     // Here be dragons.
-    drawFunctionBar(win, filter_mode || search_mode,
-                    filter_mode ? ("Filter: " + filter_input) : ("Search: " + search_input));
+    bool prompt = filter_mode || search_mode;
+    std::string prompt_text = filter_mode ? ("Filter: " + filter_input + (filter_error.empty() ? "" : "   [" + filter_error + "]"))
+                                          : ("Search: " + search_input);
+    if (frame.stale(height - 1, prompt ? prompt_text : std::string(), prompt))
+        drawFunctionBar(win, prompt, prompt_text);
 
     wrefresh(win);
     needs_redraw = false;
+    ui_cost[UI_RENDER].add(msSince(render_start));
 }
 
+// The collector thread does all /proc scanning; this loop only picks up finished snapshots,
+// handles input and redraws, so a slow scan never delays a keypress by more than one frame.
 void ProcessAnalyzer::run()
 {
-    while (true)
+    if (!collector.eventsError().empty()) status_msg = collector.eventsError();
+    publishDemand(std::vector<pid_t>());
+    snapshot = collector.collect();
+    updateProcessList();
+    collector.start(poll_interval);
+
+    while (running)
     {
-        system_uptime = SystemUtils::getUptime();
-        updateProcessList();
-        render();
-
-        auto start = std::chrono::steady_clock::now();
-        while (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count() < poll_interval)
-        {
-            int ch;
-            bool handled = false;
-            while ((ch = getch()) != ERR) { handleInput(ch); handled = true; }
-            if (handled && needs_redraw) render();
-            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        std::shared_ptr<const Snapshot> latest = collector.latest();
+        if (!history_mode && latest != snapshot) {
+            snapshot = latest;
+            view_dirty = needs_redraw = true;
+            updateProcessList();
+            if (logging_enabled) {
+                Clock::time_point t0 = Clock::now();
+                logger->log(snapshot->table, processRows() ? rows : process_rows, opts.fields);
+                ui_cost[UI_LOG].add(msSince(t0));
+                std::string log_status = logger->status();
+                if (!log_status.empty()) status_msg = log_status;
+            }
         }
+
+        int ch;
+        while (running && (ch = getch()) != ERR) handleInput(ch);
+        if (!running) break;
+        if (view_dirty) updateProcessList();
+        else if (sorted_upto < rows.size() && scroll_offset + listLines() > (int)sorted_upto) sortView(sortWindow());
+        if (needs_redraw) render();
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
     }
+    collector.stop();
 }
 
-ProcessAnalyzer::ProcessAnalyzer(bool ncurses_init)
+ProcessAnalyzer::ProcessAnalyzer(bool ncurses_init, const Options& options) : opts(options), collector(options)
 {
-    clk_tck = sysconf(_SC_CLK_TCK);
-    num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    system_uptime = SystemUtils::getUptime();
+    sort_criterion = opts.sort;
+    log_cfg.path = opts.log_path;
+    ProcessLogger::parseColumns(opts.log_columns, log_cfg.columns);
+    log_cfg.rotate_bytes = (size_t)opts.log_rotate_mb * 1024 * 1024;
+    log_cfg.rotate_secs = opts.log_rotate_min * 60;
+    log_cfg.keep = opts.log_keep;
+    log_cfg.compress = opts.log_compress;
+    if (opts.log && !opts.json) {
+        logging_enabled = true;
+        logger.reset(new ProcessLogger::Logger(log_cfg));
+    }
     if (ncurses_init)
     {
         initscr(); start_color();
@@ -393,36 +778,250 @@ ProcessAnalyzer::ProcessAnalyzer(bool ncurses_init)
 }
 
 ProcessAnalyzer::~ProcessAnalyzer() {
-    if (log_file.is_open()) log_file.close();
     if (win) { delwin(win); endwin(); }
 }
 
+// Whole buffers go out with one fwrite; false once stdout is gone (e.g. the reader exited).
+static bool writeOut(const std::string& buf)
+{
+    if (buf.empty()) return true;
+    return fwrite(buf.data(), 1, buf.size(), stdout) == buf.size() && fflush(stdout) == 0;
+}
+
+static std::vector<int> jsonFields(const Options& opts)
+{
+    std::vector<int> fields;
+    if (opts.json_fields.empty() || !JsonOutput::parseFields(opts.json_fields, fields)) fields = JsonOutput::defaultFields();
+    return fields;
+}
+
+// Two scans --interval apart, so the rates cover a real interval.
+void ProcessAnalyzer::sampleOnce()
+{
+    if (!collector.eventsError().empty()) std::cerr << collector.eventsError() << "\n";
+    collector.setInterval(opts.interval_ms / 1000.0);
+    collector.collect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(opts.interval_ms));
+    snapshot = collector.collect();
+}
+
 void ProcessAnalyzer::printJSON()
 {
-    system_uptime = SystemUtils::getUptime();
-    updateProcessList();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    system_uptime = SystemUtils::getUptime();
+    sampleOnce();
+    writeJSON();
+}
+
+// Writes the sample to opts.dump_binary, or to stdout when that is empty.
+bool ProcessAnalyzer::dumpBinary()
+{
+    sampleOnce();
+    std::string out;
+    uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    SnapshotFormat::write(*snapshot, now_ms, out);
+    FILE* f = opts.dump_binary.empty() ? stdout : fopen(opts.dump_binary.c_str(), "wb");
+    if (!f) { std::cerr << "Cannot open " << opts.dump_binary << ": " << strerror(errno) << "\n"; return false; }
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    ok = (f == stdout ? fflush(f) : fclose(f)) == 0 && ok;
+    if (!ok) std::cerr << "Cannot write binary snapshot\n";
+    return ok;
+}
+
+// Prints a --dump-binary file as --json would have printed the same sample.
+bool ProcessAnalyzer::readBinary(const std::string& path)
+{
+    SnapshotFormat::Reader in;
+    std::shared_ptr<Snapshot> snap = std::make_shared<Snapshot>();
+    std::string error;
+    if (!in.open(path.c_str(), error) || !SnapshotFormat::read(in, *snap, error)) {
+        std::cerr << path << ": " << error << "\n";
+        return false;
+    }
+    snapshot = snap;
+    writeJSON();
+    return true;
+}
+
+void ProcessAnalyzer::writeJSON()
+{
     updateProcessList();
+    std::vector<int> fields = jsonFields(opts);
+    const ProcessTable& t = snapshot->table;
+    std::string out;
+    out.reserve(rows.size() * 192);
+    out += "{\n  \"system\": ";
+    JsonOutput::appendSystem(out, snapshot->system);
+    out += ",\n  \"processes\": [\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        out += "    ";
+        JsonOutput::appendProcess(out, t, rows[i], fields, opts.fields);
+        out += i + 1 < rows.size() ? ",\n" : "\n";
+    }
+    out += "  ]";
+    if (snapshot->event_driven) {
+        out += ",\n  \"exited\": [\n";
+        for (size_t i = 0; i < snapshot->exited.size(); ++i) {
+            out += "    ";
+            JsonOutput::appendExited(out, snapshot->exited[i]);
+            out += i + 1 < snapshot->exited.size() ? ",\n" : "\n";
+        }
+        out += "  ]";
+    }
+
+    const CollectorStats& self = snapshot->self;
+    out += ",\n  \"self\": {\n    \"syscalls\": ";
+    TextFormat::appendUint(out, self.syscalls);
+    out += ",\n    \"bytes_read\": ";
+    TextFormat::appendUint(out, self.bytes_read);
+    out += ",\n    \"open_fds\": ";
+    TextFormat::appendInt(out, self.open_fds);
+    out += ",\n    \"prev_samples\": ";
+    TextFormat::appendUint(out, self.prev_samples);
+    out += ",\n    \"prev_bytes\": ";
+    TextFormat::appendUint(out, self.prev_bytes);
+    out += ",\n    \"phases_ms\": {";
+    const char* sep = "";
+    auto phase = [&](const char* name, const PhaseCost& c) {
+        if (!c.samples) return;
+        out += sep;
+        TextFormat::appendJson(out, name, strlen(name));
+        out += ":{\"p50\":";
+        TextFormat::appendFixed(out, c.p50_ms, 3);
+        out += ",\"p99\":";
+        TextFormat::appendFixed(out, c.p99_ms, 3);
+        out += '}';
+        sep = ",";
+    };
+    phase("scan", self.scan);
+    for (int p = 0; p < SystemUtils::PHASE_COUNT; p++) phase(SystemUtils::ScanTimings::name(p), self.phases[p]);
+    phase("record", self.record);
+    phase("history", self.history);
+    for (int p = 0; p < UI_PHASE_COUNT; p++) phase(UiCosts::name(p), ui_cost[p].cost());
+    out += "}\n  }\n}\n";
+    writeOut(out);
+}
+
+static volatile sig_atomic_t stream_stop = 0;
+
+static void stopStream(int)
+{
+    stream_stop = 1;
+}
+
+// One line per tick, or with ndjson_per_process one line per process per tick plus a system
+// line. Processes come in PID order. With changed_only a process is written only when one of its
+// fields other than age differs from the last time it was written, and processes that went away
+// are listed under "gone".
+void ProcessAnalyzer::streamNDJSON()
+{
+    if (!collector.eventsError().empty()) std::cerr << collector.eventsError() << "\n";
+    std::vector<int> fields = jsonFields(opts);
+    SystemUtils::ScanDemand d;
+    d.refresh_ticks = 0;
+    d.all_fields = opts.fields & JsonOutput::scanFieldsFor(fields);
+    collector.setDemand(d);
+
+    struct sigaction sa = {};
+    sa.sa_handler = stopStream;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
 
-    std::cout << "{\n  \"system\": {\n"
-              << "    \"cpu_usage\": " << system_cpu_usage << ",\n"
-              << "    \"mem_usage\": " << system_mem_usage << ",\n"
-              << "    \"mem_total\": " << mem_total << ",\n"
-              << "    \"mem_free\": " << mem_free << ",\n"
-              << "    \"uptime\": " << system_uptime << ",\n"
-              << "    \"num_cores\": " << num_cores << "\n  },\n";
-    std::cout << "  \"processes\": [\n";
-    for (size_t i = 0; i < processes.size(); ++i) {
-        const auto &p = processes[i];
-        std::cout << "    {\"pid\":" << p.pid << ",\"ppid\":" << p.ppid
-                  << ",\"state\":\"" << p.state << "\",\"cmd\":\"" << p.cmd
-                  << "\",\"cpu\":" << p.cpu_usage << ",\"mem\":" << p.mem_usage
-                  << ",\"rss\":" << p.rss << ",\"threads\":" << p.num_threads
-                  << ",\"io_r\":" << p.io_read_rate << ",\"io_w\":" << p.io_write_rate
-                  << ",\"net_rx\":" << p.net_rx_rate << ",\"net_tx\":" << p.net_tx_rate
-                  << ",\"age\":" << p.process_age << "}"
-                  << (i < processes.size()-1 ? "," : "") << "\n";
+    collector.start(opts.interval_ms / 1000.0);
+    std::unordered_map<pid_t, uint64_t> written, next_written;
+    std::vector<pid_t> gone;
+    std::string out, head;
+    uint64_t seen = 0;
+    bool first_tick = true;
+    while (!stream_stop) {
+        std::shared_ptr<const Snapshot> snap = collector.waitNewer(seen, 200);
+        if (!snap || snap->sequence <= seen) continue;
+        seen = snap->sequence;
+        // The first scan has no previous sample, so its rates are all zero.
+        if (first_tick) { first_tick = false; continue; }
+
+        const ProcessTable& t = snap->table;
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        head = "{\"ts\":";
+        TextFormat::appendUint(head, now_ms);
+        head += ",\"seq\":";
+        TextFormat::appendUint(head, snap->sequence);
+        head += ',';
+
+        out.clear();
+        out += head;
+        out += "\"system\":";
+        JsonOutput::appendSystem(out, snap->system);
+        if (opts.ndjson_per_process) out += "}\n";
+        else out += ",\"processes\":[";
+
+        next_written.clear();
+        bool first = true;
+        for (size_t r = 0; r < t.size(); r++) {
+            size_t start = out.size();
+            if (opts.ndjson_per_process) { out += head; out += "\"process\":"; }
+            else if (!first) out += ',';
+            uint64_t h = JsonOutput::appendProcess(out, t, r, fields, opts.fields);
+            if (opts.changed_only) {
+                next_written[t.pid[r]] = h;
+                auto it = written.find(t.pid[r]);
+                if (it != written.end() && it->second == h) { out.resize(start); continue; }
+            }
+            if (opts.ndjson_per_process) out += "}\n";
+            first = false;
+        }
+        if (!opts.ndjson_per_process) out += ']';
+
+        if (snap->event_driven) {
+            if (!opts.ndjson_per_process) out += ",\"exited\":[";
+            for (size_t i = 0; i < snap->exited.size(); i++) {
+                if (opts.ndjson_per_process) { out += head; out += "\"exited\":"; }
+                else if (i) out += ',';
+                JsonOutput::appendExited(out, snap->exited[i]);
+                if (opts.ndjson_per_process) out += "}\n";
+            }
+            if (!opts.ndjson_per_process) out += ']';
+        }
+
+        if (opts.changed_only) {
+            gone.clear();
+            for (const auto& w : written)
+                if (!next_written.count(w.first)) gone.push_back(w.first);
+            std::sort(gone.begin(), gone.end());
+            if (!opts.ndjson_per_process) out += ",\"gone\":[";
+            for (size_t i = 0; i < gone.size(); i++) {
+                if (opts.ndjson_per_process) { out += head; out += "\"gone\":"; }
+                else if (i) out += ',';
+                TextFormat::appendInt(out, gone[i]);
+                if (opts.ndjson_per_process) out += "}\n";
+            }
+            if (!opts.ndjson_per_process) out += ']';
+            written.swap(next_written);
+        }
+        if (!opts.ndjson_per_process) out += "}\n";
+        if (!writeOut(out)) break;
     }
-    std::cout << "  ]\n}\n";
+    collector.stop();
+}
+
+// Headless: one collector feeds every client of the daemon socket until SIGINT or SIGTERM.
+bool ProcessAnalyzer::serveDaemon()
+{
+    if (!collector.eventsError().empty()) std::cerr << collector.eventsError() << "\n";
+    Daemon daemon(collector, opts);
+    std::string error;
+    if (!daemon.listen(error)) { std::cerr << error << "\n"; return false; }
+
+    struct sigaction sa = {};
+    sa.sa_handler = stopStream;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::cerr << "Serving on " << daemon.socketPath() << "\n";
+    collector.start(opts.interval_ms / 1000.0);
+    daemon.run(stream_stop);
+    collector.stop();
+    return true;
 }
@@ -1,31 +1,319 @@
 #include "ProcessLogger.h"
-#include <ctime>
+#include "TextFormat.h"
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
 
 namespace ProcessLogger {
 
-void logProcesses(std::ofstream& log_file, const std::vector<ProcessInfo>& processes, std::string& status_msg)
+using namespace TextFormat;
+
+namespace {
+
+// More than this many formatted ticks waiting for the writer means the disk cannot keep up.
+const size_t MAX_QUEUED = 8;
+
+struct ColumnInfo {
+    const char* name;
+    const char* title;
+    unsigned field;
+};
+
+const ColumnInfo COLUMNS[L_COLUMN_COUNT] = {
+    {"time",    "Timestamp",     0},
+    {"pid",     "PID",           0},
+    {"ppid",    "PPID",          0},
+    {"state",   "State",         0},
+    {"cmd",     "Cmd",           0},
+    {"mem",     "Mem%",          0},
+    {"cpu",     "CPU%",          0},
+    {"io_r",    "IO R (KB/s)",   FIELD_IO},
+    {"io_w",    "IO W (KB/s)",   FIELD_IO},
+    {"rchar",   "RChar (KB)",    FIELD_IO},
+    {"wchar",   "WChar (KB)",    FIELD_IO},
+    {"shared",  "Shared (KB)",   FIELD_SMAPS},
+    {"private", "Private (KB)",  FIELD_SMAPS},
+    {"fd",      "FD",            FIELD_FD},
+    {"threads", "Threads",       0},
+    {"ctxsw",   "CtxtSw",        FIELD_STATUS},
+    {"age",     "Age (h)",       0},
+    {"prio",    "Priority",      0},
+    {"nice",    "Nice",          0},
+    {"cpus",    "CPUs",          FIELD_STATUS},
+    {"net_rx",  "Net R (KB/s)",  FIELD_NET},
+    {"net_tx",  "Net W (KB/s)",  FIELD_NET},
+    {"lastcpu", "Last CPU",      0},
+};
+
+const std::vector<int>& allColumns()
 {
-    if (!log_file.is_open())
-    {
-        log_file.open("process_log.csv", std::ios::app);
-        if (!log_file)
-        {
-            status_msg = "Error: Cannot open process_log.csv";
-            return;
+    static std::vector<int> all;
+    if (all.empty())
+        for (int c = 0; c < L_COLUMN_COUNT; c++) all.push_back(c);
+    return all;
+}
+
+}
+
+bool parseColumns(const std::string& list, std::vector<int>& columns)
+{
+    columns.clear();
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (name.empty()) continue;
+        if (name == "all") { columns = allColumns(); continue; }
+        int c = 0;
+        while (c < L_COLUMN_COUNT && name != COLUMNS[c].name) c++;
+        if (c == L_COLUMN_COUNT) return false;
+        columns.push_back(c);
+    }
+    return !columns.empty();
+}
+
+const char* columnList()
+{
+    return "time pid ppid state cmd mem cpu io_r io_w rchar wchar shared private fd threads ctxsw age prio nice cpus net_rx net_tx lastcpu";
+}
+
+unsigned fieldsFor(const std::vector<int>& columns)
+{
+    unsigned fields = 0;
+    for (int c : columns.empty() ? allColumns() : columns) fields |= COLUMNS[c].field;
+    return fields;
+}
+
+void formatHeader(std::string& out, const std::vector<int>& columns)
+{
+    const std::vector<int>& cols = columns.empty() ? allColumns() : columns;
+    for (size_t i = 0; i < cols.size(); i++) {
+        if (i) out += ',';
+        appendCsv(out, COLUMNS[cols[i]].title, strlen(COLUMNS[cols[i]].title));
+    }
+    out += '\n';
+}
+
+void formatRows(std::string& out, const ProcessTable& t, const std::vector<uint32_t>& rows,
+                const std::vector<int>& columns, unsigned fields, time_t now)
+{
+    const std::vector<int>& cols = columns.empty() ? allColumns() : columns;
+    char ts[32];
+    struct tm tm;
+    localtime_r(&now, &tm);
+    size_t ts_len = strftime(ts, sizeof(ts), "%a %b %e %H:%M:%S %Y", &tm);
+
+    for (uint32_t r : rows) {
+        for (size_t i = 0; i < cols.size(); i++) {
+            if (i) out += ',';
+            int c = cols[i];
+            if (COLUMNS[c].field && !(fields & COLUMNS[c].field)) continue;
+            switch (c) {
+            case L_TIME:    out.append(ts, ts_len); break;
+            case L_PID:     appendInt(out, t.pid[r]); break;
+            case L_PPID:    appendInt(out, t.ppid[r]); break;
+            case L_STATE:   out += t.state[r]; break;
+            case L_CMD:     appendCsv(out, t.strings.str(t.cmd[r]), t.strings.length(t.cmd[r])); break;
+            case L_MEM:     appendFixed(out, t.mem_usage[r]); break;
+            case L_CPU:     appendFixed(out, t.cpu_usage[r]); break;
+            case L_IO_R:    appendFixed(out, t.io_read_rate[r]); break;
+            case L_IO_W:    appendFixed(out, t.io_write_rate[r]); break;
+            case L_RCHAR:   appendUint(out, t.rchar[r] / 1024); break;
+            case L_WCHAR:   appendUint(out, t.wchar[r] / 1024); break;
+            case L_SHARED:  appendUint(out, t.shared_clean[r]); break;
+            case L_PRIVATE: appendUint(out, t.private_dirty[r]); break;
+            case L_FD:      appendUint(out, t.fd_count[r]); break;
+            case L_THREADS: appendInt(out, t.num_threads[r]); break;
+            case L_CTXSW:   appendUint(out, t.voluntary_ctxt_switches[r]); break;
+            case L_AGE:     appendFixed(out, t.process_age[r], 4); break;
+            case L_PRIO:    appendInt(out, t.priority[r]); break;
+            case L_NICE:    appendInt(out, t.nice[r]); break;
+            case L_CPUS:
+                appendCsv(out, t.strings.str(t.cpus_allowed_list[r]), t.strings.length(t.cpus_allowed_list[r]));
+                break;
+            case L_NET_RX:  appendFixed(out, t.net_rx_rate[r]); break;
+            case L_NET_TX:  appendFixed(out, t.net_tx_rate[r]); break;
+            case L_LASTCPU: appendInt(out, t.processor[r]); break;
+            }
         }
-        log_file << "Timestamp,PID,PPID,State,Cmd,Mem%,CPU%,IO R (KB/s),IO W (KB/s),RChar (KB),WChar (KB),Shared (KB),Private (KB),FD,Threads,CtxtSw,Age (h),Priority,Nice,CPUs,Net R (KB/s),Net W (KB/s)\n";
+        out += '\n';
+    }
+}
+
+Logger::Logger(const Config& config) : cfg(config)
+{
+    if (cfg.keep < 1) cfg.keep = 1;
+    writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
     }
-    if (log_file)
+    cv.notify_one();
+    writer.join();
+    if (fd >= 0) close(fd);
+}
+
+void Logger::log(const ProcessTable& table, const std::vector<uint32_t>& rows, unsigned fields)
+{
+    std::string buf;
     {
-        time_t now = time(nullptr);
-        std::string ts = ctime(&now);
-        ts.erase(std::remove(ts.begin(), ts.end(), '\n'), ts.end());
-        for (const auto &proc : processes)
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.size() >= MAX_QUEUED) { dropped++; return; }
+        if (!spare.empty()) { buf.swap(spare.front()); spare.pop_front(); }
+    }
+    buf.clear();
+    formatRows(buf, table, rows, cfg.columns, fields, time(NULL));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(std::string());
+        queue.back().swap(buf);
+    }
+    cv.notify_one();
+}
+
+std::string Logger::status()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::string s = error;
+    if (dropped) s += (s.empty() ? "" : "; ") + std::to_string(dropped) + " log ticks dropped";
+    return s;
+}
+
+// Appends to an existing log; the header goes only into a new or empty file.
+bool Logger::openFile(std::string& err)
+{
+    fd = open(cfg.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        err = "Cannot open " + cfg.path + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return false;
+    }
+    file_bytes = (size_t)st.st_size;
+    has_rows = file_bytes > 0;
+    opened = time(NULL);
+    if (!file_bytes) {
+        std::string header;
+        formatHeader(header, cfg.columns);
+        if (write(fd, header.data(), header.size()) == (ssize_t)header.size()) file_bytes = header.size();
+    }
+    return true;
+}
+
+// path -> path.1 -> ... -> path.<keep>, dropping the oldest. Rotated files are gzipped in place
+// when asked for, so the numbered names carry a .gz suffix. gzip runs in the background; the
+// previous one must have finished before its output is renamed.
+void Logger::rotate(std::string& err)
+{
+    reapGzip(true, err);
+    close(fd);
+    fd = -1;
+    const char* suffix = cfg.compress ? ".gz" : "";
+    std::string oldest = cfg.path + "." + std::to_string(cfg.keep) + suffix;
+    unlink(oldest.c_str());
+    for (int i = cfg.keep - 1; i >= 1; i--) {
+        std::string from = cfg.path + "." + std::to_string(i) + suffix;
+        std::string to = cfg.path + "." + std::to_string(i + 1) + suffix;
+        rename(from.c_str(), to.c_str());
+    }
+    std::string first = cfg.path + ".1";
+    if (rename(cfg.path.c_str(), first.c_str()) < 0) {
+        err = "Cannot rotate " + cfg.path + ": " + strerror(errno);
+        return;
+    }
+    rotated = time(NULL);
+    if (cfg.compress) {
+        char arg0[] = "gzip", arg1[] = "-f";
+        char* argv[] = {arg0, arg1, &first[0], NULL};
+        if (posix_spawnp(&gzip_pid, "gzip", NULL, NULL, argv, environ) != 0) {
+            gzip_pid = -1;
+            keepUncompressed(err);
+        }
+    }
+}
+
+// Collects the gzip started by the last rotation, waiting for it only when block is set.
+void Logger::reapGzip(bool block, std::string& err)
+{
+    if (gzip_pid < 0) return;
+    int status = 0;
+    pid_t r = waitpid(gzip_pid, &status, block ? 0 : WNOHANG);
+    if (r == 0) return;
+    gzip_pid = -1;
+    if (r < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) keepUncompressed(err);
+}
+
+// The numbered chain only holds .gz files, so a rotated file gzip could not compress moves to a
+// name of its own, path.<rotation time>[-n], where the next rotation will not overwrite it.
+void Logger::keepUncompressed(std::string& err)
+{
+    std::string first = cfg.path + ".1";
+    std::string aside = cfg.path + "." + std::to_string((long long)rotated);
+    for (int n = 1; access(aside.c_str(), F_OK) == 0; n++)
+        aside = cfg.path + "." + std::to_string((long long)rotated) + "-" + std::to_string(n);
+    if (rename(first.c_str(), aside.c_str()) == 0) err = "gzip failed, kept " + aside;
+    else err = "gzip failed on " + first + ": " + strerror(errno);
+}
+
+void Logger::writerLoop()
+{
+    std::string buf, err;
+    if (!openFile(err)) {
+        std::lock_guard<std::mutex> lock(mtx);
+        error = err;
+    }
+    for (;;) {
+        reapGzip(false, err);
         {
-            log_file << ts << "," << proc.pid << "," << proc.ppid << "," << proc.state << "," << proc.cmd << "," << proc.mem_usage << "," << proc.cpu_usage << "," << proc.io_read_rate << "," << proc.io_write_rate << "," << proc.rchar / 1024 << "," << proc.wchar / 1024 << "," << proc.shared_clean << "," << proc.private_dirty << "," << proc.fd_count << "," << proc.num_threads << "," << proc.voluntary_ctxt_switches << "," << proc.process_age << "," << proc.priority << "," << proc.nice << "," << proc.cpus_allowed_list << "," << proc.net_rx_rate << "," << proc.net_tx_rate << "\n";
+            std::unique_lock<std::mutex> lock(mtx);
+            if (buf.capacity()) { spare.push_back(std::string()); spare.back().swap(buf); }
+            if (!err.empty()) { error = err; err.clear(); }
+            auto ready = [this] { return stopping || !queue.empty(); };
+            // A running gzip is polled about once a second even when no ticks arrive.
+            if (gzip_pid >= 0) cv.wait_for(lock, std::chrono::seconds(1), ready);
+            else cv.wait(lock, ready);
+            if (queue.empty()) {
+                if (!stopping) continue;
+                lock.unlock();
+                reapGzip(true, err);
+                return;
+            }
+            buf.swap(queue.front());
+            queue.pop_front();
+        }
+
+        if (fd >= 0 && has_rows &&
+            ((cfg.rotate_bytes && file_bytes + buf.size() > cfg.rotate_bytes) ||
+             (cfg.rotate_secs && time(NULL) - opened >= cfg.rotate_secs))) {
+            rotate(err);
+        }
+        if (fd < 0 && !openFile(err)) continue;
+        const char* p = buf.data();
+        size_t left = buf.size();
+        while (left) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) { err = "Write to " + cfg.path + " failed: " + strerror(errno); break; }
+            p += n;
+            left -= (size_t)n;
         }
-        log_file.flush();
+        file_bytes += buf.size() - left;
+        has_rows = true;
     }
 }
 
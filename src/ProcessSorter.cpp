@@ -1,42 +1,271 @@
 #include "ProcessSorter.h"
 #include <algorithm>
+#include <cstring>
 
 namespace ProcessSorter {
 
-void sortProcesses(std::vector<ProcessInfo>& processes, const std::string& criterion)
+namespace {
+
+enum KeyId {
+    K_CPU, K_MEM, K_IO, K_NET, K_RSS, K_THREADS, K_FD, K_AGE, K_CTXSW, K_SHARED, K_PRIVATE,
+    K_UTIME, K_STIME, K_PRIO, K_NICE, K_LASTCPU, K_XNODE, K_PID, K_PPID, K_CMD, K_COUNT
+};
+
+struct KeyDef {
+    const char* name;
+    KeyId id;
+    bool ascending;
+    unsigned fields;
+};
+
+// In F6 cycle order.
+const KeyDef KEYS[] = {
+    {"cpu", K_CPU, false, 0},              {"mem", K_MEM, false, 0},
+    {"io", K_IO, false, FIELD_IO},         {"net", K_NET, false, FIELD_NET},
+    {"rss", K_RSS, false, 0},              {"threads", K_THREADS, false, 0},
+    {"fd", K_FD, false, FIELD_FD},         {"age", K_AGE, false, 0},
+    {"ctxsw", K_CTXSW, false, FIELD_STATUS}, {"shared", K_SHARED, false, FIELD_SMAPS},
+    {"private", K_PRIVATE, false, FIELD_SMAPS}, {"utime", K_UTIME, false, 0},
+    {"stime", K_STIME, false, 0},          {"prio", K_PRIO, true, 0},
+    {"nice", K_NICE, true, 0},             {"lastcpu", K_LASTCPU, true, 0},
+    {"xnode", K_XNODE, false, 0},          {"pid", K_PID, true, 0},
+    {"ppid", K_PPID, true, 0},             {"cmd", K_CMD, true, 0},
+};
+const size_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+
+// The group list's member count, cycled after cmd only there. A process is a group of one, so
+// outside it the key leaves rows in PID order.
+const KeyDef COUNT_KEY = {"count", K_COUNT, false, 0};
+
+const KeyDef* findKey(const std::string& name)
 {
-    if (criterion == "cpu")
+    if (name.empty()) return findKey("pid");
+    for (size_t i = 0; i < KEY_COUNT; i++)
+        if (name == KEYS[i].name) return &KEYS[i];
+    if (name == COUNT_KEY.name) return &COUNT_KEY;
+    return NULL;
+}
+
+// Keys are computed once per row and signed so that every criterion sorts ascending, which
+// keeps the comparator a branch-light two-field compare.
+struct Entry {
+    double key;
+    pid_t pid;
+    uint32_t row;
+};
+
+inline bool operator<(const Entry& a, const Entry& b)
+{
+    return a.key < b.key || (a.key == b.key && a.pid < b.pid);
+}
+
+struct Gather {
+    const std::vector<uint32_t>& rows;
+    std::vector<Entry>& out;
+    double sign;
+
+    template <class T> void operator()(const std::vector<T>& col) const
     {
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            if (std::abs(a.cpu_usage - b.cpu_usage) < 0.001) return a.pid < b.pid;
-            return a.cpu_usage > b.cpu_usage;
-        });
+        for (size_t i = 0; i < rows.size(); i++) out[i].key = sign * (double)col[rows[i]];
     }
-    else if (criterion == "mem")
-    {
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            if (std::abs(a.mem_usage - b.mem_usage) < 0.001) return a.pid < b.pid;
-            return a.mem_usage > b.mem_usage;
-        });
+};
+
+// Ranks the distinct strings once, so each row sorts by its string's rank.
+void rankStrings(const StringPool& strings, std::vector<uint32_t>& rank)
+{
+    std::vector<uint32_t> ids(strings.size());
+    for (uint32_t id = 0; id < ids.size(); id++) ids[id] = id;
+    std::sort(ids.begin(), ids.end(), [&strings](uint32_t a, uint32_t b) {
+        return strcmp(strings.lower(a), strings.lower(b)) < 0;
+    });
+    rank.resize(ids.size());
+    for (uint32_t i = 0; i < ids.size(); i++) rank[ids[i]] = i;
+}
+
+void gatherKeys(const ProcessTable& t, const std::vector<uint32_t>* counts, KeyId id, const std::vector<uint32_t>& rows,
+                double sign, std::vector<Entry>& out)
+{
+    Gather g = {rows, out, sign};
+    switch (id) {
+    case K_COUNT:
+        if (counts) g(*counts);
+        else for (size_t i = 0; i < rows.size(); i++) out[i].key = 0;
+        break;
+    case K_CPU:     g(t.cpu_usage); break;
+    case K_MEM:     g(t.mem_usage); break;
+    case K_RSS:     g(t.rss); break;
+    case K_THREADS: g(t.num_threads); break;
+    case K_FD:      g(t.fd_count); break;
+    case K_AGE:     g(t.process_age); break;
+    case K_CTXSW:   g(t.voluntary_ctxt_switches); break;
+    case K_SHARED:  g(t.shared_clean); break;
+    case K_PRIVATE: g(t.private_dirty); break;
+    case K_UTIME:   g(t.utime); break;
+    case K_STIME:   g(t.stime); break;
+    case K_PRIO:    g(t.priority); break;
+    case K_NICE:    g(t.nice); break;
+    case K_PID:     g(t.pid); break;
+    case K_PPID:    g(t.ppid); break;
+    case K_LASTCPU: g(t.processor); break;
+    case K_XNODE:
+        for (size_t i = 0; i < rows.size(); i++) {
+            uint32_t r = rows[i];
+            out[i].key = t.numa_kb[r] ? sign * (double)t.numa_remote_kb[r] / (double)t.numa_kb[r] : 0;
+        }
+        break;
+    case K_IO:
+        for (size_t i = 0; i < rows.size(); i++)
+            out[i].key = sign * (t.io_read_rate[rows[i]] + t.io_write_rate[rows[i]]);
+        break;
+    case K_NET:
+        for (size_t i = 0; i < rows.size(); i++)
+            out[i].key = sign * (t.net_rx_rate[rows[i]] + t.net_tx_rate[rows[i]]);
+        break;
+    case K_CMD: {
+        std::vector<uint32_t> rank;
+        rankStrings(t.strings, rank);
+        for (size_t i = 0; i < rows.size(); i++) out[i].key = sign * rank[t.cmd[rows[i]]];
+        break;
     }
-    else if (criterion == "io")
-    {
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            double a_io = a.io_read_rate + a.io_write_rate;
-            double b_io = b.io_read_rate + b.io_write_rate;
-            if (std::abs(a_io - b_io) < 0.001) return a.pid < b.pid;
-            return a_io > b_io;
-        });
-    }
-    else if (criterion == "net")
-    {
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            double a_net = a.net_rx_rate + a.net_tx_rate;
-            double b_net = b.net_rx_rate + b.net_tx_rate;
-            if (std::abs(a_net - b_net) < 0.001) return a.pid < b.pid;
-            return a_net > b_net;
-        });
     }
 }
 
+void sortRows(const ProcessTable& t, const std::vector<uint32_t>* counts, std::vector<uint32_t>& rows,
+              const std::string& criterion, bool inverted, size_t top)
+{
+    const KeyDef* def = findKey(criterion);
+    if (!def || rows.empty()) return;
+    double sign = def->ascending != inverted ? 1.0 : -1.0;
+
+    std::vector<Entry> entries(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        entries[i].pid = t.pid[rows[i]];
+        entries[i].row = rows[i];
+    }
+    gatherKeys(t, counts, def->id, rows, sign, entries);
+
+    if (top > 0 && top < entries.size())
+        std::partial_sort(entries.begin(), entries.begin() + top, entries.end());
+    else
+        std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size(); i++) rows[i] = entries[i].row;
+}
+
+}
+
+void sortProcesses(const ProcessTable& t, std::vector<uint32_t>& rows, const std::string& criterion, bool inverted, size_t top)
+{
+    sortRows(t, NULL, rows, criterion, inverted, top);
+}
+
+void sortGroups(const GroupBy::Groups& groups, std::vector<uint32_t>& rows, const std::string& criterion, bool inverted)
+{
+    sortRows(groups.table, &groups.count, rows, criterion, inverted, 0);
+}
+
+// Thread rows have no memory, I/O or fd columns; those keys fall back to CPU. pid and ppid mean
+// TID and owning PID, and ctxsw is the switch rate.
+void sortThreads(const ThreadTable& t, std::vector<uint32_t>& rows, const std::string& criterion, bool inverted)
+{
+    const KeyDef* def = findKey(criterion);
+    if (!def || rows.empty()) return;
+    KeyId id = def->id;
+    if (id != K_CTXSW && id != K_UTIME && id != K_STIME && id != K_PRIO && id != K_NICE &&
+        id != K_LASTCPU && id != K_PID && id != K_PPID && id != K_CMD) {
+        def = findKey("cpu");
+        id = K_CPU;
+    }
+    double sign = def->ascending != inverted ? 1.0 : -1.0;
+
+    std::vector<Entry> entries(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        entries[i].pid = t.tid[rows[i]];
+        entries[i].row = rows[i];
+    }
+    Gather g = {rows, entries, sign};
+    switch (id) {
+    case K_CTXSW: g(t.ctxsw_rate); break;
+    case K_UTIME: g(t.utime); break;
+    case K_STIME: g(t.stime); break;
+    case K_PRIO:  g(t.priority); break;
+    case K_NICE:  g(t.nice); break;
+    case K_LASTCPU: g(t.processor); break;
+    case K_PID:   g(t.tid); break;
+    case K_PPID:  g(t.tgid); break;
+    case K_CMD: {
+        std::vector<uint32_t> rank;
+        rankStrings(t.names, rank);
+        for (size_t i = 0; i < rows.size(); i++) entries[i].key = sign * rank[t.name[rows[i]]];
+        break;
+    }
+    default:      g(t.cpu_usage); break;
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size(); i++) rows[i] = entries[i].row;
+}
+
+// cmd sorts by path, threads by thread count, and pid, ppid and count by process count; mem and io prefer the
+// cgroup's own memory.current and io.stat. Keys with no cgroup meaning fall back to CPU.
+void sortCgroups(const std::vector<SystemUtils::CgroupStats>& groups, const StringPool& strings,
+                 std::vector<uint32_t>& rows, const std::string& criterion, bool inverted)
+{
+    const KeyDef* def = findKey(criterion);
+    if (!def || rows.empty()) return;
+    KeyId id = def->id;
+    if (id != K_MEM && id != K_RSS && id != K_IO && id != K_NET && id != K_THREADS && id != K_PID &&
+        id != K_PPID && id != K_CMD && id != K_COUNT) {
+        def = findKey("cpu");
+        id = K_CPU;
+    }
+    double sign = def->ascending != inverted ? 1.0 : -1.0;
+
+    std::vector<uint32_t> rank;
+    if (id == K_CMD) rankStrings(strings, rank);
+    std::vector<Entry> entries(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        const SystemUtils::CgroupStats& g = groups[rows[i]];
+        double key;
+        switch (id) {
+        case K_MEM:     key = g.have & SystemUtils::CG_MEM ? (double)g.mem_current / 1024.0 : (double)g.rss; break;
+        case K_RSS:     key = (double)g.rss; break;
+        case K_IO:      key = g.have & SystemUtils::CG_IO ? g.cg_io_r + g.cg_io_w : g.io_r + g.io_w; break;
+        case K_NET:     key = g.net_rx + g.net_tx; break;
+        case K_THREADS: key = (double)g.threads; break;
+        case K_PID: case K_PPID: case K_COUNT: key = (double)g.procs; break;
+        case K_CMD:     key = rank[g.path]; break;
+        default:        key = g.cpu; break;
+        }
+        entries[i].key = sign * key;
+        entries[i].pid = (pid_t)g.path;
+        entries[i].row = rows[i];
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size(); i++) rows[i] = entries[i].row;
+}
+
+bool isKey(const std::string& criterion)
+{
+    const KeyDef* def = findKey(criterion);
+    return def && def != &COUNT_KEY;
+}
+
+const char* nextKey(const std::string& criterion, bool groups)
+{
+    const KeyDef* def = findKey(criterion);
+    if (!def || def == &COUNT_KEY) return KEYS[0].name;
+    if (groups && def == &KEYS[KEY_COUNT - 1]) return COUNT_KEY.name;
+    return KEYS[(def - KEYS + 1) % KEY_COUNT].name;
+}
+
+const char* keyList()
+{
+    return "cpu mem io net rss threads fd age ctxsw shared private utime stime prio nice lastcpu xnode pid ppid cmd";
+}
+
+unsigned fieldsFor(const std::string& criterion)
+{
+    const KeyDef* def = findKey(criterion);
+    return def ? def->fields : 0;
+}
+
 }
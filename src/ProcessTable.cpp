@@ -0,0 +1,275 @@
+#include "ProcessTable.h"
+#include "TextSearch.h"
+#include <algorithm>
+#include <cstring>
+
+static uint32_t hashBytes(const char* s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+void StringPool::clear()
+{
+    arena.clear();
+    folded.clear();
+    offsets.clear();
+    lengths.clear();
+    if (slots.empty()) slots.resize(256);
+    std::fill(slots.begin(), slots.end(), 0);
+    intern("", 0);
+}
+
+void StringPool::grow()
+{
+    std::vector<uint32_t> bigger(slots.size() * 2, 0);
+    size_t mask = bigger.size() - 1;
+    for (uint32_t id = 0; id < offsets.size(); id++) {
+        size_t i = hashBytes(&arena[offsets[id]], lengths[id]) & mask;
+        while (bigger[i]) i = (i + 1) & mask;
+        bigger[i] = id + 1;
+    }
+    slots.swap(bigger);
+}
+
+// Open addressing over the arena itself, so a lookup that hits allocates nothing.
+uint32_t StringPool::intern(const char* s, size_t len)
+{
+    if ((offsets.size() + 1) * 2 > slots.size()) grow();
+    size_t mask = slots.size() - 1;
+    size_t i = hashBytes(s, len) & mask;
+    while (uint32_t slot = slots[i]) {
+        uint32_t id = slot - 1;
+        if (lengths[id] == len && std::memcmp(&arena[offsets[id]], s, len) == 0) return id;
+        i = (i + 1) & mask;
+    }
+    uint32_t id = (uint32_t)offsets.size();
+    offsets.push_back((uint32_t)arena.size());
+    lengths.push_back((uint32_t)len);
+    arena.insert(arena.end(), s, s + len);
+    arena.push_back('\0');
+    folded.resize(arena.size());
+    TextSearch::lower(s, len, &folded[offsets.back()]);
+    slots[i] = id + 1;
+    return id;
+}
+
+void StringPool::containing(const std::string& needle, std::vector<uint8_t>& hit) const
+{
+    hit.assign(offsets.size(), needle.empty());
+    if (needle.empty()) return;
+    std::string low(needle);
+    TextSearch::lower(&low[0], low.size(), &low[0]);
+    const char* base = folded.data();
+    size_t n = folded.size(), pos = 0;
+    // The needle holds no NUL, so a match never straddles two strings.
+    while (const char* p = TextSearch::find(base + pos, n - pos, low.data(), low.size())) {
+        size_t id = std::upper_bound(offsets.begin(), offsets.end(), (uint32_t)(p - base)) - offsets.begin() - 1;
+        hit[id] = 1;
+        if (id + 1 >= offsets.size()) break;
+        pos = offsets[id + 1];
+    }
+}
+
+namespace {
+struct ClearColumn   { template <class T> void operator()(std::vector<T>& v) { v.clear(); } };
+struct ResizeColumn  { size_t n; template <class T> void operator()(std::vector<T>& v) { v.resize(n); } };
+struct ResetColumn   { size_t row; template <class T> void operator()(std::vector<T>& v) { v[row] = T(); } };
+struct CompactColumn {
+    const std::vector<char>* keep;
+    template <class T> void operator()(std::vector<T>& v)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < v.size(); i++)
+            if ((*keep)[i]) v[kept++] = v[i];
+        v.resize(kept);
+    }
+};
+struct ColumnBytes   { size_t total; template <class T> void operator()(std::vector<T>& v) { total += v.capacity() * sizeof(T); } };
+}
+
+void ProcessTable::clear()
+{
+    ClearColumn f;
+    forEachColumn(f);
+    roots.clear();
+    strings.clear();
+    tree.order.clear();
+    tree.glyphs.clear();
+}
+
+void ProcessTable::resize(size_t n)
+{
+    ResizeColumn f = {n};
+    forEachColumn(f);
+}
+
+void ProcessTable::resetRow(size_t row)
+{
+    ResetColumn f = {row};
+    forEachColumn(f);
+}
+
+void ProcessTable::compact(const std::vector<char>& keep)
+{
+    CompactColumn f = {&keep};
+    forEachColumn(f);
+}
+
+// Rows are in PID order, so parents are found by binary search. Walking backwards leaves every
+// child list in ascending PID order. Rows whose parent was not scanned become roots.
+void ProcessTable::linkTree()
+{
+    size_t n = size();
+    roots.clear();
+    for (size_t i = 0; i < n; i++) {
+        parent[i] = (ppid[i] > 0 && ppid[i] != pid[i]) ? find(ppid[i]) : -1;
+        first_child[i] = next_sibling[i] = -1;
+    }
+    for (size_t i = n; i-- > 0; ) {
+        int p = parent[i];
+        if (p < 0) continue;
+        next_sibling[i] = first_child[p];
+        first_child[p] = (int32_t)i;
+    }
+    for (size_t i = 0; i < n; i++)
+        if (parent[i] < 0) roots.push_back((int32_t)i);
+}
+
+// Iterative pre-order walk from the roots, then one reverse pass that adds every subtree into
+// its parent. Rows cut off from the roots (a ppid loop left by PID reuse) are appended as roots.
+void ProcessTable::indexTree()
+{
+    // Deeper levels reuse the glyphs of this depth; the indent is wider than any command by then.
+    const size_t MAX_GLYPH_DEPTH = 32;
+    size_t n = size();
+    TreeIndex& t = tree;
+    t.order.clear();
+    t.order.reserve(n);
+    t.position.assign(n, UINT32_MAX);
+    t.subtree_size.assign(n, 1);
+    t.depth.assign(n, 0);
+    t.prefix.assign(n, 0);
+    t.rollup.resize(n);
+    t.glyphs.clear();
+
+    // A node's indent is its parent's stem plus one glyph, and its own children's stem is the
+    // parent's stem plus a continuation. Both are memoised per (stem, has-later-sibling), so
+    // each distinct indent string is built and interned once.
+    std::vector<int32_t> stack;
+    std::vector<uint32_t> stem(n, 0);
+    std::vector<uint32_t> memo[2][2];   // [is_stem][more][parent stem id] -> glyph id + 1
+    auto extend = [&](uint32_t base, bool more, bool as_stem) -> uint32_t {
+        std::vector<uint32_t>& m = memo[as_stem][more];
+        if (m.size() <= base) m.resize(base + 1, 0);
+        if (!m[base]) {
+            std::string s(t.glyphs.str(base), t.glyphs.length(base));
+            s += as_stem ? (more ? " |  " : "    ") : (more ? " |- " : " `- ");
+            m[base] = t.glyphs.intern(s.data(), s.size()) + 1;
+        }
+        return m[base] - 1;
+    };
+    auto walk = [&](int32_t start) {
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int32_t r = stack.back();
+            stack.pop_back();
+            if (t.position[r] != UINT32_MAX) continue;
+            int p = parent[r];
+            size_t d = (p >= 0 && t.position[p] != UINT32_MAX) ? t.depth[p] + 1u : 0;
+            t.depth[r] = (uint16_t)std::min<size_t>(d, UINT16_MAX);
+            t.position[r] = (uint32_t)t.order.size();
+            t.order.push_back((uint32_t)r);
+
+            if (d > 0) {
+                bool more = next_sibling[r] >= 0;
+                t.prefix[r] = extend(stem[p], more, false);
+                stem[r] = d < MAX_GLYPH_DEPTH ? extend(stem[p], more, true) : stem[p];
+            }
+
+            size_t mark = stack.size();
+            for (int c = first_child[r]; c >= 0; c = next_sibling[c]) stack.push_back(c);
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+    };
+    for (int32_t root : roots) walk(root);
+    if (t.order.size() < n)
+        for (size_t r = 0; r < n; r++)
+            if (t.position[r] == UINT32_MAX) walk((int32_t)r);
+
+    for (size_t r = 0; r < n; r++) {
+        Rollup& u = t.rollup[r];
+        u.cpu = cpu_usage[r]; u.mem = mem_usage[r];
+        u.io_r = io_read_rate[r]; u.io_w = io_write_rate[r];
+        u.net_rx = net_rx_rate[r]; u.net_tx = net_tx_rate[r];
+    }
+    for (size_t k = t.order.size(); k-- > 0; ) {
+        uint32_t r = t.order[k];
+        int p = parent[r];
+        if (p < 0 || t.position[p] >= k) continue;
+        t.subtree_size[p] += t.subtree_size[r];
+        Rollup& up = t.rollup[p];
+        const Rollup& u = t.rollup[r];
+        up.cpu += u.cpu; up.mem += u.mem;
+        up.io_r += u.io_r; up.io_w += u.io_w;
+        up.net_rx += u.net_rx; up.net_tx += u.net_tx;
+    }
+}
+
+int ProcessTable::find(pid_t p) const
+{
+    auto it = std::lower_bound(pid.begin(), pid.end(), p);
+    if (it == pid.end() || *it != p) return -1;
+    return (int)(it - pid.begin());
+}
+
+ProcessInfo ProcessTable::row(size_t i) const
+{
+    ProcessInfo p = ProcessInfo();
+    p.pid = pid[i]; p.ppid = ppid[i]; p.state = state[i];
+    p.cmd = strings.str(cmd[i]);
+    p.cpus_allowed_list = strings.str(cpus_allowed_list[i]);
+    p.cgroup = strings.str(cgroup[i]);
+    p.rss = rss[i]; p.num_threads = num_threads[i]; p.priority = priority[i]; p.nice = nice[i];
+    p.mem_usage = mem_usage[i]; p.cpu_usage = cpu_usage[i];
+    p.io_read_rate = io_read_rate[i]; p.io_write_rate = io_write_rate[i];
+    p.process_age = process_age[i]; p.net_rx_rate = net_rx_rate[i]; p.net_tx_rate = net_tx_rate[i];
+    p.utime = utime[i]; p.stime = stime[i]; p.starttime = starttime[i];
+    p.read_bytes = read_bytes[i]; p.write_bytes = write_bytes[i]; p.rchar = rchar[i]; p.wchar = wchar[i];
+    p.voluntary_ctxt_switches = voluntary_ctxt_switches[i];
+    p.shared_clean = shared_clean[i]; p.private_dirty = private_dirty[i]; p.fd_count = fd_count[i];
+    p.net_rx_bytes = net_rx_bytes[i]; p.net_tx_bytes = net_tx_bytes[i];
+    p.sampled_fields = sampled_fields[i]; p.io_tick = io_tick[i]; p.net_tick = net_tick[i];
+    p.processor = processor[i]; p.numa_kb = numa_kb[i]; p.numa_remote_kb = numa_remote_kb[i];
+    p.uid = uid[i];
+    return p;
+}
+
+size_t ProcessTable::bytes() const
+{
+    ColumnBytes f = {0};
+    const_cast<ProcessTable*>(this)->forEachColumn(f);
+    return f.total + roots.capacity() * sizeof(int32_t) + strings.bytes() + tree.glyphs.bytes() +
+           (tree.order.capacity() + tree.position.capacity() + tree.subtree_size.capacity() + tree.prefix.capacity()) * sizeof(uint32_t) +
+           tree.depth.capacity() * sizeof(uint16_t) + tree.rollup.capacity() * sizeof(Rollup);
+}
+
+void ThreadTable::clear()
+{
+    ClearColumn f;
+    forEachColumn(f);
+    names.clear();
+}
+
+void ThreadTable::resize(size_t n)
+{
+    ResizeColumn f = {n};
+    forEachColumn(f);
+}
+
+void ThreadTable::compact(const std::vector<char>& keep)
+{
+    CompactColumn f = {&keep};
+    forEachColumn(f);
+}
@@ -0,0 +1,86 @@
+#include "ScanPool.h"
+#include <system_error>
+
+ScanPool::ScanPool(int threads)
+{
+    if (threads < 1) threads = 1;
+    ranges.reset(new Range[threads]);
+    for (int i = 0; i < threads; i++) { ranges[i].next = 0; ranges[i].end = 0; }
+    for (int i = 1; i < threads; i++) {
+        try {
+            workers.push_back(std::thread(&ScanPool::workerLoop, this, i));
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+}
+
+ScanPool::~ScanPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv_start.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void ScanPool::drain(int id)
+{
+    int n = size();
+    for (int k = 0; k < n; k++) {
+        Range& r = ranges[(id + k) % n];
+        for (;;) {
+            size_t i = r.next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= r.end) break;
+            (*job)(i);
+        }
+    }
+}
+
+void ScanPool::workerLoop(int id)
+{
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_start.wait(lock, [&] { return stopping || epoch != seen; });
+            if (stopping) return;
+            seen = epoch;
+        }
+        drain(id);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--pending == 0) cv_done.notify_one();
+        }
+    }
+}
+
+void ScanPool::parallelFor(size_t n, const std::function<void(size_t)>& fn)
+{
+    int nw = size();
+    if (nw == 1 || n < (size_t)nw * 4) {
+        for (size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+
+    size_t chunk = n / nw, extra = n % nw, begin = 0;
+    for (int w = 0; w < nw; w++) {
+        size_t len = chunk + ((size_t)w < extra ? 1 : 0);
+        ranges[w].next.store(begin, std::memory_order_relaxed);
+        ranges[w].end = begin + len;
+        begin += len;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        pending = nw - 1;
+        epoch++;
+    }
+    cv_start.notify_all();
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [&] { return pending == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,31 @@
+#include "SelfStats.h"
+#include <algorithm>
+#include <cmath>
+
+void RollingStat::add(double ms)
+{
+    if (ring.empty()) return;
+    ring[next] = ms;
+    next = (next + 1) % ring.size();
+    if (count < ring.size()) count++;
+}
+
+PhaseCost RollingStat::cost() const
+{
+    PhaseCost c = {0, 0, count};
+    if (!count) return c;
+    std::vector<double> v(ring.begin(), ring.begin() + count);
+    size_t i50 = (count - 1) / 2;
+    size_t i99 = (size_t)std::ceil(0.99 * count) - 1;
+    std::nth_element(v.begin(), v.begin() + i50, v.end());
+    c.p50_ms = v[i50];
+    std::nth_element(v.begin(), v.begin() + i99, v.end());
+    c.p99_ms = v[i99];
+    return c;
+}
+
+const char* UiCosts::name(int phase)
+{
+    static const char* names[UI_PHASE_COUNT] = { "zombie", "filter", "sort", "group", "log", "render" };
+    return phase >= 0 && phase < UI_PHASE_COUNT ? names[phase] : "?";
+}
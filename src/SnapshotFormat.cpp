@@ -0,0 +1,230 @@
+#include "SnapshotFormat.h"
+#include "Snapshot.h"
+
+namespace SnapshotFormat {
+
+namespace {
+
+size_t align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// The column set, tied to the ProcessTable member each one is stored from. The name is the
+// contract with readers; new columns go at the end.
+struct ColumnSpec {
+    const char* name;
+    ColumnType type;
+    size_t width;
+};
+
+const ColumnSpec COLUMNS[] = {
+    {"pid", COL_I32, 4}, {"ppid", COL_I32, 4}, {"state", COL_U8, 1}, {"cmd", COL_STR, 4},
+    {"cpus_allowed", COL_STR, 4}, {"rss", COL_I64, 8}, {"threads", COL_I64, 8},
+    {"priority", COL_I64, 8}, {"nice", COL_I64, 8}, {"mem", COL_F64, 8}, {"cpu", COL_F64, 8},
+    {"io_r", COL_F64, 8}, {"io_w", COL_F64, 8}, {"age", COL_F64, 8}, {"net_rx", COL_F64, 8},
+    {"net_tx", COL_F64, 8}, {"utime", COL_U64, 8}, {"stime", COL_U64, 8}, {"starttime", COL_U64, 8},
+    {"read_bytes", COL_U64, 8}, {"write_bytes", COL_U64, 8}, {"rchar", COL_U64, 8},
+    {"wchar", COL_U64, 8}, {"ctxsw", COL_U64, 8}, {"shared_clean", COL_U64, 8},
+    {"private_dirty", COL_U64, 8}, {"fd", COL_U64, 8}, {"net_rx_bytes", COL_U64, 8},
+    {"net_tx_bytes", COL_U64, 8}, {"sampled_fields", COL_U32, 4}, {"last_cpu", COL_I32, 4},
+    {"uid", COL_I32, 4},
+};
+const size_t COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+// Element-wise, since the in-memory types (long, pid_t, unsigned long) are not fixed-width.
+template<typename To, typename From>
+void store(char* dst, const std::vector<From>& src)
+{
+    for (size_t i = 0; i < src.size(); i++) {
+        To v = (To)src[i];
+        memcpy(dst + i * sizeof(To), &v, sizeof(To));
+    }
+}
+
+template<typename From, typename To>
+bool load(const Reader& in, const char* name, ColumnType type, std::vector<To>& dst)
+{
+    const From* src = in.column<From>(name, type);
+    if (!src) return false;
+    for (size_t i = 0; i < dst.size(); i++) dst[i] = (To)src[i];
+    return true;
+}
+
+// Column pointers into out, looked up by name so the writer cannot drift from COLUMNS.
+struct Cells {
+    std::string& out;
+    size_t record;
+    const Column* dir;
+    char* at(const char* name)
+    {
+        for (size_t i = 0; i < COLUMN_COUNT; i++)
+            if (!strcmp(dir[i].name, name)) return &out[record + dir[i].offset];
+        return NULL;
+    }
+};
+
+}
+
+void write(const Snapshot& snap, uint64_t time_ms, std::string& out)
+{
+    const ProcessTable& t = snap.table;
+    size_t rows = t.size();
+
+    // Layout: header, column directory, columns, strings.
+    size_t columns_offset = align8(sizeof(Header));
+    size_t offset = align8(columns_offset + COLUMN_COUNT * sizeof(Column));
+    Column dir[COLUMN_COUNT];
+    memset(dir, 0, sizeof(dir));
+    for (size_t i = 0; i < COLUMN_COUNT; i++) {
+        strncpy(dir[i].name, COLUMNS[i].name, sizeof(dir[i].name) - 1);
+        dir[i].type = COLUMNS[i].type;
+        dir[i].width = (uint32_t)COLUMNS[i].width;
+        dir[i].offset = offset;
+        offset = align8(offset + COLUMNS[i].width * rows);
+    }
+    // The pool's arena already is a table of NUL-terminated strings.
+    size_t strings_offset = offset;
+    size_t strings_bytes = t.strings.dataBytes();
+    size_t total = align8(strings_offset + strings_bytes);
+
+    size_t record = out.size();
+    out.resize(record + total, '\0');
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.byte_order = BYTE_ORDER_MARK;
+    h.total_bytes = total;
+    h.sequence = snap.sequence;
+    h.time_ms = time_ms;
+    h.rows = (uint32_t)rows;
+    h.column_count = (uint32_t)COLUMN_COUNT;
+    h.columns_offset = columns_offset;
+    h.strings_offset = strings_offset;
+    h.strings_bytes = strings_bytes;
+    const SystemStats& sys = snap.system;
+    h.cpu_usage = sys.cpu_usage;
+    h.mem_usage = sys.mem_usage;
+    h.uptime = sys.uptime;
+    h.mem_total = sys.mem_total;
+    h.mem_free = sys.mem_free;
+    h.num_cores = sys.num_cores;
+    h.event_driven = snap.event_driven;
+    const SystemUtils::CPULoadBreakdown& c = snap.cpu_breakdown;
+    h.cpu_user = c.user; h.cpu_nice = c.nice; h.cpu_sys = c.sys; h.cpu_idle = c.idle; h.cpu_iowait = c.iowait;
+    h.cpu_irq = c.irq; h.cpu_softirq = c.softirq; h.cpu_steal = c.steal; h.cpu_total = c.total;
+    const SystemUtils::MemBreakdown& m = snap.mem_breakdown;
+    h.mem_bd_total = m.total; h.mem_bd_free = m.free; h.mem_buffers = m.buffers; h.mem_cached = m.cached;
+    h.mem_s_reclaimable = m.s_reclaimable; h.mem_used = m.shorthand_used;
+    memcpy(&out[record], &h, sizeof(h));
+    memcpy(&out[record + columns_offset], dir, sizeof(dir));
+
+    Cells cells = {out, record, dir};
+    store<int32_t>(cells.at("pid"), t.pid);
+    store<int32_t>(cells.at("ppid"), t.ppid);
+    store<uint8_t>(cells.at("state"), t.state);
+    std::vector<uint32_t> str_offsets(rows);
+    for (size_t r = 0; r < rows; r++) str_offsets[r] = t.strings.offset(t.cmd[r]);
+    store<uint32_t>(cells.at("cmd"), str_offsets);
+    for (size_t r = 0; r < rows; r++) str_offsets[r] = t.strings.offset(t.cpus_allowed_list[r]);
+    store<uint32_t>(cells.at("cpus_allowed"), str_offsets);
+    store<int64_t>(cells.at("rss"), t.rss);
+    store<int64_t>(cells.at("threads"), t.num_threads);
+    store<int64_t>(cells.at("priority"), t.priority);
+    store<int64_t>(cells.at("nice"), t.nice);
+    store<double>(cells.at("mem"), t.mem_usage);
+    store<double>(cells.at("cpu"), t.cpu_usage);
+    store<double>(cells.at("io_r"), t.io_read_rate);
+    store<double>(cells.at("io_w"), t.io_write_rate);
+    store<double>(cells.at("age"), t.process_age);
+    store<double>(cells.at("net_rx"), t.net_rx_rate);
+    store<double>(cells.at("net_tx"), t.net_tx_rate);
+    store<uint64_t>(cells.at("utime"), t.utime);
+    store<uint64_t>(cells.at("stime"), t.stime);
+    store<uint64_t>(cells.at("starttime"), t.starttime);
+    store<uint64_t>(cells.at("read_bytes"), t.read_bytes);
+    store<uint64_t>(cells.at("write_bytes"), t.write_bytes);
+    store<uint64_t>(cells.at("rchar"), t.rchar);
+    store<uint64_t>(cells.at("wchar"), t.wchar);
+    store<uint64_t>(cells.at("ctxsw"), t.voluntary_ctxt_switches);
+    store<uint64_t>(cells.at("shared_clean"), t.shared_clean);
+    store<uint64_t>(cells.at("private_dirty"), t.private_dirty);
+    store<uint64_t>(cells.at("fd"), t.fd_count);
+    store<uint64_t>(cells.at("net_rx_bytes"), t.net_rx_bytes);
+    store<uint64_t>(cells.at("net_tx_bytes"), t.net_tx_bytes);
+    store<uint32_t>(cells.at("sampled_fields"), t.sampled_fields);
+    store<int32_t>(cells.at("last_cpu"), t.processor);
+    store<int32_t>(cells.at("uid"), t.uid);
+    if (strings_bytes) memcpy(&out[record + strings_offset], t.strings.data(), strings_bytes);
+}
+
+bool read(const Reader& in, Snapshot& snap, std::string& error)
+{
+    if (!in.valid()) { error = "no snapshot"; return false; }
+    const Header& h = in.header();
+    ProcessTable& t = snap.table;
+    t.clear();
+    t.resize(h.rows);
+
+    // Columns a reader does not know are skipped; ones it needs but cannot find are an error.
+    bool ok = load<int32_t>(in, "pid", COL_I32, t.pid) && load<int32_t>(in, "ppid", COL_I32, t.ppid) &&
+              load<uint8_t>(in, "state", COL_U8, t.state);
+    const uint32_t* cmd = in.column<uint32_t>("cmd", COL_STR);
+    if (!ok || !cmd) { error = "snapshot lacks pid, ppid, state or cmd"; return false; }
+    const uint32_t* cpus = in.column<uint32_t>("cpus_allowed", COL_STR);
+    for (size_t r = 0; r < h.rows; r++) {
+        const char* s = in.string(cmd[r]);
+        t.cmd[r] = t.strings.intern(s, strlen(s));
+        s = cpus ? in.string(cpus[r]) : "";
+        t.cpus_allowed_list[r] = t.strings.intern(s, strlen(s));
+    }
+    load<int64_t>(in, "rss", COL_I64, t.rss);
+    load<int64_t>(in, "threads", COL_I64, t.num_threads);
+    load<int64_t>(in, "priority", COL_I64, t.priority);
+    load<int64_t>(in, "nice", COL_I64, t.nice);
+    load<double>(in, "mem", COL_F64, t.mem_usage);
+    load<double>(in, "cpu", COL_F64, t.cpu_usage);
+    load<double>(in, "io_r", COL_F64, t.io_read_rate);
+    load<double>(in, "io_w", COL_F64, t.io_write_rate);
+    load<double>(in, "age", COL_F64, t.process_age);
+    load<double>(in, "net_rx", COL_F64, t.net_rx_rate);
+    load<double>(in, "net_tx", COL_F64, t.net_tx_rate);
+    load<uint64_t>(in, "utime", COL_U64, t.utime);
+    load<uint64_t>(in, "stime", COL_U64, t.stime);
+    load<uint64_t>(in, "starttime", COL_U64, t.starttime);
+    load<uint64_t>(in, "read_bytes", COL_U64, t.read_bytes);
+    load<uint64_t>(in, "write_bytes", COL_U64, t.write_bytes);
+    load<uint64_t>(in, "rchar", COL_U64, t.rchar);
+    load<uint64_t>(in, "wchar", COL_U64, t.wchar);
+    load<uint64_t>(in, "ctxsw", COL_U64, t.voluntary_ctxt_switches);
+    load<uint64_t>(in, "shared_clean", COL_U64, t.shared_clean);
+    load<uint64_t>(in, "private_dirty", COL_U64, t.private_dirty);
+    load<uint64_t>(in, "fd", COL_U64, t.fd_count);
+    load<uint64_t>(in, "net_rx_bytes", COL_U64, t.net_rx_bytes);
+    load<uint64_t>(in, "net_tx_bytes", COL_U64, t.net_tx_bytes);
+    load<uint32_t>(in, "sampled_fields", COL_U32, t.sampled_fields);
+    load<int32_t>(in, "last_cpu", COL_I32, t.processor);
+    if (!load<int32_t>(in, "uid", COL_I32, t.uid)) t.uid.assign(h.rows, -1);
+    t.linkTree();
+    t.indexTree();
+
+    SystemStats& sys = snap.system;
+    sys.cpu_usage = h.cpu_usage;
+    sys.mem_usage = h.mem_usage;
+    sys.uptime = h.uptime;
+    sys.mem_total = h.mem_total;
+    sys.mem_free = h.mem_free;
+    sys.num_cores = h.num_cores;
+    SystemUtils::CPULoadBreakdown& c = snap.cpu_breakdown;
+    c = SystemUtils::CPULoadBreakdown();
+    c.user = h.cpu_user; c.nice = h.cpu_nice; c.sys = h.cpu_sys; c.idle = h.cpu_idle; c.iowait = h.cpu_iowait;
+    c.irq = h.cpu_irq; c.softirq = h.cpu_softirq; c.steal = h.cpu_steal; c.total = h.cpu_total;
+    SystemUtils::MemBreakdown& m = snap.mem_breakdown;
+    m.total = h.mem_bd_total; m.free = h.mem_bd_free; m.buffers = h.mem_buffers; m.cached = h.mem_cached;
+    m.s_reclaimable = h.mem_s_reclaimable; m.shorthand_used = h.mem_used;
+    snap.sequence = h.sequence;
+    snap.event_driven = h.event_driven != 0;
+    snap.exited.clear();
+    snap.self = CollectorStats();
+    return true;
+}
+
+}
@@ -1,6 +1,11 @@
 #include "SystemUtils.h"
+#include "ProcParse.h"
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cerrno>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
@@ -13,31 +18,456 @@
 
 namespace SystemUtils {
 
-void scanProcesses(std::vector<ProcessInfo>& processes, std::map<pid_t, std::vector<pid_t>>& process_tree,
-                        std::map<pid_t, ProcessInfo>& process_map, uint64_t& mem_total, uint64_t& mem_free,
+// Marks a file that could not be opened for this PID (EACCES, ENOENT) so it is not retried every tick.
+static const int FD_UNAVAILABLE = -2;
+static const int FD_RESERVE = 64;
+static const size_t CMD_SLOT = 64;
+static const size_t CPUS_SLOT = 128;     // Cpus_allowed_list; longer lists are cut short
+static const uint64_t CGROUP_TICKS = 16; // a process's cgroup is re-read about this often
+
+static inline uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Adds the time until stop() or the end of the enclosing scope to one ScanTimings phase; free
+// when timings is NULL.
+struct PhaseTimer {
+    ScanTimings* timings;
+    ScanPhase phase;
+    uint64_t start;
+
+    PhaseTimer(ScanTimings* t, ScanPhase p) : timings(t), phase(p), start(t ? monotonicNs() : 0) {}
+    ~PhaseTimer() { stop(); }
+    void stop()
+    {
+        if (timings) timings->ns[phase] += monotonicNs() - start;
+        timings = NULL;
+    }
+};
+
+const char* ScanTimings::name(int phase)
+{
+    static const char* names[PHASE_COUNT] = { "walk", "stat", "status", "io", "net", "smaps", "fd", "table", "rates", "threads", "numa", "cgroup" };
+    return phase >= 0 && phase < PHASE_COUNT ? names[phase] : "?";
+}
+
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+ProcFdCache::ProcFdCache()
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &rl) != 0) getrlimit(RLIMIT_NOFILE, &rl);
+        }
+        rlim_t lim = (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > (1u << 20)) ? (1u << 20) : rl.rlim_cur;
+        max_fds = (int)lim > FD_RESERVE ? (int)lim - FD_RESERVE : 0;
+    }
+}
+
+ProcFdCache::~ProcFdCache() { closeAll(); }
+
+static void closeFd(ProcFdCache& c, int& fd)
+{
+    if (fd >= 0) { close(fd); c.open_fds--; c.syscalls++; }
+    fd = -1;
+}
+
+static void closeHandles(ProcFdCache& c, PidHandles& h)
+{
+    closeFd(c, h.stat_fd);  closeFd(c, h.status_fd); closeFd(c, h.io_fd);
+    closeFd(c, h.net_fd);   closeFd(c, h.smaps_fd);  closeFd(c, h.fd_dir_fd);
+    closeFd(c, h.task_fd);  closeFd(c, h.dir_fd);
+}
+
+static void closeTask(ProcFdCache& c, TaskHandles& h)
+{
+    closeFd(c, h.stat_fd);
+    closeFd(c, h.status_fd);
+}
+
+static void closeCgroup(ProcFdCache& c, CgroupHandles& h)
+{
+    closeFd(c, h.cpu_fd); closeFd(c, h.mem_fd); closeFd(c, h.io_fd);
+    closeFd(c, h.psi_fd); closeFd(c, h.dir_fd);
+}
+
+void ProcFdCache::evict(pid_t pid)
+{
+    auto it = entries.find(pid);
+    if (it == entries.end()) return;
+    closeHandles(*this, it->second);
+    entries.erase(it);
+}
+
+void ProcFdCache::closeAll()
+{
+    for (auto& e : entries) closeHandles(*this, e.second);
+    entries.clear();
+    for (auto& t : tasks) closeTask(*this, t.second);
+    tasks.clear();
+    for (auto& g : cgroups) closeCgroup(*this, g.second);
+    cgroups.clear();
+    for (int& fd : psi_fds) closeFd(*this, fd);
+    closeFd(*this, proc_fd);
+    closeFd(*this, meminfo_fd);
+    closeFd(*this, stat_fd);
+    closeFd(*this, cgroup_fd);
+}
+
+static int openCached(ProcFdCache& c, int dir_fd, int& fd, const char* name, int flags)
+{
+    if (fd >= 0 || fd == FD_UNAVAILABLE) return fd;
+    fd = openat(dir_fd, name, flags | O_RDONLY | O_CLOEXEC);
+    c.syscalls++;
+    if (fd >= 0) c.open_fds++;
+    else if (errno == EACCES || errno == ENOENT || errno == EPERM) fd = FD_UNAVAILABLE;
+    return fd;
+}
+
+// Reads a /proc file from offset 0 into buf. A short read from a seq_file means EOF, so the
+// steady state is a single pread per file.
+static ssize_t readAt(ProcFdCache& c, int fd, char* buf, size_t len)
+{
+    size_t got = 0;
+    while (got + 1 < len) {
+        ssize_t n = pread(fd, buf + got, len - 1 - got, (off_t)got);
+        c.syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        got += (size_t)n;
+        if (n == 0 || got + 1 < len) break;
+    }
+    buf[got] = '\0';
+    c.bytes_read += got;
+    return (ssize_t)got;
+}
+
+static ssize_t readCached(ProcFdCache& c, int dir_fd, int& fd, const char* name, char* buf, size_t len)
+{
+    if (openCached(c, dir_fd, fd, name, 0) < 0) return -1;
+    ssize_t n = readAt(c, fd, buf, len);
+    if (n < 0) closeFd(c, fd);
+    return n;
+}
+
+static uint64_t countDirEntries(ProcFdCache& c, int fd)
+{
+    char dbuf[4096];
+    uint64_t cnt = 0;
+    c.syscalls++;
+    if (lseek(fd, 0, SEEK_SET) < 0) return 0;
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, dbuf, sizeof(dbuf));
+        c.syscalls++;
+        if (n <= 0) break;
+        c.bytes_read += n;
+        for (long off = 0; off < n; ) {
+            linux_dirent64* d = (linux_dirent64*)(dbuf + off);
+            if (d->d_name[0] != '.') cnt++;
+            off += d->d_reclen;
+        }
+    }
+    return cnt;
+}
+
+// Fills row i of the table. cmd_slot and cpus_slot receive the raw command name and CPU list;
+// interning happens after the (possibly parallel) scan because the string pool is not thread-safe.
+static bool readProcess(ProcFdCache& c, PidHandles& h, pid_t pid, ProcessTable& t, size_t i,
+                        char* cmd_slot, char* cpus_slot, unsigned fields, long clk_tck, double system_uptime,
+                        ScanTimings* timings)
+{
+    char buf[8192];
+
+    char statline[2048];
+    ssize_t n;
+    ProcParse::PidStat st = {};
+    {
+        PhaseTimer pt(timings, PHASE_STAT);
+        n = readCached(c, h.dir_fd, h.stat_fd, "stat", statline, sizeof(statline));
+        if (n <= 0 || !ProcParse::parsePidStat(statline, (size_t)n, st, true)) return false;
+    }
+
+    t.resetRow(i);
+    t.pid[i] = pid;
+    size_t cmd_len = std::min<size_t>(st.comm_len, CMD_SLOT - 1);
+    memcpy(cmd_slot, st.comm, cmd_len);
+    cmd_slot[cmd_len] = '\0';
+
+    t.state[i]       = st.state;
+    t.ppid[i]        = (pid_t)st.ppid;
+    t.utime[i]       = st.utime;
+    t.stime[i]       = st.stime;
+    t.starttime[i]   = st.starttime;
+    t.priority[i]    = st.priority;
+    t.nice[i]        = st.nice;
+    t.num_threads[i] = st.num_threads;
+    t.processor[i]   = st.processor;
+    t.uid[i]         = -1;
+    t.rss[i]         = st.rss * (getpagesize() / 1024);
+    bool is_kthread  = (st.flags & PF_KTHREAD) != 0;
+
+    if (system_uptime > 0 && clk_tck > 0) {
+        double age = (system_uptime - (double)st.starttime / (double)clk_tck) / 3600.0;
+        t.process_age[i] = age < 0 ? 0 : age;
+    }
+
+    t.sampled_fields[i] = fields;
+    if (fields & FIELD_STATUS) {
+        PhaseTimer pt(timings, PHASE_STATUS);
+        uint64_t val = 0;
+        const char* cpus;
+        size_t cpus_len;
+        if ((n = readCached(c, h.dir_fd, h.status_fd, "status", buf, sizeof(buf))) > 0 &&
+            ProcParse::parseStatusAffinity(buf, (size_t)n, val, cpus, cpus_len)) {
+            t.voluntary_ctxt_switches[i] = val;
+            cpus_len = std::min(cpus_len, CPUS_SLOT - 1);
+            memcpy(cpus_slot, cpus, cpus_len);
+            cpus_slot[cpus_len] = '\0';
+        }
+        uint32_t uid;
+        if (n > 0 && ProcParse::parseStatusUid(buf, (size_t)n, uid)) t.uid[i] = (int32_t)uid;
+    }
+    if (!is_kthread) {
+        if (fields & FIELD_IO) {
+            PhaseTimer pt(timings, PHASE_IO);
+            ProcParse::PidIo io;
+            if ((n = readCached(c, h.dir_fd, h.io_fd, "io", buf, sizeof(buf))) > 0 &&
+                ProcParse::parsePidIo(buf, (size_t)n, io)) {
+                t.rchar[i] = io.rchar;
+                t.wchar[i] = io.wchar;
+                t.read_bytes[i] = io.read_bytes;
+                t.write_bytes[i] = io.write_bytes;
+            }
+        }
+
+        if (fields & FIELD_NET) {
+            PhaseTimer pt(timings, PHASE_NET);
+            if ((n = readCached(c, h.dir_fd, h.net_fd, "net/dev", buf, sizeof(buf))) > 0)
+                ProcParse::parseNetDev(buf, (size_t)n, t.net_rx_bytes[i], t.net_tx_bytes[i]);
+        }
+
+        if (fields & FIELD_SMAPS) {
+            PhaseTimer pt(timings, PHASE_SMAPS);
+            ProcParse::SmapsRollup sr;
+            if ((n = readCached(c, h.dir_fd, h.smaps_fd, "smaps_rollup", buf, sizeof(buf))) > 0 &&
+                ProcParse::parseSmapsRollup(buf, (size_t)n, sr)) {
+                t.shared_clean[i] = sr.shared_clean;
+                t.private_dirty[i] = sr.private_dirty;
+            }
+        }
+
+        if (fields & FIELD_FD) {
+            PhaseTimer pt(timings, PHASE_FD);
+            if (openCached(c, h.dir_fd, h.fd_dir_fd, "fd", O_DIRECTORY) >= 0)
+                t.fd_count[i] = countDirEntries(c, h.fd_dir_fd);
+        }
+    }
+    return true;
+}
+
+// Returns the cached handles for pid, creating an empty entry on first sight. Must be called from
+// the scanning thread only; the directory itself is opened lazily by scanPid.
+static PidHandles* lookupHandles(ProcFdCache& c, pid_t pid)
+{
+    auto it = c.entries.find(pid);
+    if (it == c.entries.end()) {
+        PidHandles h;
+        h.dir_fd = h.stat_fd = h.status_fd = h.io_fd = h.net_fd = h.smaps_fd = h.fd_dir_fd = h.task_fd = -1;
+        h.starttime = 0;
+        h.cgroup_tick = 0;
+        it = c.entries.insert(std::make_pair(pid, h)).first;
+    }
+    it->second.generation = c.generation;
+    return &it->second;
+}
+
+static void readCgroup(ProcFdCache& c, PidHandles& h)
+{
+    char buf[4096];
+    h.cgroup.clear();
+    h.cgroup_tick = c.generation;
+    int fd = openat(h.dir_fd, "cgroup", O_RDONLY | O_CLOEXEC);
+    c.syscalls++;
+    if (fd < 0) return;
+    ssize_t n = readAt(c, fd, buf, sizeof(buf));
+    close(fd);
+    c.syscalls++;
+    const char* path;
+    size_t len;
+    if (n > 0 && ProcParse::parseCgroupV2(buf, (size_t)n, path, len)) h.cgroup.assign(path, len);
+}
+
+// Only touches its own entry, so it is safe to run concurrently for different PIDs. A PID whose
+// starttime no longer matches has been reused and gets a fresh set of descriptors. Entries that
+// must go are marked with generation 0 and dropped by the sweep after the scan.
+static bool scanPid(ProcFdCache& c, PidHandles& h, pid_t pid, ProcessTable& t, size_t i, char* cmd_slot,
+                    char* cpus_slot, const ScanDemand& demand, long clk_tck, double system_uptime, ScanTimings* timings)
+{
+    // New PIDs get a full first sample so later partial ticks have something to carry forward.
+    // refresh_ticks == 0 disables that and the periodic refresh, leaving exactly all_fields.
+    unsigned fields = demand.all_fields;
+    if (demand.hot_pids.count(pid) ||
+        (demand.refresh_ticks > 0 && (h.starttime == 0 || demand.refresh_ticks == 1 ||
+                                      (c.generation + (uint64_t)pid) % demand.refresh_ticks == 0)))
+        fields = FIELD_ALL;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (h.dir_fd < 0) {
+            PhaseTimer pt(timings, PHASE_STAT);
+            char name[16];
+            snprintf(name, sizeof(name), "%d", pid);
+            h.dir_fd = openat(c.proc_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            c.syscalls++;
+            if (h.dir_fd < 0) break;
+            c.open_fds++;
+        }
+        if (readProcess(c, h, pid, t, i, cmd_slot, cpus_slot, fields, clk_tck, system_uptime, timings) &&
+            (h.starttime == 0 || h.starttime == t.starttime[i])) {
+            h.starttime = t.starttime[i];
+            t.io_tick[i] = t.net_tick[i] = c.generation;
+            // Processes rarely change cgroup, so the file is read on first sight, after a gap and
+            // then on a staggered schedule; the path is interned with the command after the scan.
+            if (demand.cgroups && (!h.cgroup_tick || c.generation - h.cgroup_tick > CGROUP_TICKS ||
+                                   (c.generation + (uint64_t)pid) % CGROUP_TICKS == 0)) {
+                PhaseTimer pt(timings, PHASE_CGROUP);
+                readCgroup(c, h);
+            }
+            // Over the descriptor budget: behave like the uncached path for this PID. Closing now
+            // rather than at the sweep keeps later PIDs of this scan from hitting EMFILE.
+            if (c.open_fds > c.max_fds) closeHandles(c, h);
+            return true;
+        }
+        closeHandles(c, h);
+        h.starttime = 0;
+        h.cgroup_tick = 0;
+    }
+    h.generation = 0;
+    return false;
+}
+
+// A sample whose starttime differs belongs to an earlier process that had the same PID.
+const PrevSample* PrevSampleStore::find(pid_t pid, unsigned long starttime) const
+{
+    auto it = samples.find(pid);
+    if (it == samples.end() || it->second.starttime != starttime) return NULL;
+    return &it->second;
+}
+
+void PrevSampleStore::record(const ProcessTable& t)
+{
+    generation++;
+    pool_ids.assign(t.strings.size(), UINT32_MAX);
+    for (size_t i = 0; i < t.size(); i++) {
+        PrevSample& s = samples[t.pid[i]];
+        s.starttime = t.starttime[i];
+        s.utime = t.utime[i];
+        s.stime = t.stime[i];
+        s.read_bytes = t.read_bytes[i];
+        s.write_bytes = t.write_bytes[i];
+        s.rchar = t.rchar[i];
+        s.wchar = t.wchar[i];
+        s.voluntary_ctxt_switches = t.voluntary_ctxt_switches[i];
+        s.shared_clean = t.shared_clean[i];
+        s.private_dirty = t.private_dirty[i];
+        s.fd_count = t.fd_count[i];
+        s.net_rx_bytes = t.net_rx_bytes[i];
+        s.net_tx_bytes = t.net_tx_bytes[i];
+        s.io_tick = t.io_tick[i];
+        s.net_tick = t.net_tick[i];
+        s.io_read_rate = t.io_read_rate[i];
+        s.io_write_rate = t.io_write_rate[i];
+        s.net_rx_rate = t.net_rx_rate[i];
+        s.net_tx_rate = t.net_tx_rate[i];
+        uint32_t sid = t.cpus_allowed_list[i];
+        if (pool_ids[sid] == UINT32_MAX) {
+            std::string list(t.strings.str(sid), t.strings.length(sid));
+            auto it = affinity_ids.find(list);
+            if (it == affinity_ids.end()) {
+                it = affinity_ids.insert(std::make_pair(list, (uint32_t)affinities.size())).first;
+                affinities.push_back(list);
+            }
+            pool_ids[sid] = it->second;
+        }
+        s.cpus_allowed = pool_ids[sid];
+        s.uid = t.uid[i];
+        s.generation = generation;
+    }
+    for (auto it = samples.begin(); it != samples.end(); ) {
+        if (it->second.generation != generation) it = samples.erase(it);
+        else ++it;
+    }
+    // Give back the bucket array after a PID storm has subsided.
+    if (samples.bucket_count() > 4 * samples.size() + 1024) samples.rehash(0);
+}
+
+// Approximate heap footprint: one node (value plus next pointer and cached hash) per PID and
+// the bucket array.
+size_t PrevSampleStore::bytes() const
+{
+    size_t node = sizeof(std::pair<const pid_t, PrevSample>) + 2 * sizeof(void*);
+    return samples.size() * node + samples.bucket_count() * sizeof(void*);
+}
+
+// Turns one /proc/stat cpu line into percentages of the jiffies since the previous call.
+static void updateLoad(CPULoadBreakdown& b, const uint64_t* cpu)
+{
+    uint64_t u = cpu[0], n = cpu[1], s = cpu[2], i = cpu[3], iw = cpu[4];
+    uint64_t ir = cpu[5], si = cpu[6], st = cpu[7], g = cpu[8], gn = cpu[9];
+    uint64_t total = u + n + s + i + iw + ir + si + st + g + gn;
+    if (b.prev_total > 0 && total > b.prev_total) {
+        double dt = (double)(total - b.prev_total);
+        b.user    = 100.0 * (u - b.prev_u) / dt;
+        b.nice    = 100.0 * (n - b.prev_n) / dt;
+        b.sys     = 100.0 * (s - b.prev_s) / dt;
+        b.idle    = 100.0 * (i - b.prev_i) / dt;
+        b.iowait  = 100.0 * (iw - b.prev_iw) / dt;
+        b.irq     = 100.0 * (ir - b.prev_ir) / dt;
+        b.softirq = 100.0 * (si - b.prev_si) / dt;
+        b.steal   = 100.0 * (st - b.prev_st) / dt;
+        b.total   = std::max(0.0, std::min(100.0, 100.0 - b.idle - b.iowait));
+    }
+    b.prev_u=u; b.prev_n=n; b.prev_s=s; b.prev_i=i;
+    b.prev_iw=iw; b.prev_ir=ir; b.prev_si=si; b.prev_st=st;
+    b.prev_total = total;
+}
+
+void scanProcesses(ProcessTable& table, uint64_t& mem_total, uint64_t& mem_free,
                         double& system_mem_usage, double& system_cpu_usage, uint64_t& prev_total_jiffies,
-                        uint64_t& prev_work_jiffies, std::map<pid_t, ProcessInfo>& prev_processes,
+                        uint64_t& prev_work_jiffies, const PrevSampleStore& prev_samples,
                         int num_cores, long clk_tck, double system_uptime, double poll_interval,
-                        std::string& /*status_msg*/, CPULoadBreakdown& b, MemBreakdown& m)
+                        std::string& /*status_msg*/, CPULoadBreakdown& b, std::vector<CPULoadBreakdown>& cores,
+                        MemBreakdown& m,
+                        ProcFdCache& fd_cache, ScanPool* pool, const ScanDemand& demand,
+                        const std::vector<pid_t>* pid_list, ScanTimings* timings)
 {
-    processes.clear();
-    process_tree.clear();
-    process_map.clear();
+    table.clear();
+    fd_cache.generation++;
+    if (openCached(fd_cache, AT_FDCWD, fd_cache.proc_fd, fd_cache.proc_root.c_str(), O_DIRECTORY) < 0) return;
 
     m = {};
     {
-        FILE* mf = fopen("/proc/meminfo", "r");
-        if (mf) {
-            char ml[128];
-            while (fgets(ml, sizeof(ml), mf)) {
-                unsigned long val = 0;
-                if      (sscanf(ml, "MemTotal: %lu", &val) == 1) m.total = val;
-                else if (sscanf(ml, "MemFree: %lu",  &val) == 1) m.free  = val;
-                else if (sscanf(ml, "Buffers: %lu",  &val) == 1) m.buffers = val;
-                else if (sscanf(ml, "Cached: %lu",   &val) == 1) m.cached  = val;
-                else if (sscanf(ml, "SReclaimable: %lu", &val) == 1) m.s_reclaimable = val;
-            }
-            fclose(mf);
+        char mbuf[4096];
+        ssize_t n = readCached(fd_cache, fd_cache.proc_fd, fd_cache.meminfo_fd, "meminfo", mbuf, sizeof(mbuf));
+        ProcParse::MemInfo mi;
+        if (n > 0 && ProcParse::parseMeminfo(mbuf, (size_t)n, mi)) {
+            m.total = mi.total;
+            m.free = mi.free;
+            m.buffers = mi.buffers;
+            m.cached = mi.cached;
+            m.s_reclaimable = mi.s_reclaimable;
         }
     }
     mem_total = m.total;
@@ -50,32 +480,40 @@ void scanProcesses(std::vector<ProcessInfo>& processes, std::map<pid_t, std::vec
 
     uint64_t total_jiffies = 0, work_jiffies = 0;
     {
-        FILE* psf = fopen("/proc/stat", "r");
-        if (psf) {
-            char line[256] = {};
-            fgets(line, sizeof(line), psf);
-            fclose(psf);
-            uint64_t u=0,n=0,s=0,i=0,iw=0,ir=0,si=0,st=0,g=0,gn=0;
-            if (sscanf(line, "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                   &u,&n,&s,&i,&iw,&ir,&si,&st,&g,&gn) >= 4) 
-            {
-                work_jiffies  = u + n + s + ir + si + st + g + gn;
-                total_jiffies = work_jiffies + i + iw;
-
-                if (prev_total_jiffies > 0 && total_jiffies > prev_total_jiffies) {
-                    uint64_t dt = total_jiffies - prev_total_jiffies;
-                    b.user    = 100.0 * (u - b.prev_u) / dt;
-                    b.nice    = 100.0 * (n - b.prev_n) / dt;
-                    b.sys     = 100.0 * (s - b.prev_s) / dt;
-                    b.idle    = 100.0 * (i - b.prev_i) / dt;
-                    b.iowait  = 100.0 * (iw - b.prev_iw) / dt;
-                    b.irq     = 100.0 * (ir - b.prev_ir) / dt;
-                    b.softirq = 100.0 * (si - b.prev_si) / dt;
-                    b.steal   = 100.0 * (st - b.prev_st) / dt;
-                }
-                b.prev_u=u; b.prev_n=n; b.prev_s=s; b.prev_i=i;
-                b.prev_iw=iw; b.prev_ir=ir; b.prev_si=si; b.prev_st=st;
+        // The aggregate line and every cpuN line come from one read; the interrupt counters after
+        // them may be cut off. About 120 bytes per cpu line is plenty. Sized for every configured
+        // cpu, not just those online at startup, and doubled should more lines than that turn up.
+        if (fd_cache.stat_cpus.empty())
+            fd_cache.stat_cpus.resize(std::max<long>(std::max(sysconf(_SC_NPROCESSORS_CONF), (long)num_cores), 1));
+        ssize_t len;
+        uint64_t cpu[10];
+        int ncores;
+        for (;;) {
+            size_t want = 1024 + 128 * (fd_cache.stat_cpus.size() + 1);
+            if (fd_cache.stat_buf.size() < want) fd_cache.stat_buf.resize(want);
+            len = readCached(fd_cache, fd_cache.proc_fd, fd_cache.stat_fd, "stat",
+                             fd_cache.stat_buf.data(), fd_cache.stat_buf.size());
+            ncores = len > 0 ? ProcParse::parseStatCpus(fd_cache.stat_buf.data(), (size_t)len, cpu,
+                                                        fd_cache.stat_cpus.data(), (int)fd_cache.stat_cpus.size()) : 0;
+            if (ncores < (int)fd_cache.stat_cpus.size()) break;
+            fd_cache.stat_cpus.resize(fd_cache.stat_cpus.size() * 2);
+        }
+        if (len > 0) {
+            uint64_t u = cpu[0], n = cpu[1], s = cpu[2], i = cpu[3], iw = cpu[4];
+            uint64_t ir = cpu[5], si = cpu[6], st = cpu[7], g = cpu[8], gn = cpu[9];
+            work_jiffies  = u + n + s + ir + si + st + g + gn;
+            total_jiffies = work_jiffies + i + iw;
+            if (total_jiffies) updateLoad(b, cpu);
+        }
+        // A cpu that went offline or came back starts over instead of diffing against another's counters.
+        cores.resize(ncores);
+        for (int k = 0; k < ncores; k++) {
+            const ProcParse::CpuTimes& t = fd_cache.stat_cpus[k];
+            if (cores[k].cpu != t.cpu) {
+                cores[k] = CPULoadBreakdown();
+                cores[k].cpu = t.cpu;
             }
+            updateLoad(cores[k], t.v);
         }
     }
     uint64_t delta_t = 1;
@@ -85,195 +523,543 @@ void scanProcesses(std::vector<ProcessInfo>& processes, std::map<pid_t, std::vec
         system_cpu_usage = (dcpu < 0) ? 0.0 : (dcpu > 100.0 ? 100.0 : dcpu);
     }
 
-    DIR* dir = opendir("/proc");
-    if (!dir) return;
-
-    char buf[4096];
-    struct dirent* entry;
-
-    while ((entry = readdir(dir)))
-    {
-        if (entry->d_type != DT_DIR) continue;
-        char* endp;
-        pid_t pid = (pid_t)strtol(entry->d_name, &endp, 10);
-        if (*endp != '\0' || pid <= 0) continue;
-
-        ProcessInfo info = {};
-        info.pid = pid;
-
-        snprintf(buf, sizeof(buf), "/proc/%d/stat", pid);
-        FILE* sf = fopen(buf, "r");
-        if (!sf) continue;
-        char statline[2048] = {};
-        bool ok = (fgets(statline, sizeof(statline), sf) != NULL);
-        fclose(sf);
-        if (!ok) continue;
-
-        char* fp = strchr(statline, '(');
-        char* lp = strrchr(statline, ')');
-        if (!fp || !lp || fp >= lp) continue;
-        info.cmd = std::string(fp + 1, lp - fp - 1);
-
-        char   state = 'S';
-        long   ppid = 0, priority = 20, nice = 0, num_threads = 1, rss = 0;
-        unsigned long utime = 0, stime = 0, starttime = 0, flags = 0;
+    if (!pid_list) {
+        fd_cache.syscalls++;
+        if (lseek(fd_cache.proc_fd, 0, SEEK_SET) < 0) return;
+    }
 
+    // With an event-driven PID list the /proc walk is skipped entirely.
+    std::vector<pid_t> pids;
+    std::vector<PidHandles*> handles;
+    PhaseTimer walk_timer(timings, PHASE_WALK);
+    if (pid_list) {
+        pids = *pid_list;
+        for (pid_t pid : pids) handles.push_back(lookupHandles(fd_cache, pid));
+    } else {
+        char dbuf[32768];
+        for (;;)
         {
-            char* p = lp + 1;
-            while (*p == ' ') p++;
-            state = *p; p++;
-            if (*p == ' ') p++;
-
-            auto skip = [](char* p) { while (*p && *p != ' ') p++; while (*p == ' ') p++; return p; };
-            ppid = strtol(p, &p, 10); while (*p == ' ') p++;
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            flags = strtoul(p, &p, 10); while (*p == ' ') p++;
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            utime = strtoul(p, &p, 10); while (*p == ' ') p++;
-            stime = strtoul(p, &p, 10); while (*p == ' ') p++;
-            skip(p); p = skip(p);
-            skip(p); p = skip(p);
-            priority = strtol(p, &p, 10); while (*p == ' ') p++;
-            nice     = strtol(p, &p, 10); while (*p == ' ') p++;
-            num_threads = strtol(p, &p, 10); while (*p == ' ') p++;
-            skip(p); p = skip(p);
-            starttime = strtoul(p, &p, 10); while (*p == ' ') p++;
-            skip(p); p = skip(p);
-            rss = strtol(p, &p, 10);
+            long n = syscall(SYS_getdents64, fd_cache.proc_fd, dbuf, sizeof(dbuf));
+            fd_cache.syscalls++;
+            if (n <= 0) break;
+            fd_cache.bytes_read += n;
+            for (long off = 0; off < n; )
+            {
+                linux_dirent64* entry = (linux_dirent64*)(dbuf + off);
+                off += entry->d_reclen;
+                if (entry->d_type != DT_DIR) continue;
+                char* endp;
+                pid_t pid = (pid_t)strtol(entry->d_name, &endp, 10);
+                if (*endp != '\0' || pid <= 0) continue;
+                pids.push_back(pid);
+                handles.push_back(lookupHandles(fd_cache, pid));
+            }
         }
+    }
 
-        info.state       = state;
-        info.ppid        = (pid_t)ppid;
-        info.utime       = utime;
-        info.stime       = stime;
-        info.priority    = priority;
-        info.nice        = nice;
-        info.num_threads = num_threads;
-        info.rss         = rss * (getpagesize() / 1024);
-        bool is_kthread  = (flags & PF_KTHREAD) != 0;
-
-        if (system_uptime > 0 && clk_tck > 0) {
-            info.process_age = (system_uptime - (double)starttime / (double)clk_tck) / 3600.0;
-            if (info.process_age < 0) info.process_age = 0;
+    // Rows must come out in PID order for ProcessTable::find.
+    if (!std::is_sorted(pids.begin(), pids.end())) {
+        std::vector<size_t> order(pids.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return pids[a] < pids[b]; });
+        std::vector<pid_t> sorted_pids(pids.size());
+        std::vector<PidHandles*> sorted_handles(pids.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            sorted_pids[i] = pids[order[i]];
+            sorted_handles[i] = handles[order[i]];
         }
+        pids.swap(sorted_pids);
+        handles.swap(sorted_handles);
+    }
+    walk_timer.stop();
 
-        snprintf(buf, sizeof(buf), "/proc/%d/status", pid);
-        FILE* stf = fopen(buf, "r");
-        if (stf) {
-            char sl[256];
-            while (fgets(sl, sizeof(sl), stf)) {
-                unsigned long val = 0;
-                if (sscanf(sl, "voluntary_ctxt_switches:\t%lu", &val) == 1)
-                    info.voluntary_ctxt_switches = val;
-            }
-            fclose(stf);
+    size_t n = pids.size();
+    std::vector<char> ok(n, 0);
+    std::vector<char> cmd_slots(n * CMD_SLOT), cpus_slots(n * CPUS_SLOT);
+    table.resize(n);
+    auto scanOne = [&](size_t i) {
+        ok[i] = scanPid(fd_cache, *handles[i], pids[i], table, i, &cmd_slots[i * CMD_SLOT], &cpus_slots[i * CPUS_SLOT],
+                        demand, clk_tck, system_uptime, timings);
+    };
+    if (pool) pool->parallelFor(n, scanOne);
+    else for (size_t i = 0; i < n; i++) scanOne(i);
+
+    PhaseTimer table_timer(timings, PHASE_TABLE);
+    for (size_t i = 0; i < n; i++) {
+        if (!ok[i]) continue;
+        table.cmd[i] = table.strings.intern(&cmd_slots[i * CMD_SLOT], strlen(&cmd_slots[i * CMD_SLOT]));
+        if (cpus_slots[i * CPUS_SLOT])
+            table.cpus_allowed_list[i] = table.strings.intern(&cpus_slots[i * CPUS_SLOT], strlen(&cpus_slots[i * CPUS_SLOT]));
+        if (demand.cgroups)
+            table.cgroup[i] = table.strings.intern(handles[i]->cgroup.data(), handles[i]->cgroup.size());
+    }
+    table.compact(ok);
+    table.linkTree();
+    table_timer.stop();
+
+    for (auto it = fd_cache.entries.begin(); it != fd_cache.entries.end(); ) {
+        if (it->second.generation != fd_cache.generation) {
+            closeHandles(fd_cache, it->second);
+            it = fd_cache.entries.erase(it);
+        } else ++it;
+    }
+
+    PhaseTimer rates_timer(timings, PHASE_RATES);
+    for (size_t i = 0; i < table.size(); i++) {
+        if (m.total > 0)
+            table.mem_usage[i] = 100.0 * (double)table.rss[i] / (double)m.total;
+
+        const PrevSample* prev_sample = prev_samples.find(table.pid[i], table.starttime[i]);
+        if (!prev_sample) continue;
+        const PrevSample& prev = *prev_sample;
+
+        uint64_t delta_p = (table.utime[i] + table.stime[i]) - (prev.utime + prev.stime);
+        table.cpu_usage[i] = 100.0 * (double)delta_p / (double)delta_t * num_cores;
+        if (table.cpu_usage[i] < 0) table.cpu_usage[i] = 0;
+        if (table.cpu_usage[i] > 100.0 * num_cores) table.cpu_usage[i] = 100.0 * num_cores;
+
+        // Fields skipped this tick keep the previous sample's values and rates; fields read after
+        // a gap compute their rate over the whole gap.
+        if (!(table.sampled_fields[i] & FIELD_STATUS)) {
+            table.voluntary_ctxt_switches[i] = prev.voluntary_ctxt_switches;
+            table.uid[i] = prev.uid;
+            const std::string& cpus = prev_samples.affinity(prev.cpus_allowed);
+            table.cpus_allowed_list[i] = table.strings.intern(cpus.data(), cpus.size());
+        }
+        if (!(table.sampled_fields[i] & FIELD_SMAPS)) {
+            table.shared_clean[i]  = prev.shared_clean;
+            table.private_dirty[i] = prev.private_dirty;
         }
+        if (!(table.sampled_fields[i] & FIELD_FD)) table.fd_count[i] = prev.fd_count;
 
-        if (!is_kthread) {
-            snprintf(buf, sizeof(buf), "/proc/%d/io", pid);
-            FILE* iof = fopen(buf, "r");
-            if (iof) {
-                char il[128];
-                while (fgets(il, sizeof(il), iof)) {
-                    unsigned long val = 0;
-                    if      (sscanf(il, "rchar: %lu",       &val) == 1) info.rchar       = val;
-                    else if (sscanf(il, "wchar: %lu",       &val) == 1) info.wchar       = val;
-                    else if (sscanf(il, "read_bytes: %lu",  &val) == 1) info.read_bytes  = val;
-                    else if (sscanf(il, "write_bytes: %lu", &val) == 1) info.write_bytes = val;
-                }
-                fclose(iof);
+        if (!(table.sampled_fields[i] & FIELD_IO)) {
+            table.read_bytes[i] = prev.read_bytes;  table.write_bytes[i] = prev.write_bytes;
+            table.rchar[i]      = prev.rchar;       table.wchar[i]       = prev.wchar;
+            table.io_read_rate[i] = prev.io_read_rate; table.io_write_rate[i] = prev.io_write_rate;
+            table.io_tick[i] = prev.io_tick;
+        } else {
+            double io_interval = poll_interval * (double)(table.io_tick[i] > prev.io_tick ? table.io_tick[i] - prev.io_tick : 1);
+            bool has_disk_io = (table.read_bytes[i] > 0 || prev.read_bytes > 0);
+            if (has_disk_io) {
+                table.io_read_rate[i]  = (double)(table.read_bytes[i]  - prev.read_bytes)  / 1024.0 / io_interval;
+                table.io_write_rate[i] = (double)(table.write_bytes[i] - prev.write_bytes) / 1024.0 / io_interval;
+            } else if (table.rchar[i] > 0 || prev.rchar > 0) {
+                table.io_read_rate[i]  = (double)(table.rchar[i] - prev.rchar) / 1024.0 / io_interval;
+                table.io_write_rate[i] = (double)(table.wchar[i] - prev.wchar) / 1024.0 / io_interval;
             }
+            if (table.io_read_rate[i]  < 0) table.io_read_rate[i]  = 0;
+            if (table.io_write_rate[i] < 0) table.io_write_rate[i] = 0;
+        }
 
-            snprintf(buf, sizeof(buf), "/proc/%d/net/dev", pid);
-            FILE* nf = fopen(buf, "r");
-            if (nf) {
-                char nl[512];
-                fgets(nl, sizeof(nl), nf);
-                fgets(nl, sizeof(nl), nf);
-                while (fgets(nl, sizeof(nl), nf)) {
-                    char* colon = strchr(nl, ':');
-                    if (!colon) continue;
-                    uint64_t rx=0, tx=0, d=0;
-                    int nr = sscanf(colon+1, " %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                                    &rx,&d,&d,&d,&d,&d,&d,&d,&tx);
-                    if (nr >= 9) { info.net_rx_bytes += rx; info.net_tx_bytes += tx; }
-                }
-                fclose(nf);
-            }
+        if (!(table.sampled_fields[i] & FIELD_NET)) {
+            table.net_rx_bytes[i] = prev.net_rx_bytes; table.net_tx_bytes[i] = prev.net_tx_bytes;
+            table.net_rx_rate[i]  = prev.net_rx_rate;  table.net_tx_rate[i]  = prev.net_tx_rate;
+            table.net_tick[i] = prev.net_tick;
+        } else {
+            double net_interval = poll_interval * (double)(table.net_tick[i] > prev.net_tick ? table.net_tick[i] - prev.net_tick : 1);
+            if (table.net_rx_bytes[i] >= prev.net_rx_bytes)
+                table.net_rx_rate[i] = (double)(table.net_rx_bytes[i] - prev.net_rx_bytes) / 1024.0 / net_interval;
+            if (table.net_tx_bytes[i] >= prev.net_tx_bytes)
+                table.net_tx_rate[i] = (double)(table.net_tx_bytes[i] - prev.net_tx_bytes) / 1024.0 / net_interval;
+        }
+    }
 
-            snprintf(buf, sizeof(buf), "/proc/%d/smaps_rollup", pid);
-            FILE* rmf = fopen(buf, "r");
-            if (rmf) {
-                char rl[256];
-                while (fgets(rl, sizeof(rl), rmf)) {
-                    unsigned long val = 0;
-                    if      (sscanf(rl, "Shared_Clean: %lu",  &val) == 1) info.shared_clean  = val;
-                    else if (sscanf(rl, "Private_Dirty: %lu", &val) == 1) info.private_dirty = val;
-                }
-                fclose(rmf);
-            }
+    rates_timer.stop();
 
-            snprintf(buf, sizeof(buf), "/proc/%d/fd", pid);
-            DIR* fdir = opendir(buf);
-            if (fdir) {
-                uint64_t cnt = 0;
-                while (readdir(fdir)) cnt++;
-                info.fd_count = (cnt >= 2) ? cnt - 2 : 0;
-                closedir(fdir);
-            }
+    // The tree index rolls up the rates just computed.
+    PhaseTimer tree_timer(timings, PHASE_TABLE);
+    table.indexTree();
+    tree_timer.stop();
+
+    prev_total_jiffies = total_jiffies;
+    prev_work_jiffies  = work_jiffies;
+}
+
+// Numeric entries of an open directory such as /proc/<pid>/task, in TID order.
+static void listTasks(ProcFdCache& c, int fd, std::vector<pid_t>& out)
+{
+    char dbuf[16384];
+    c.syscalls++;
+    if (lseek(fd, 0, SEEK_SET) < 0) return;
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, dbuf, sizeof(dbuf));
+        c.syscalls++;
+        if (n <= 0) break;
+        c.bytes_read += n;
+        for (long off = 0; off < n; ) {
+            linux_dirent64* d = (linux_dirent64*)(dbuf + off);
+            off += d->d_reclen;
+            char* endp;
+            pid_t tid = (pid_t)strtol(d->d_name, &endp, 10);
+            if (*endp == '\0' && tid > 0) out.push_back(tid);
         }
+    }
+    std::sort(out.begin(), out.end());
+}
 
-        processes.push_back(info);
-        process_map[pid] = info;
-        process_tree[info.ppid].push_back(pid);
+static TaskHandles* lookupTask(ProcFdCache& c, pid_t tid)
+{
+    auto it = c.tasks.find(tid);
+    if (it == c.tasks.end()) {
+        TaskHandles h;
+        h.stat_fd = h.status_fd = -1;
+        h.starttime = 0;
+        it = c.tasks.insert(std::make_pair(tid, h)).first;
     }
-    closedir(dir);
+    it->second.generation = c.generation;
+    return &it->second;
+}
 
-    for (auto& proc : processes) {
-        if (m.total > 0)
-            proc.mem_usage = 100.0 * (double)proc.rss / (double)m.total;
-
-        auto it = prev_processes.find(proc.pid);
-        if (it == prev_processes.end()) continue;
-        const ProcessInfo& prev = it->second;
-
-        uint64_t delta_p = (proc.utime + proc.stime) - (prev.utime + prev.stime);
-        proc.cpu_usage = 100.0 * (double)delta_p / (double)delta_t * num_cores;
-        if (proc.cpu_usage < 0) proc.cpu_usage = 0;
-        if (proc.cpu_usage > 100.0 * num_cores) proc.cpu_usage = 100.0 * num_cores;
-
-        bool has_disk_io = (proc.read_bytes > 0 || prev.read_bytes > 0);
-        if (has_disk_io) {
-            proc.io_read_rate  = (double)(proc.read_bytes  - prev.read_bytes)  / 1024.0 / poll_interval;
-            proc.io_write_rate = (double)(proc.write_bytes - prev.write_bytes) / 1024.0 / poll_interval;
-        } else if (proc.rchar > 0 || prev.rchar > 0) {
-            proc.io_read_rate  = (double)(proc.rchar - prev.rchar) / 1024.0 / poll_interval;
-            proc.io_write_rate = (double)(proc.wchar - prev.wchar) / 1024.0 / poll_interval;
+// scanPid for one thread: stat and status through the owner's task directory, reopened when the
+// TID has been reused.
+static bool scanTask(ProcFdCache& c, TaskHandles& h, int task_fd, pid_t tid, ThreadTable& th, size_t i,
+                     char* name_slot)
+{
+    char path[32], statline[2048], buf[4096];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        ProcParse::PidStat st = {};
+        snprintf(path, sizeof(path), "%d/stat", tid);
+        ssize_t n = readCached(c, task_fd, h.stat_fd, path, statline, sizeof(statline));
+        if (n > 0 && ProcParse::parsePidStat(statline, (size_t)n, st, true) &&
+            (h.starttime == 0 || h.starttime == st.starttime)) {
+            h.starttime = st.starttime;
+            size_t name_len = std::min<size_t>(st.comm_len, CMD_SLOT - 1);
+            memcpy(name_slot, st.comm, name_len);
+            name_slot[name_len] = '\0';
+            th.state[i] = st.state;
+            th.processor[i] = st.processor;
+            th.priority[i] = st.priority;
+            th.nice[i] = st.nice;
+            th.utime[i] = st.utime;
+            th.stime[i] = st.stime;
+            th.starttime[i] = st.starttime;
+            snprintf(path, sizeof(path), "%d/status", tid);
+            if ((n = readCached(c, task_fd, h.status_fd, path, buf, sizeof(buf))) > 0)
+                ProcParse::parseStatusSwitches(buf, (size_t)n, th.voluntary_ctxt_switches[i], th.nonvoluntary_ctxt_switches[i]);
+            if (c.open_fds > c.max_fds) closeTask(c, h);
+            return true;
         }
-        if (proc.io_read_rate  < 0) proc.io_read_rate  = 0;
-        if (proc.io_write_rate < 0) proc.io_write_rate = 0;
+        closeTask(c, h);
+        h.starttime = 0;
+    }
+    h.generation = 0;
+    return false;
+}
 
-        if (proc.net_rx_bytes >= prev.net_rx_bytes)
-            proc.net_rx_rate = (double)(proc.net_rx_bytes - prev.net_rx_bytes) / 1024.0 / poll_interval;
-        if (proc.net_tx_bytes >= prev.net_tx_bytes)
-            proc.net_tx_rate = (double)(proc.net_tx_bytes - prev.net_tx_bytes) / 1024.0 / poll_interval;
+const ThreadSample* ThreadSampleStore::find(pid_t tid, unsigned long starttime) const
+{
+    auto it = samples.find(tid);
+    if (it == samples.end() || it->second.starttime != starttime) return NULL;
+    return &it->second;
+}
+
+void ThreadSampleStore::record(const ThreadTable& th)
+{
+    generation++;
+    for (size_t i = 0; i < th.size(); i++) {
+        ThreadSample& s = samples[th.tid[i]];
+        s.starttime = th.starttime[i];
+        s.utime = th.utime[i];
+        s.stime = th.stime[i];
+        s.voluntary_ctxt_switches = th.voluntary_ctxt_switches[i];
+        s.nonvoluntary_ctxt_switches = th.nonvoluntary_ctxt_switches[i];
+        s.generation = generation;
     }
+    for (auto it = samples.begin(); it != samples.end(); ) {
+        if (it->second.generation != generation) it = samples.erase(it);
+        else ++it;
+    }
+    if (samples.bucket_count() > 4 * samples.size() + 1024) samples.rehash(0);
+}
 
-    prev_total_jiffies = total_jiffies;
-    prev_work_jiffies  = work_jiffies;
+// Same shape as the process scan: list each owner's task directory (one owner per pool item),
+// look up every thread's cached handles on this thread, read them in parallel, then intern the
+// names. A process with thousands of threads is spread over the whole pool.
+void scanThreads(const ProcessTable& table, ThreadTable& th, const ThreadSampleStore& prev_samples,
+                 double cpu_scale, double interval, ProcFdCache& c, ScanPool* pool,
+                 const ScanDemand& demand, ScanTimings* timings)
+{
+    th.clear();
+    PhaseTimer timer(timings, PHASE_THREADS);
+    std::vector<uint32_t> owners;
+    for (pid_t pid : demand.thread_pids) {
+        int r = table.find(pid);
+        if (r >= 0 && c.entries.count(pid)) owners.push_back((uint32_t)r);
+    }
+    std::sort(owners.begin(), owners.end());
+    std::vector<PidHandles*> owner_handles;
+    for (uint32_t r : owners) owner_handles.push_back(&c.entries.find(table.pid[r])->second);
+
+    std::vector<std::vector<pid_t>> tids(owners.size());
+    auto listOne = [&](size_t k) {
+        PidHandles& h = *owner_handles[k];
+        if (h.dir_fd < 0) {
+            char name[16];
+            snprintf(name, sizeof(name), "%d", table.pid[owners[k]]);
+            h.dir_fd = openat(c.proc_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            c.syscalls++;
+            if (h.dir_fd < 0) return;
+            c.open_fds++;
+        }
+        if (openCached(c, h.dir_fd, h.task_fd, "task", O_DIRECTORY) >= 0) listTasks(c, h.task_fd, tids[k]);
+    };
+    if (pool && owners.size() > 1) pool->parallelFor(owners.size(), listOne);
+    else for (size_t k = 0; k < owners.size(); k++) listOne(k);
+
+    size_t n = 0;
+    for (const std::vector<pid_t>& v : tids) n += v.size();
+    th.resize(n);
+    std::vector<TaskHandles*> handles(n);
+    std::vector<int> task_fds(n);
+    for (size_t k = 0, i = 0; k < owners.size(); k++)
+        for (pid_t tid : tids[k]) {
+            th.tid[i] = tid;
+            th.tgid[i] = table.pid[owners[k]];
+            th.owner[i] = owners[k];
+            handles[i] = lookupTask(c, tid);
+            task_fds[i] = owner_handles[k]->task_fd;
+            i++;
+        }
+
+    std::vector<char> ok(n, 0);
+    std::vector<char> name_slots(n * CMD_SLOT);
+    auto scanOne = [&](size_t i) {
+        ok[i] = scanTask(c, *handles[i], task_fds[i], th.tid[i], th, i, &name_slots[i * CMD_SLOT]);
+    };
+    if (pool) pool->parallelFor(n, scanOne);
+    else for (size_t i = 0; i < n; i++) scanOne(i);
+
+    for (size_t i = 0; i < n; i++)
+        if (ok[i]) th.name[i] = th.names.intern(&name_slots[i * CMD_SLOT], strlen(&name_slots[i * CMD_SLOT]));
+    th.compact(ok);
+    // Over the descriptor budget the task directories go too; the process scan has already
+    // closed the rest of these owners' handles.
+    if (c.open_fds > c.max_fds)
+        for (PidHandles* h : owner_handles) closeHandles(c, *h);
+
+    for (auto it = c.tasks.begin(); it != c.tasks.end(); ) {
+        if (it->second.generation != c.generation) {
+            closeTask(c, it->second);
+            it = c.tasks.erase(it);
+        } else ++it;
+    }
+
+    for (size_t i = 0; i < th.size(); i++) {
+        const ThreadSample* prev = prev_samples.find(th.tid[i], th.starttime[i]);
+        if (!prev) continue;
+        double ticks = (double)(th.utime[i] + th.stime[i]) - (double)(prev->utime + prev->stime);
+        th.cpu_usage[i] = std::max(0.0, std::min(100.0, cpu_scale * ticks));
+        uint64_t sw = th.voluntary_ctxt_switches[i] + th.nonvoluntary_ctxt_switches[i];
+        uint64_t prev_sw = prev->voluntary_ctxt_switches + prev->nonvoluntary_ctxt_switches;
+        if (interval > 0 && sw >= prev_sw) th.ctxsw_rate[i] = (double)(sw - prev_sw) / interval;
+    }
+}
+
+void scanNumaMaps(ProcessTable& table, const std::vector<int>& cpu_node, ProcFdCache& c,
+                  const ScanDemand& demand, ScanTimings* timings)
+{
+    if (demand.numa_pids.empty() || c.proc_fd < 0) return;
+    PhaseTimer timer(timings, PHASE_NUMA);
+    std::vector<char> buf;
+    std::vector<uint64_t> node_kb;
+    for (pid_t pid : demand.numa_pids) {
+        int r = table.find(pid);
+        if (r < 0) continue;
+        char name[32];
+        snprintf(name, sizeof(name), "%d/numa_maps", pid);
+        int fd = openat(c.proc_fd, name, O_RDONLY | O_CLOEXEC);
+        c.syscalls++;
+        if (fd < 0) continue;
+        // One line per mapping, so a large process's file runs to hundreds of kB.
+        size_t got = 0;
+        for (;;) {
+            if (buf.size() < got + 65536) buf.resize(got + 65536);
+            ssize_t n = read(fd, &buf[got], buf.size() - got);
+            c.syscalls++;
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        close(fd);
+        c.syscalls++;
+        c.bytes_read += got;
+
+        node_kb.assign(1024, 0);
+        int nodes = ProcParse::parseNumaMaps(buf.data(), got, node_kb.data(), (int)node_kb.size());
+        int cpu = table.processor[r];
+        int home = cpu >= 0 && cpu < (int)cpu_node.size() ? cpu_node[cpu] : 0;
+        uint64_t total = 0;
+        for (int k = 0; k < nodes && k < (int)node_kb.size(); k++) total += node_kb[k];
+        table.numa_kb[r] = total;
+        table.numa_remote_kb[r] = total - (home < (int)node_kb.size() ? node_kb[home] : 0);
+    }
+}
+
+void readPressure(ProcFdCache& c, Pressure* out)
+{
+    static const char* files[PSI_COUNT] = { "pressure/cpu", "pressure/memory", "pressure/io" };
+    char buf[512];
+    for (int r = 0; r < PSI_COUNT; r++) {
+        out[r] = Pressure();
+        if (c.proc_fd < 0) continue;
+        ssize_t n = readCached(c, c.proc_fd, c.psi_fds[r], files[r], buf, sizeof(buf));
+        out[r].valid = n > 0 && ProcParse::parsePressure(buf, (size_t)n, out[r].some, out[r].full);
+    }
+}
+
+// The v2 hierarchy is cgroup_root itself, or its "unified" directory on hybrid v1/v2 hosts.
+static int openCgroupRoot(ProcFdCache& c)
+{
+    if (c.cgroup_fd >= 0 || c.cgroup_fd == FD_UNAVAILABLE) return c.cgroup_fd;
+    if (openCached(c, AT_FDCWD, c.cgroup_fd, c.cgroup_root.c_str(), O_DIRECTORY) < 0) return c.cgroup_fd;
+    c.syscalls++;
+    if (faccessat(c.cgroup_fd, "cgroup.procs", F_OK, 0) == 0) return c.cgroup_fd;
+    closeFd(c, c.cgroup_fd);
+    return openCached(c, AT_FDCWD, c.cgroup_fd, (c.cgroup_root + "/unified").c_str(), O_DIRECTORY);
+}
+
+static CgroupHandles* lookupCgroup(ProcFdCache& c, const char* path, size_t len)
+{
+    std::string key(path, len);
+    auto it = c.cgroups.find(key);
+    if (it == c.cgroups.end()) {
+        CgroupHandles h = CgroupHandles();
+        h.dir_fd = h.cpu_fd = h.mem_fd = h.io_fd = h.psi_fd = -1;
+        it = c.cgroups.insert(std::make_pair(key, h)).first;
+    }
+    it->second.generation = c.generation;
+    return &it->second;
 }
 
-double getUptime() {
-    FILE* f = fopen("/proc/uptime", "r");
+// Fills the controller part of g. The root cgroup has no memory.current or cpu.pressure, and a
+// cgroup without the io controller enabled has no io.stat; those simply stay out of g.have.
+static void readCgroupFiles(ProcFdCache& c, CgroupHandles& h, const char* path, size_t len, double interval,
+                            CgroupStats& g)
+{
+    char buf[4096];
+    if (h.dir_fd < 0) {
+        if (openCgroupRoot(c) < 0) return;
+        // "/" is the root itself; anything else is relative to it.
+        std::string rel = len > 1 ? std::string(path + 1, len - 1) : std::string(".");
+        if (openCached(c, c.cgroup_fd, h.dir_fd, rel.c_str(), O_DIRECTORY) < 0) return;
+    }
+    ssize_t n;
+    uint64_t usage;
+    if ((n = readCached(c, h.dir_fd, h.cpu_fd, "cpu.stat", buf, sizeof(buf))) > 0 &&
+        ProcParse::parseCpuStatUsage(buf, (size_t)n, usage)) {
+        if (h.cpu_tick && usage >= h.usage_usec && interval > 0) {
+            double secs = interval * (double)(c.generation - h.cpu_tick);
+            g.cg_cpu = 100.0 * (double)(usage - h.usage_usec) / 1e6 / secs;
+            g.have |= CG_CPU;
+        }
+        h.usage_usec = usage;
+        h.cpu_tick = c.generation;
+    }
+    if ((n = readCached(c, h.dir_fd, h.mem_fd, "memory.current", buf, sizeof(buf))) > 0) {
+        g.mem_current = strtoull(buf, NULL, 10);
+        g.have |= CG_MEM;
+    }
+    if ((n = readCached(c, h.dir_fd, h.io_fd, "io.stat", buf, sizeof(buf))) >= 0) {
+        uint64_t rbytes, wbytes;
+        ProcParse::parseIoStat(buf, (size_t)n, rbytes, wbytes);
+        if (h.io_tick && rbytes >= h.rbytes && wbytes >= h.wbytes && interval > 0) {
+            double secs = interval * (double)(c.generation - h.io_tick);
+            g.cg_io_r = (double)(rbytes - h.rbytes) / 1024.0 / secs;
+            g.cg_io_w = (double)(wbytes - h.wbytes) / 1024.0 / secs;
+            g.have |= CG_IO;
+        }
+        h.rbytes = rbytes;
+        h.wbytes = wbytes;
+        h.io_tick = c.generation;
+    }
+    ProcParse::PsiLine some, full;
+    if ((n = readCached(c, h.dir_fd, h.psi_fd, "cpu.pressure", buf, sizeof(buf))) > 0 &&
+        ProcParse::parsePressure(buf, (size_t)n, some, full)) {
+        g.psi_cpu = some.avg10;
+        g.have |= CG_PSI;
+    }
+    if (c.open_fds > c.max_fds) closeCgroup(c, h);
+}
+
+void scanCgroups(const ProcessTable& table, std::vector<CgroupStats>& out, ProcFdCache& c,
+                 double interval, const ScanDemand& demand, ScanTimings* timings)
+{
+    out.clear();
+    if (!demand.cgroups) {
+        for (auto& g : c.cgroups) closeCgroup(c, g.second);
+        c.cgroups.clear();
+        return;
+    }
+    PhaseTimer timer(timings, PHASE_CGROUP);
+
+    // Paths are interned, so the string id is the group key and a flat index replaces a hash.
+    std::vector<int32_t> slot(table.strings.size(), -1);
+    for (size_t r = 0; r < table.size(); r++) {
+        uint32_t id = table.cgroup[r];
+        if (!id) continue;
+        if (slot[id] < 0) {
+            slot[id] = (int32_t)out.size();
+            CgroupStats g = CgroupStats();
+            g.path = id;
+            out.push_back(g);
+        }
+        CgroupStats& g = out[slot[id]];
+        g.procs++;
+        g.threads += table.num_threads[r];
+        g.rss += table.rss[r];
+        g.cpu += table.cpu_usage[r];
+        g.io_r += table.io_read_rate[r];     g.io_w += table.io_write_rate[r];
+        g.net_rx += table.net_rx_rate[r];    g.net_tx += table.net_tx_rate[r];
+    }
+
+    for (CgroupStats& g : out) {
+        const char* path = table.strings.str(g.path);
+        size_t len = table.strings.length(g.path);
+        readCgroupFiles(c, *lookupCgroup(c, path, len), path, len, interval, g);
+    }
+    for (auto it = c.cgroups.begin(); it != c.cgroups.end(); ) {
+        if (it->second.generation != c.generation) {
+            closeCgroup(c, it->second);
+            it = c.cgroups.erase(it);
+        } else ++it;
+    }
+}
+
+double getUptime(const std::string& proc_root) {
+    FILE* f = fopen((proc_root + "/uptime").c_str(), "r");
     double u = 0;
     if (f) { fscanf(f, "%lf", &u); fclose(f); }
     return u;
 }
 
+int readCpuNodes(std::vector<int>& node_of_cpu, const std::string& sys_root)
+{
+    node_of_cpu.clear();
+    std::string dir = sys_root + "/devices/system/node";
+    DIR* d = opendir(dir.c_str());
+    if (!d) return 0;
+    int nodes = 0;
+    std::vector<uint8_t> mask;
+    while (dirent* e = readdir(d)) {
+        if (strncmp(e->d_name, "node", 4) != 0 || (unsigned)(e->d_name[4] - '0') >= 10) continue;
+        int node = atoi(e->d_name + 4);
+        char list[4096];
+        int fd = open((dir + "/" + e->d_name + "/cpulist").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        ssize_t n = read(fd, list, sizeof(list));
+        close(fd);
+        if (n <= 0) continue;
+        mask.assign(8192, 0);
+        ProcParse::parseCpuList(list, (size_t)n, mask.data(), (int)mask.size());
+        for (size_t c = 0; c < mask.size(); c++) {
+            if (!mask[c]) continue;
+            if (node_of_cpu.size() <= c) node_of_cpu.resize(c + 1, 0);
+            node_of_cpu[c] = node;
+        }
+        nodes = std::max(nodes, node + 1);
+    }
+    closedir(d);
+    return nodes;
+}
+
 }
@@ -0,0 +1,116 @@
+#include "TextFormat.h"
+#include <cmath>
+#include <cstring>
+
+namespace TextFormat {
+
+namespace {
+
+const uint64_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+// Digits are written backwards from the end of a local buffer and appended in one go.
+char* formatUint(char* end, uint64_t v)
+{
+    do { *--end = (char)('0' + v % 10); v /= 10; } while (v);
+    return end;
+}
+
+// Length of the valid UTF-8 sequence at s, or 0. Rejects overlong forms and surrogates.
+size_t utf8Length(const unsigned char* s, size_t left)
+{
+    unsigned char c = s[0];
+    size_t n;
+    uint32_t cp;
+    if (c >= 0xc2 && c <= 0xdf) { n = 2; cp = c & 0x1f; }
+    else if (c >= 0xe0 && c <= 0xef) { n = 3; cp = c & 0x0f; }
+    else if (c >= 0xf0 && c <= 0xf4) { n = 4; cp = c & 0x07; }
+    else return 0;
+    if (left < n) return 0;
+    for (size_t i = 1; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80) return 0;
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    if ((n == 3 && (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff))) || (n == 4 && (cp < 0x10000 || cp > 0x10ffff)))
+        return 0;
+    return n;
+}
+
+}
+
+void appendUint(std::string& out, uint64_t v)
+{
+    char tmp[24];
+    char* p = formatUint(tmp + sizeof(tmp), v);
+    out.append(p, tmp + sizeof(tmp) - p);
+}
+
+void appendInt(std::string& out, int64_t v)
+{
+    char tmp[24];
+    char* p = formatUint(tmp + sizeof(tmp), v < 0 ? 0 - (uint64_t)v : (uint64_t)v);
+    if (v < 0) *--p = '-';
+    out.append(p, tmp + sizeof(tmp) - p);
+}
+
+void appendFixed(std::string& out, double v, int decimals)
+{
+    if (!std::isfinite(v) || std::fabs(v) >= 9e12) { out += '0'; return; }
+    if (decimals < 0) decimals = 0;
+    if (decimals > 6) decimals = 6;
+    int64_t scaled = (int64_t)std::llround(v * (double)POW10[decimals]);
+    uint64_t mag = scaled < 0 ? 0 - (uint64_t)scaled : (uint64_t)scaled;
+    char tmp[40];
+    char* end = tmp + sizeof(tmp);
+    if (decimals) {
+        uint64_t frac = mag % POW10[decimals];
+        for (int i = 0; i < decimals; i++, frac /= 10) *--end = (char)('0' + frac % 10);
+        *--end = '.';
+    }
+    char* p = formatUint(end, mag / POW10[decimals]);
+    if (scaled < 0) *--p = '-';
+    out.append(p, tmp + sizeof(tmp) - p);
+}
+
+void appendCsv(std::string& out, const char* s, size_t len)
+{
+    if (!memchr(s, ',', len) && !memchr(s, '"', len) && !memchr(s, '\n', len) && !memchr(s, '\r', len)) {
+        out.append(s, len);
+        return;
+    }
+    out += '"';
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '"') out += '"';
+        out += s[i];
+    }
+    out += '"';
+}
+
+void appendJson(std::string& out, const char* s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* u = (const unsigned char*)s;
+    out += '"';
+    size_t run = 0;    // start of the pending stretch that needs no escaping
+    for (size_t i = 0; i < len; ) {
+        unsigned char c = u[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') { i++; continue; }
+        size_t n = c >= 0x80 ? utf8Length(u + i, len - i) : 0;
+        if (n) { i += n; continue; }
+        out.append(s + run, i - run);
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) { out += "\\u00"; out += hex[c >> 4]; out += hex[c & 15]; }
+            else out += "\\ufffd";
+        }
+        run = ++i;
+    }
+    out.append(s + run, len - run);
+    out += '"';
+}
+
+}
@@ -0,0 +1,139 @@
+#include "TextSearch.h"
+#include <cstring>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEXT_SEARCH_X86 1
+#endif
+
+namespace TextSearch {
+
+namespace {
+
+typedef const char* (*FindFn)(const char*, size_t, const char*, size_t);
+
+const char* findScalar(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) return hay;
+    if (m > n) return NULL;
+    const char* end = hay + n - m + 1;
+    for (const char* p = hay; p < end; p++) {
+        p = (const char*)memchr(p, needle[0], end - p);
+        if (!p) return NULL;
+        if (memcmp(p + 1, needle + 1, m - 1) == 0) return p;
+    }
+    return NULL;
+}
+
+#ifdef TEXT_SEARCH_X86
+// Both kernels compare a block against the needle's first and last byte at once and only run
+// memcmp on positions where both agree, which on command names is rare.
+__attribute__((target("sse2")))
+const char* findSse2(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) return hay;
+    if (m > n) return NULL;
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf), _mm_cmpeq_epi8(last, bl)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (m <= 2 || memcmp(hay + at + 1, needle + 1, m - 2) == 0) return hay + at;
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+const char* findAvx2(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) return hay;
+    if (m > n) return NULL;
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(hay + i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(hay + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bf), _mm256_cmpeq_epi8(last, bl)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (m <= 2 || memcmp(hay + at + 1, needle + 1, m - 2) == 0) return hay + at;
+            mask &= mask - 1;
+        }
+    }
+    return findSse2(hay + i, n - i, needle, m);
+}
+#endif
+
+Isa detect()
+{
+#ifdef TEXT_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+const Isa best_isa = detect();
+
+FindFn kernel(Isa isa)
+{
+    if (isa > best_isa) isa = best_isa;
+#ifdef TEXT_SEARCH_X86
+    if (isa == ISA_AVX2) return findAvx2;
+    if (isa == ISA_SSE2) return findSse2;
+#endif
+    return findScalar;
+}
+
+const FindFn best_find = kernel(best_isa);
+
+}
+
+void lower(const char* src, size_t n, char* dst)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    // 'A'..'Z' is the only range that changes: add 0x20 where the byte falls inside it.
+    const __m128i a = _mm_set1_epi8('A' - 1), z = _mm_set1_epi8('Z' + 1), bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, a), _mm_cmplt_epi8(v, z));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(v, _mm_and_si128(upper, bit)));
+    }
+#endif
+    for (; i < n; i++) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? (char)(c + 0x20) : c;
+    }
+}
+
+const char* find(const char* hay, size_t n, const char* needle, size_t m)
+{
+    return best_find(hay, n, needle, m);
+}
+
+const char* find(Isa isa, const char* hay, size_t n, const char* needle, size_t m)
+{
+    return kernel(isa)(hay, n, needle, m);
+}
+
+Isa best()
+{
+    return best_isa;
+}
+
+const char* isaName(Isa isa)
+{
+    static const char* names[ISA_COUNT] = { "scalar", "sse2", "avx2" };
+    return isa >= 0 && isa < ISA_COUNT ? names[isa] : "?";
+}
+
+}
@@ -1,13 +1,175 @@
 #include "ProcessAnalyzer.h"
+#include "Options.h"
+#include "ProcessSorter.h"
+#include "ProcessLogger.h"
+#include "JsonOutput.h"
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+static void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [--json | --ndjson[=tick|process]] [--interval MS] [--json-fields LIST] [--changed-only]\n"
+              << "          [--dump-binary[=PATH]] [--read-binary PATH] [--daemon] [--socket PATH]\n"
+              << "          [--scan-threads N] [--fields LIST] [--lazy-refresh N] [--events]\n"
+              << "          [--proc-root DIR] [--sort KEY] [--history-mb N] [--history-file PATH]\n"
+              << "          [--log] [--log-file PATH] [--log-columns LIST] [--log-rotate-mb N] [--log-rotate-min N]\n"
+              << "          [--log-keep N] [--log-compress]\n"
+              << "  --json            print a two-scan JSON snapshot and exit\n"
+              << "  --ndjson[=MODE]   stream one JSON line per tick (tick, default) or per process per tick (process)\n"
+              << "  --interval MS     tick length for --ndjson, gap between the --json scans (default 1000)\n"
+              << "  --json-fields L   comma list of per-process JSON fields, or all, from:\n"
+              << "                    " << JsonOutput::fieldList() << "\n"
+              << "  --changed-only    --ndjson: write a process only when its values changed; list exits as gone\n"
+              << "  --dump-binary[=P] write a two-scan binary snapshot to P, or to stdout, and exit\n"
+              << "  --read-binary P   print a --dump-binary file as --json output\n"
+              << "  --daemon          scan every --interval without a UI and serve snapshots on a Unix socket\n"
+              << "  --socket PATH     --daemon socket (default $XDG_RUNTIME_DIR/pa.sock or /tmp/pa-UID.sock)\n"
+              << "  --scan-threads N  scan /proc with N threads (0 = one per core, default 1)\n"
+              << "  --fields LIST     per-process files read for --json and CSV logging:\n"
+              << "                    comma list of status,io,net,smaps,fd, or all/none (default all)\n"
+              << "  --lazy-refresh N  refresh expensive fields of off-screen processes every N ticks\n"
+              << "                    (default 5, 1 = every tick, 0 = never)\n"
+              << "  --events          track processes with kernel fork/exec/exit events instead of\n"
+              << "                    rescanning /proc (needs CAP_NET_ADMIN, falls back to polling)\n"
+              << "  --proc-root DIR   read process data from DIR instead of /proc (e.g. a fixture tree)\n"
+              << "  --sort KEY        initial sort column (default cpu), one of:\n"
+              << "                    " << ProcessSorter::keyList() << "\n"
+              << "  --history-mb N    keep N MB of per-tick history to scrub back through (default 8, 0 = off)\n"
+              << "  --history-file P  keep the history in file P so it survives restarts\n"
+              << "  --log             start with CSV logging on (toggle with l)\n"
+              << "  --log-file PATH   CSV log file (default process_log.csv)\n"
+              << "  --log-columns L   comma list of logged columns, or all (default), from:\n"
+              << "                    " << ProcessLogger::columnList() << "\n"
+              << "  --log-rotate-mb N rotate the log once it reaches N MB\n"
+              << "  --log-rotate-min N rotate the log every N minutes\n"
+              << "  --log-keep N      rotated logs kept as PATH.1 .. PATH.N (default 5)\n"
+              << "  --log-compress    gzip rotated logs\n";
+}
+
+static bool parseFields(const std::string& list, unsigned& fields)
+{
+    fields = 0;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(pos, comma - pos);
+        if      (name == "status") fields |= FIELD_STATUS;
+        else if (name == "io")     fields |= FIELD_IO;
+        else if (name == "net")    fields |= FIELD_NET;
+        else if (name == "smaps")  fields |= FIELD_SMAPS;
+        else if (name == "fd")     fields |= FIELD_FD;
+        else if (name == "all")    fields |= FIELD_ALL;
+        else if (name != "none" && !name.empty()) return false;
+        pos = comma + 1;
+    }
+    return true;
+}
+
+// Accepts both "--opt value" and "--opt=value".
+static const char* optionValue(int argc, char** argv, int& i, const char* name)
+{
+    size_t len = std::strlen(name);
+    if (std::strncmp(argv[i], name, len) != 0) return NULL;
+    if (argv[i][len] == '=') return argv[i] + len + 1;
+    if (argv[i][len] == '\0' && i + 1 < argc) return argv[++i];
+    return NULL;
+}
 
 int main(int argc, char** argv)
 {
-    if (argc > 1 && std::string(argv[1]) == "--json") {
-        ProcessAnalyzer analyzer(false);
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* val;
+        if (arg == "--json") opts.json = true;
+        else if (arg == "--ndjson") opts.ndjson = true;
+        else if (arg == "--changed-only") opts.changed_only = true;
+        else if (arg == "--dump-binary") opts.dump = true;
+        else if ((val = optionValue(argc, argv, i, "--dump-binary"))) { opts.dump = true; opts.dump_binary = val; }
+        else if ((val = optionValue(argc, argv, i, "--read-binary"))) opts.read_binary = val;
+        else if (arg == "--daemon") opts.daemon = true;
+        else if ((val = optionValue(argc, argv, i, "--socket"))) opts.socket_path = val;
+        else if ((val = optionValue(argc, argv, i, "--ndjson"))) {
+            std::string mode = val;
+            if (mode != "tick" && mode != "process") { usage(argv[0]); return 1; }
+            opts.ndjson = true;
+            opts.ndjson_per_process = mode == "process";
+        }
+        else if ((val = optionValue(argc, argv, i, "--interval"))) {
+            opts.interval_ms = std::atoi(val);
+            if (opts.interval_ms < 10) { usage(argv[0]); return 1; }
+        }
+        else if ((val = optionValue(argc, argv, i, "--json-fields"))) {
+            std::vector<int> fields;
+            if (!JsonOutput::parseFields(val, fields)) { usage(argv[0]); return 1; }
+            opts.json_fields = val;
+        }
+        else if (arg == "--events") opts.proc_events = true;
+        else if ((val = optionValue(argc, argv, i, "--scan-threads"))) {
+            opts.scan_threads = std::atoi(val);
+            if (opts.scan_threads <= 0) opts.scan_threads = (int)std::thread::hardware_concurrency();
+            if (opts.scan_threads <= 0) opts.scan_threads = 1;
+        }
+        else if ((val = optionValue(argc, argv, i, "--fields"))) {
+            if (!parseFields(val, opts.fields)) { usage(argv[0]); return 1; }
+        }
+        else if ((val = optionValue(argc, argv, i, "--lazy-refresh"))) {
+            opts.refresh_ticks = std::atoi(val);
+            if (opts.refresh_ticks < 0) opts.refresh_ticks = 0;
+        }
+        else if ((val = optionValue(argc, argv, i, "--proc-root"))) opts.proc_root = val;
+        else if ((val = optionValue(argc, argv, i, "--sort"))) {
+            if (!ProcessSorter::isKey(val)) { usage(argv[0]); return 1; }
+            opts.sort = val;
+        }
+        else if ((val = optionValue(argc, argv, i, "--history-mb"))) {
+            opts.history_mb = std::atoi(val);
+            if (opts.history_mb < 0) opts.history_mb = 0;
+        }
+        else if ((val = optionValue(argc, argv, i, "--history-file"))) opts.history_file = val;
+        else if (arg == "--log") opts.log = true;
+        else if (arg == "--log-compress") opts.log_compress = true;
+        else if ((val = optionValue(argc, argv, i, "--log-file"))) opts.log_path = val;
+        else if ((val = optionValue(argc, argv, i, "--log-columns"))) {
+            std::vector<int> columns;
+            if (!ProcessLogger::parseColumns(val, columns)) { usage(argv[0]); return 1; }
+            opts.log_columns = val;
+        }
+        else if ((val = optionValue(argc, argv, i, "--log-rotate-mb"))) opts.log_rotate_mb = std::max(0, std::atoi(val));
+        else if ((val = optionValue(argc, argv, i, "--log-rotate-min"))) opts.log_rotate_min = std::max(0, std::atoi(val));
+        else if ((val = optionValue(argc, argv, i, "--log-keep"))) opts.log_keep = std::max(1, std::atoi(val));
+        else { usage(argv[0]); return 1; }
+    }
+
+    if (!opts.read_binary.empty() || opts.dump) {
+        opts.json = true;
+        opts.history_mb = 0;
+        ProcessAnalyzer analyzer(false, opts);
+        return (opts.dump ? analyzer.dumpBinary() : analyzer.readBinary(opts.read_binary)) ? 0 : 1;
+    }
+    if (opts.daemon) {
+        opts.json = true;
+        opts.history_mb = 0;
+        ProcessAnalyzer analyzer(false, opts);
+        return analyzer.serveDaemon() ? 0 : 1;
+    }
+    // Only the interactive UI scrubs history, so the other modes neither map nor touch the ring.
+    if (opts.json || opts.ndjson) opts.history_mb = 0;
+    if (opts.ndjson) {
+        opts.json = true;
+        ProcessAnalyzer analyzer(false, opts);
+        analyzer.streamNDJSON();
+    } else if (opts.json) {
+        ProcessAnalyzer analyzer(false, opts);
         analyzer.printJSON();
     } else {
-        ProcessAnalyzer analyzer(true);
+        ProcessAnalyzer analyzer(true, opts);
         analyzer.run();
     }
     return 0;